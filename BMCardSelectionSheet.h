@@ -4,6 +4,7 @@
  */
 
 #import <Cocoa/Cocoa.h>
+#import <dispatch/dispatch.h>
 #import "bluemoon.h"
 
 /**
@@ -36,6 +37,7 @@
     int who;                    ///< Data received from the game engine - must be passed back unchanged.
     void *dataPointer;          ///< Pointer to data received from game engine - must be passed back unchanged.
     BOOL endTurnAfter;          ///< If this is set to YES, game turn is ended automatically after the sheet is closed.
+    dispatch_semaphore_t closedSignal; ///< If set, signalled when the sheet is closed (choice asked for during the AI's turn).
     
     NSArray *cardSelections;
 }
@@ -48,6 +50,7 @@
 @property int who;
 @property void *dataPointer;
 @property BOOL endTurnAfter;
+@property dispatch_semaphore_t closedSignal;
 
 + (BMCardSelectionSheet *)sheet;
 - (void)free;
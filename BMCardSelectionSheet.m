@@ -19,7 +19,7 @@ static BMCardSelectionSheet *s_instance = nil;
 
 @implementation BMCardSelectionSheet
 
-@synthesize callback, minAmount, maxAmount, prompt, theGame, who, dataPointer, endTurnAfter;
+@synthesize callback, minAmount, maxAmount, prompt, theGame, who, dataPointer, endTurnAfter, closedSignal;
 
 /// Here we add a key-value observing dependecy needed to enable/disable
 /// state of the close button.
@@ -90,7 +90,14 @@ static BMCardSelectionSheet *s_instance = nil;
     // Allow game engine to handle the operation
     [self performCallback:NO];
 
-    if (endTurnAfter)
+    if (closedSignal)
+    {
+        // Let the AI's turn continue, the turn is ended when it is over
+        dispatch_semaphore_t signal = closedSignal;
+        closedSignal = NULL;
+        dispatch_semaphore_signal(signal);
+    }
+    else if (endTurnAfter)
     {
         // Let AI take turn 
         endTurnAfter = NO;
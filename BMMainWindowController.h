@@ -6,6 +6,8 @@
 #import <Cocoa/Cocoa.h>
 #import <QuartzCore/QuartzCore.h>
 #import "bluemoon.h"
+#import "journal.h"
+#import "async.h"
 
 #define kNumPeople 10   ///< Amount of various people in the game.
 #define kNumCards 128   ///< Largest possible card index in the game.
@@ -26,7 +28,7 @@
     IBOutlet NSButton *retreatButton;   ///< Button used to retreat from fight
     IBOutlet NSButton *fireButton;      ///< Button used to announce fight in fire
     IBOutlet NSButton *earthButton;     ///< Button used to announce fight in earth
-    IBOutlet NSButton *undoButton;      ///< Button used to undo a turn
+    IBOutlet NSButton *undoButton;      ///< Button used to undo a move
 
     // Layers for game area background
     CALayer *gameLayer;                 ///< Layer for the game area and cards (located in gameView)
@@ -60,8 +62,11 @@
     int player_us;              ///< Player we're playing as
     int human_people;           ///< People index for human player
     int ai_people;              ///< People index for ai player
-    BOOL backup_set;            ///< If YES, there is a backup that can be restored
-    game backup;                ///< Back-up game to restore from when undo-ing
+    BOOL history_started;       ///< If YES, undo_history has been started for this game
+    history undo_history;       ///< Positions of the game to restore from when undo-ing
+    async_turn ai_turn;         ///< AI's turn, played on a worker thread
+    BOOL aiThinking;            ///< If YES, the AI's turn is being played and the game must be left alone
+    async_turn ponder_turn;     ///< AI's pondering during our turn, played on a worker thread
 
     /// Class managing card images
     BMCardImageStore *imageStore;
@@ -25,26 +25,44 @@ int verbose;
 // Here we simply forward the request to BMMainWindowController.
 void message_add(char *msg)
 {
+    // Messages during the AI's turn come from its worker thread, but views
+    // may only be used on the main thread
+    if (![NSThread isMainThread])
+    {
+        dispatch_sync(dispatch_get_main_queue(), ^{ message_add(msg); });
+        return;
+    }
+
     [[[NSApp mainWindow] delegate] addMessage:[NSString stringWithUTF8String:msg]];
 }
 
-// Game engine calls this method when it needs a choice of cards from the user,
-// e.g., for discarding, drawing cards or some other effect.
-static void gui_choose(game *g, int chooser, int who, design **choices,
-                       int num_choices, int min, int max,
-                       choose_result callback, void *data, char *prompt)
+/// Events of the real game.
+static event_log gui_events;
+
+// Game engine calls this for every event in the real game.
+static void gui_event(game *g, event *e)
 {
+    char msg[1024];
 
-	// Check for no real choice
-	if (min == num_choices)
-	{
-		// Call callback
-		callback(g, who, choices, num_choices, data);
+    // Format (and translate) event
+    event_message(e, msg);
 
-		// Done
-		return;
-	}
+    // Skip events with nothing to say
+    if (!msg[0]) return;
 
+    message_add(msg);
+
+    // Show the AI's moves as they are made (its worker waits meanwhile)
+    if (![NSThread isMainThread])
+        dispatch_sync(dispatch_get_main_queue(), ^{ [[[NSApp mainWindow] delegate] updateAll]; });
+}
+
+// Shows the sheet for choosing cards. If closed is set, it is signalled once
+// the choice has been made.
+static void show_choice(game *g, int who, design **choices, int num_choices,
+                        int min, int max, choose_result callback, void *data,
+                        char *prompt, dispatch_semaphore_t closed)
+{
     // Create a sheet for selecting the cards and forward all information 
     // we received from the engine to the sheet's controller. Then display
     // the sheet.
@@ -57,9 +75,49 @@ static void gui_choose(game *g, int chooser, int who, design **choices,
     sheet.dataPointer = data;
     sheet.theGame = g;
     sheet.prompt = [NSString stringWithUTF8String:prompt];
+    sheet.closedSignal = closed;
     [sheet display];    
 }
 
+// Game engine calls this method when it needs a choice of cards from the user,
+// e.g., for discarding, drawing cards or some other effect.
+static void gui_choose(game *g, int chooser, int who, design **choices,
+                       int num_choices, int min, int max,
+                       choose_result callback, void *data, char *prompt)
+{
+
+	// Check for no real choice
+	if (min == num_choices)
+	{
+		// Call callback
+		callback(g, who, choices, num_choices, data);
+
+		// Done
+		return;
+	}
+
+    // Choices during the AI's turn are asked for on its worker thread, but
+    // the sheet may only be shown on the main thread
+    if (![NSThread isMainThread])
+    {
+        dispatch_semaphore_t closed = dispatch_semaphore_create(0);
+
+        // Show the sheet on the main thread
+        dispatch_sync(dispatch_get_main_queue(), ^{
+            show_choice(g, who, choices, num_choices, min, max, callback,
+                        data, prompt, closed);
+        });
+
+        // Wait until the choice has been made
+        dispatch_semaphore_wait(closed, DISPATCH_TIME_FOREVER);
+        dispatch_release(closed);
+        return;
+    }
+
+    show_choice(g, who, choices, num_choices, min, max, callback, data,
+                prompt, NULL);
+}
+
 // Interface for the engine so it can access the UI when needed.
 static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 
@@ -69,6 +127,7 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 - (void)applicationDidFinishLaunching:(NSNotification *)aNotification;
 - (void)saveState;
 - (void)setPeople;
+- (void)startOurTurn;
 - (void)updateStatus;
 - (void)updateTable;
 - (void)updateHand:(BOOL)playerHand;
@@ -166,28 +225,24 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 // Handles press of the "Undo" button.
 - (IBAction)undoButtonWasClicked:(id)sender
 {
-    NSAssert(backup_set, @"[BMMainWindowController undoButtonWasClicked:] Undo was clicked but there's no backup!");
-
-    // Restore game 
-	real_game = backup;
+    NSAssert(history_started, @"[BMMainWindowController undoButtonWasClicked:] Undo was clicked but there's no history!");
 
-	// No backup available 
-	backup_set = NO;
+	// Record latest move
+	history_record(&undo_history, &real_game);
 
-	// Deactivate undo button
-    [undoButton setEnabled:NO];
+    // Restore game to previous position
+	history_undo(&undo_history, &real_game);
 
-	// Retreat is always legal after undo
-    [retreatButton setEnabled:YES];
+	// Deactivate undo button at start of history
+    [undoButton setEnabled:undo_history.pos > 0];
 
-	// Announce power is always illegal
-    [fireButton setEnabled:NO];
-    [earthButton setEnabled:NO];
+	// Set buttons for restored position
+    [self updateButtons];
 
 	// Draw stuff
     [self updateAll];
     
-    [self addMessage:NSLocalizedString(@"Current turn undone.\n", @"Message shown when user clicks undo button")];
+    [self addMessage:NSLocalizedString(@"Last move undone.\n", @"Message shown when user clicks undo button")];
 }
 
 // Handles a click on one of the cards.
@@ -251,12 +306,20 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 	real_game.p[real_game.turn].phase = PHASE_START;
 	real_game.p[!real_game.turn].phase = PHASE_NONE;
 
+	// Start new undo history
+	history_started = NO;
+
 	// Let the AI player take their turn and setup for our first turn
 	[self handleEndTurn];
 }
 
 - (BOOL)validateMenuItem:(NSMenuItem *)menuItem
 {
+    // Leave the game alone while the AI plays its turn
+    if (aiThinking && ([menuItem action] == @selector(onNewGame:) ||
+                       [menuItem action] == @selector(debugSelectGame:) ||
+                       [menuItem action] == @selector(debugDiscloseHand:)))
+        return NO;
     if ([menuItem tag] == TagDiscloseHand && !self.gameStarted)
         return NO;
     return YES;
@@ -328,6 +391,9 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
         real_game.p[real_game.turn].phase = PHASE_START;
         real_game.p[!real_game.turn].phase = PHASE_NONE;
 
+        // Start new undo history
+        history_started = NO;
+
         // Let the AI player take their turn and setup for our first turn
         [self handleEndTurn];
     }
@@ -344,16 +410,12 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 #pragma mark Internal methods
 
 /**
- * Saves current game state as "undo" state.
+ * Records the previous move in the undo history before the next one is made.
  */
 - (void)saveState
 {
-    if (!backup_set)
-    {
-        backup = real_game;
-        backup_set = YES;
-        [undoButton setEnabled:YES];
-    }
+    history_record(&undo_history, &real_game);
+    [undoButton setEnabled:YES];
 }
 
 - (void)awakeFromNib
@@ -475,9 +537,20 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
     playerCardLayers = [NSMutableArray arrayWithCapacity:6];
     aiCardLayers = [NSMutableArray arrayWithCapacity:6];
                           
+    // Prepare for playing the AI's turns (and pondering) on worker threads
+    async_init(&ai_turn);
+    async_init(&ponder_turn);
+
     // Set random seed
     srand(time(NULL));
     real_game.random_seed = time(NULL);
+
+    // Play with fixed networks (no learning during play)
+    ai_frozen = 1;
+
+    // Show game events as messages
+    gui_events.hook = gui_event;
+    real_game.events = &gui_events;
       
     // Set people pointers 
     [self setPeople];
@@ -498,6 +571,10 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 
 - (void)setPeople
 {
+	// Stop AI pondering about the previous game
+	async_cancel(&ponder_turn);
+	async_wait(&ponder_turn);
+
 	// Check for human player having later people 
 	if (human_people > ai_people)
 	{
@@ -527,16 +604,32 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 	// Call opponent initialization
 	real_game.p[!player_us].control->init(&real_game, !player_us);
 
+	// Load our network too, so the AI can predict our turns when pondering
+	ai_func.init(&real_game, player_us);
+
 	// Set our interface
 	real_game.p[player_us].control = &gui_func;
 }
 
+// Called on the worker thread when the AI's turn is over.
+static void gui_turn_done(game *g, int result, void *data)
+{
+    BMMainWindowController *controller = data;
+
+    // Continue on the main thread
+    dispatch_async(dispatch_get_main_queue(), ^{ [controller startOurTurn]; });
+}
+
 /**
- * After our turn, let the AI take actions until it is our turn again,
- * then refresh the drawing areas so that we can take our next turn.
+ * After our turn, let the AI take actions on a worker thread until it is
+ * our turn again, then set up our next turn (see startOurTurn).
  */
 - (void)handleEndTurn
 {
+	// Stop AI pondering, our move has been made
+	async_cancel(&ponder_turn);
+	async_wait(&ponder_turn);
+
 	// Deactivate "retreat" button
     [retreatButton setEnabled:NO];
 
@@ -547,28 +640,73 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
     [fireButton setEnabled:NO];
     [earthButton setEnabled:NO];
 
-	// Have AI take actions until it is our turn 
-	while (real_game.turn != player_us && !real_game.game_over)
+	// Check for AI to move
+	if (real_game.turn != player_us && !real_game.game_over)
 	{
-		// Request action from AI
-		real_game.p[real_game.turn].control->take_action(&real_game);
+		// Leave the game to the AI until its turn is over
+		aiThinking = YES;
 
-		// Redraw everything 
-		//[self updateAll];        
+		// Have AI take actions on a worker thread until it is our turn
+		if (async_start(&ai_turn, &real_game, ai_time_limit, gui_turn_done, self) == 0)
+			return;
+
+		// No worker, so have AI take actions here instead
+		while (real_game.turn != player_us && !real_game.game_over)
+		{
+			interface *control = real_game.p[real_game.turn].control;
+
+			// Stop at a player who can't take actions
+			if (!control->take_action)
+				break;
+
+			// Request action from AI
+			control->take_action(&real_game);
+		}
 	}
 
-	// No undo available
-	backup_set = NO;
+	// Set up our turn
+	[self startOurTurn];
+}
+
+/**
+ * Once the AI's turn is over, set up our turn and refresh the drawing
+ * areas so that we can take it.
+ */
+- (void)startOurTurn
+{
+	// The game is ours again
+	aiThinking = NO;
 
 	// Set "retreat" button
     [retreatButton setEnabled:!real_game.game_over];
 
+	// Let the AI think ahead during our turn (pondering is optional, so
+	// failing to start it is harmless)
+	if (!real_game.game_over)
+		async_ponder(&ponder_turn, &real_game, !player_us, NULL, NULL);
+
 	// Start turn
 	start_turn(&real_game);
 
 	// Advance to beginning of turn phase
 	real_game.p[player_us].phase = PHASE_BEGIN;
 
+	// Check for first turn
+	if (!history_started)
+	{
+		// Start undo history here
+		history_start(&undo_history, &real_game);
+		history_started = YES;
+	}
+	else
+	{
+		// Record our last turn and the AI's turn as one move
+		history_record(&undo_history, &real_game);
+	}
+
+	// Undo is available after the first turn
+	[undoButton setEnabled:undo_history.pos > 0];
+
 	// Draw stuff 
     [self updateAll];
 }
@@ -1264,6 +1402,18 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
 	// Loop over cards
     if (self.gameStarted)
     {
+        // Check legality of every card in our hand at once
+        unsigned int allowed = 0;
+        if (playerHand && !real_game.game_over && real_game.turn == player_us)
+        {
+            unsigned int handMask = 0;
+            for (int i = 0; i < DECK_SIZE; i++)
+            {
+                if (p->deck[i].where == LOC_HAND) handMask |= 1U << i;
+            }
+            allowed = allowed_cards(&real_game, handMask);
+        }
+
         for (int i = 0; i < DECK_SIZE; i++)
         {
             // Get card pointer
@@ -1306,7 +1456,7 @@ static interface gui_func = { NULL, NULL, gui_choose, NULL, NULL };
                 cardAction = nil;
 
             // Check for other restrictions on playing
-            else if (!card_allowed(&real_game, d_ptr)) 
+            else if (!(allowed & (1U << i)))
                 cardAction = nil;
 
             CALayer *layer = nil;
@@ -1458,6 +1608,10 @@ void RoundRect(CGContextRef ctx, CGRect bounds, CGFloat radius, CGFloat width)
     // Get layer at mouse location
     CALayer *layer = [gameLayer hitTest:*(CGPoint *)&point];
 
+    // Ignore clicks while the AI plays its turn
+    if (aiThinking)
+        clickedLayer = nil;
+
     if (layer == clickedLayer)
     {
         // User clicked a card. If there is action specified for the card, execute it.
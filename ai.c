@@ -20,6 +20,11 @@
 
 #include "bluemoon.h"
 #include "net.h"
+#include "dataset.h"
+#include "journal.h"
+
+#include <sys/time.h>
+#include <pthread.h>
 
 extern int verbose;
 
@@ -27,24 +32,6 @@ extern int verbose;
 /* #define DEBUG */
 
 
-/*
- * Action types.
- */
-#define ACT_NONE        0
-#define ACT_RETREAT     1
-#define ACT_RETRIEVE    2
-#define ACT_PLAY        3
-#define ACT_PLAY_NO     4
-#define ACT_ANN_FIRE    5
-#define ACT_ANN_EARTH   6
-#define ACT_USE         7
-#define ACT_SATISFY     8
-#define ACT_CHOOSE      9
-#define ACT_LAND        10
-#define ACT_LOAD        11
-#define ACT_BLUFF       12
-#define ACT_REVEAL      13
-
 /*
  * An action to take.
  */
@@ -72,26 +59,6 @@ typedef struct action
  */
 #define MAX_ACTION 50
 
-/*
- * Current best path.
- */
-static action best_path[MAX_ACTION];
-
-#ifdef DEBUG
-/* Actions in current evaluated path */
-static action cur_path[MAX_ACTION];
-#endif
-
-/*
- * Current best path position.
- */
-static int best_path_pos;
-
-/*
- * Current best path score.
- */
-static double best_path_score;
-
 /*
  * Information about choice to make.
  */
@@ -100,8 +67,8 @@ typedef struct node
 	/* Callback */
 	choose_result callback;
 
-	/* Legal combinations */
-	int legal[5000];
+	/* Index of first legal combination in choice arena */
+	int first;
 
 	/* Number of combinations */
 	int num_legal;
@@ -118,52 +85,282 @@ typedef struct node
 } node;
 
 /*
- * Choices to make.
+ * Shape of networks created when no weights file is found (files give
+ * their own shape).
+ */
+int ai_hidden = HIDDEN_NODES;
+int ai_hidden2 = 0;
+int ai_activation = NET_SIGMOID;
+
+/*
+ * Shared first layer for all matchups (if in use).
+ */
+static net trunk;
+
+/*
+ * Whether we have looked for a shared trunk yet.
+ */
+static int trunk_loaded;
+
+/*
+ * Use a shared trunk, creating it and any missing heads if needed.
+ */
+int ai_shared_trunk;
+
+/*
+ * Play without learning, sharing one read-only set of weights per matchup.
+ */
+int ai_frozen;
+
+/*
+ * Networks loaded for frozen play, indexed by our people and opponent's.
+ */
+static net frozen_net[MAX_PEOPLE][MAX_PEOPLE];
+
+/*
+ * Protects the shared trunk and frozen networks while games load theirs.
+ */
+static pthread_mutex_t load_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Outcomes of each random event (draws, random discards) to average over
+ * when searching.  With one, the search sees a single arbitrary outcome.
+ */
+int ai_chance_samples = 1;
+
+/*
+ * Positions searched for one decision after which random events are no
+ * longer sampled and later turns are no longer looked ahead into.
+ */
+int ai_search_budget = 5000;
+
+/*
+ * Whole turns each player looks ahead past the end of their current one
+ * (zero stops at the end of the current turn).
+ */
+int ai_lookahead[2];
+
+/*
+ * Most end-of-turn positions of one turn that are looked ahead from.
+ */
+#define LOOK_WIDTH 4
+
+/*
+ * Deepest lookahead allowed.
+ */
+#define MAX_LOOKAHEAD 4
+
+/*
+ * A position at the end of a searched turn, to be looked ahead from.
+ */
+typedef struct candidate
+{
+	/* Game state */
+	game state;
+
+	/* Hash of game state */
+	uint64_t hash;
+
+	/* Score when the turn was searched */
+	double score;
+
+	/* Actions leading here */
+	action path[MAX_ACTION];
+
+	/* Number of actions */
+	int len;
+
+} candidate;
+
+/*
+ * Positions searched while pondering.
+ */
+int ai_ponder_budget = 20000;
+
+/*
+ * A position searched while pondering.
  */
-static node nodes[10];
+typedef struct ponder_entry
+{
+	/* Hash of position (see ponder_key) */
+	uint64_t hash;
+
+	/* Best path found */
+	action path[MAX_ACTION];
+
+} ponder_entry;
 
 /*
- * Current choice.
+ * Milliseconds one decision may search before acting on the best path
+ * found so far (zero for no limit), for games that don't set their own
+ * (see ai_set_time_limit).
  */
-static int node_pos;
+int ai_time_limit;
 
 /*
- * Number of upcoming choices.
+ * Positions the exact endgame solver may search before giving up and
+ * falling back to the normal search (zero disables the solver).
  */
-static int node_len;
+int ai_endgame_budget = 200000;
 
 /*
- * Prevent recursive chooses.
+ * Number of entries in the endgame solver's table.
  */
-static int inside_choose;
+#define SOLVE_SIZE 65536
 
 /*
- * String used for AI assist purposes.
+ * Most cards in both hands for which solving is tried (with more, the
+ * solver practically never finishes within its budget).
  */
-static char *assist_str;
+#define SOLVE_MAX_HAND 7
 
 /*
- * Flag used when checking for no option but retreat.
+ * Solved position (at the start of a player's turn).
  */
-static int must_retreat;
-static int checking_retreat;
+typedef struct solve_entry
+{
+	/* Hash of game state */
+	uint64_t hash;
+
+	/* Result for player to move */
+	double value;
+
+} solve_entry;
 
 /*
- * Flag used when checking for opponent's response to declined fight.
+ * State of one search.
+ *
+ * Every simulated game points to the search it belongs to, and real games
+ * to the search used for their decisions.  Pondering uses a search of its
+ * own, so that it can run on another thread while decisions are made.
  */
-static int checking_decline;
+typedef struct ai_search
+{
+	/* Network of each player to evaluate with */
+	net *nets[2];
+
+	/* Current best path */
+	action best_path[MAX_ACTION];
+
+	/* Actions in current evaluated path (offset by one from best path) */
+	action cur_path[MAX_ACTION];
+
+	/* Current best path position */
+	int best_path_pos;
+
+	/* Current best path score */
+	double best_path_score;
+
+	/* Choices to make (grown as needed) */
+	node *nodes;
+
+	/* Number of choice nodes allocated */
+	int max_nodes;
+
+	/* Legal combinations of every choice node, one after another */
+	int *choose_arena;
+
+	/* Size of choice arena */
+	int max_arena;
+
+	/* Current choice */
+	int node_pos;
+
+	/* Number of upcoming choices */
+	int node_len;
+
+	/* Prevent recursive chooses */
+	int inside_choose;
+
+	/* String used for AI assist purposes */
+	char *assist_str;
+
+	/* Flags used when checking for no option but retreat */
+	int must_retreat;
+	int checking_retreat;
+
+	/* Flag used when checking for opponent's response to declined fight */
+	int checking_decline;
+
+	/* Positions searched for the current decision */
+	int search_nodes;
+
+	/* Positions searched in all decisions so far */
+	long searched;
+
+	/* Searching extra outcomes of a random event */
+	int sampling;
+
+	/* End-of-turn positions collected by the turn searched (if any) */
+	candidate *cands;
+	int num_cands;
+
+	/* Player whose actual hand is still in looked ahead positions */
+	int look_hidden;
+
+	/* Set to stop searching without taking any action */
+	volatile int cancelled;
+
+	/* Milliseconds each decision may search (zero for no limit) */
+	int time_limit;
+
+	/* Set while timed, the deadline, and whether it has passed */
+	int timed;
+	struct timeval deadline;
+	int out_of_time;
+
+	/* Set while solving an endgame, and when the solver gave up */
+	int solving;
+	int solve_failed;
 
+	/* Table of solved positions (allocated on first use) */
+	solve_entry *solve_table;
+
+	/* Stop searching for legal combinations (any that works will do) */
+	int stop_choose;
+
+	/* Choices the same as the next one (one bit each, last one is tried) */
+	int choose_same;
+
+} ai_search;
 
 /*
- * A neural net for each player.
+ * AI state of one game.
  */
-net learner[2];
+typedef struct ai_state
+{
+	/* A neural net for each player */
+	net learner[2];
+
+	/* Search for the game's decisions */
+	ai_search decide;
+
+	/* Search used while pondering */
+	ai_search ponder;
+
+	/* Copies of the networks taken when pondering started */
+	net ponder_net[2];
+
+	/* Copy of the game taken when pondering started */
+	game ponder_game;
 
-/* Neural net inputs */
-#define NET_INPUT 443
+	/* Player pondering */
+	int ponder_who;
 
-/* Number of hidden nodes */
-#define HIDDEN_NODES 50
+	/* Positions each player has searched while pondering */
+	ponder_entry ponder_cache[2][LOOK_WIDTH];
+	int num_ponder[2];
+
+	/* Decisions that could have been pondered, and those that were */
+	long ponder_tries, ponder_hits;
+
+	/* Milliseconds spent pondering */
+	double ponder_time;
+
+	/* Last action stopped at a random event before the turn was over */
+	int resuming;
+
+} ai_state;
 
 /*
  * Set an input value of the neural net.
@@ -196,6 +393,9 @@ static void simulate_game(game *sim, game *orig)
 
 		/* Reset random seed */
 		sim->random_seed = 0;
+
+		/* Start counting searched positions */
+		sim->search->search_nodes = 0;
 	}
 }
 
@@ -204,6 +404,7 @@ static void simulate_game(game *sim, game *orig)
  */
 static double eval_game(game *g, int who)
 {
+	ai_search *s = g->search;
 	player *p;
 	card *c;
 	int n = 0, i, j;
@@ -211,7 +412,7 @@ static double eval_game(game *g, int who)
 	net *l;
 
 	/* Get player's network */
-	l = &learner[who];
+	l = s->nets[who];
 
 	/* Check for no learner loaded */
 	if (!l->num_inputs) return 0.5;
@@ -478,15 +679,15 @@ static double eval_game(game *g, int who)
 
 #ifdef DEBUG
 	/* Print score and path to get here */
-	if (verbose && !checking_retreat && best_path_pos > 0)
+	if (verbose && !s->checking_retreat && s->best_path_pos > 0)
 	{
 		printf("%.12lf: ", l->win_prob[who]);
 
-		for (i = 0; i <= best_path_pos; i++)
+		for (i = 0; i <= s->best_path_pos; i++)
 		{
 			action a;
 
-			a = cur_path[i];
+			a = s->cur_path[i];
 
 			switch (a.act)
 			{
@@ -507,9 +708,9 @@ static double eval_game(game *g, int who)
 			}
 		}
 
-		if (must_retreat) printf("Force retreat");
+		if (s->must_retreat) printf("Force retreat");
 
-		if (checking_decline)
+		if (s->checking_decline)
 		{
 			printf("Responding %s", g->fight_element ? "earth" : "fire");
 		}
@@ -537,14 +738,29 @@ static void perform_training(game *g, int who, double *desired)
 	net *l;
 
 	/* Get correct network to train */
-	l = &learner[who];
+	l = &g->ai->learner[who];
 
 	/* Check for uninitialized network */
 	if (!l->num_inputs) return;
 
+	/* Frozen networks have nothing to do unless exporting positions */
+	if (ai_frozen && !export_data) return;
+
 	/* Get current state */
 	eval_game(g, who);
 
+	/* Check for exporting positions */
+	if (export_data)
+	{
+		/* Add current inputs to dataset */
+		dataset_add(export_data, who, g->turn,
+		            g->p[0].p_ptr - peoples, g->p[1].p_ptr - peoples,
+		            g->start_seed, l->input_value);
+	}
+
+	/* Frozen networks are not trained */
+	if (ai_frozen) return;
+
 	/* Store current inputs */
 	store_net(l);
 
@@ -584,18 +800,87 @@ static void perform_training(game *g, int who, double *desired)
 }
 
 /*
- * Initialize AI.
+ * Load the shared trunk, if there is one.
  */
-static void ai_initialize(game *g, int who)
+static void load_trunk(void)
+{
+	/* Only look once */
+	if (trunk_loaded) return;
+
+	/* Remember that we looked */
+	trunk_loaded = 1;
+
+	/* Check for no trunk file (and none wanted) */
+	if (!ai_shared_trunk &&
+	    access(DATADIR "/networks/bluemoon.trunk", R_OK)) return;
+
+	/* Create trunk network */
+	make_net(&trunk, NET_INPUT, ai_hidden, 0, 2, ai_activation);
+
+	/* Attempt to load trunk from disk */
+	if (load_net(&trunk, DATADIR "/networks/bluemoon.trunk") &&
+	    !ai_shared_trunk)
+	{
+		/* No trunk */
+		free_learner(&trunk);
+	}
+}
+
+/*
+ * Create a player's network as a head on the shared trunk and load its
+ * weights from disk.
+ *
+ * Return -1 if the head couldn't be loaded.
+ */
+static int load_head(net *l, game *g, int who)
+{
+	char fname[1024];
+
+	/* Create head network */
+	make_net(l, NET_INPUT, trunk.num_hidden, ai_hidden2, 2,
+	         trunk.activation);
+
+	/* Share trunk */
+	share_trunk(l, &trunk);
+
+	/* Set learning rate */
+	l->alpha = 0.0001;
+
+	/* Create head filename */
+	sprintf(fname, DATADIR "/networks/bluemoon.head.%s.%s",
+	                                     g->p[who].p_ptr->name,
+	                                     g->p[!who].p_ptr->name);
+
+	/* Attempt to load head weights */
+	return load_net(l, fname);
+}
+
+/*
+ * Create a player's network and load its weights from disk.
+ */
+static void load_network(net *l, game *g, int who)
 {
 	char fname[1024], buf[1024];
 
+	/* Look for shared trunk */
+	load_trunk();
+
+	/* Use a head on the trunk if one exists (or is wanted) */
+	if (trunk.num_inputs)
+	{
+		/* Check for success (or creating a missing head) */
+		if (!load_head(l, g, who) || ai_shared_trunk) return;
+
+		/* Destroy failed head */
+		free_learner(l);
+	}
+
 	/* Create neural net */
-	make_learner(&learner[who], NET_INPUT, HIDDEN_NODES, 2);
+	make_net(l, NET_INPUT, ai_hidden, ai_hidden2, 2, ai_activation);
 
 	/* Set learning rate */
-	learner[who].alpha = 0.0001;
-	/* learner[who].alpha = 0.0; printf("WARNING: alpha is 0\n"); */
+	l->alpha = 0.0001;
+	/* l->alpha = 0.0; printf("WARNING: alpha is 0\n"); */
 
 	/* Create network filename */
 	sprintf(fname, DATADIR "/networks/bluemoon.net.%s.%s",
@@ -603,7 +888,7 @@ static void ai_initialize(game *g, int who)
 	                                     g->p[!who].p_ptr->name);
 
 	/* Attempt to load net weights from disk */
-	if (load_net(&learner[who], fname))
+	if (load_net(l, fname))
 	{
 		/* Create warning message */
 		sprintf(buf,
@@ -613,6 +898,76 @@ static void ai_initialize(game *g, int who)
 		/* Send message */
 		message_add(buf);
 	}
+}
+
+/*
+ * Initialize AI.
+ */
+static void ai_initialize(game *g, int who)
+{
+	ai_state *ai;
+	net *l, *frozen;
+	int i;
+
+	/* Check for no AI state yet */
+	if (!g->ai)
+	{
+		/* Create state */
+		g->ai = (ai_state *)calloc(1, sizeof(ai_state));
+
+		/* Loop over searches */
+		for (i = 0; i < 2; i++)
+		{
+			/* Decisions evaluate with the players' own networks */
+			g->ai->decide.nets[i] = &g->ai->learner[i];
+
+			/* Pondering evaluates with copies */
+			g->ai->ponder.nets[i] = &g->ai->ponder_net[i];
+		}
+
+		/* No hand is hidden yet */
+		g->ai->decide.look_hidden = g->ai->ponder.look_hidden = -1;
+
+		/* Decisions are limited by default */
+		g->ai->decide.time_limit = ai_time_limit;
+	}
+
+	/* Get AI state */
+	ai = g->ai;
+
+	/* Game decides with its own search */
+	g->search = &ai->decide;
+
+	/* Get player's network */
+	l = &ai->learner[who];
+
+	/* Destroy any previous network */
+	if (l->num_inputs) free_learner(l);
+
+	/* Keep other games from loading shared networks at the same time */
+	pthread_mutex_lock(&load_mutex);
+
+	/* Check for frozen play */
+	if (ai_frozen)
+	{
+		/* Get network for this matchup */
+		frozen = &frozen_net[g->p[who].p_ptr - peoples]
+		                    [g->p[!who].p_ptr - peoples];
+
+		/* Load network the first time it is needed */
+		if (!frozen->num_inputs) load_network(frozen, g, who);
+
+		/* Evaluate with shared weights */
+		borrow_net(l, frozen);
+	}
+	else
+	{
+		/* Load our own network */
+		load_network(l, g, who);
+	}
+
+	/* Done loading */
+	pthread_mutex_unlock(&load_mutex);
 
 	/* Evaluate starting position */
 	eval_game(g, who);
@@ -622,8 +977,8 @@ static void ai_initialize(game *g, int who)
 	{
 		/* Print win probabilities of starting state */
 		printf("%s Start prob: %f %f\n", g->p[who].p_ptr->name,
-						 learner[who].win_prob[0],
-						 learner[who].win_prob[1]);
+						 l->win_prob[0],
+						 l->win_prob[1]);
 	}
 }
 
@@ -643,24 +998,38 @@ static int check_auto_bluff(game *g, int future)
 	/* Get player pointer */
 	p = &g->p[g->turn];
 
-	/* Check for uncallable bluff */
-	for (i = 1; i < DECK_SIZE; i++)
+	/* Loop over our active category 3 cards */
+	for (i = next_special(p, 3, 0); i; i = next_special(p, 3, i))
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Check for "you may not call bluff" text */
+		if (c->d_ptr->special_effect == (S3_YOU_MAY_NOT | S3_CALL_BLUFF))
+		{
+			/* Bluff can't be called */
+			return 99;
+		}
+	}
+
+	/* Check for uncallable bluff card we can still play */
+	for (i = 1; future && i < DECK_SIZE; i++)
 	{
 		/* Get card pointer */
 		c = &p->deck[i];
 
+		/* Skip cards not in hand */
+		if (c->where != LOC_HAND) continue;
+
 		/* Skip cards without category 3 special text */
 		if (c->d_ptr->special_cat != 3) continue;
 
 		/* Check for "you may not call bluff" text */
-		if (c->d_ptr->special_effect !=(S3_YOU_MAY_NOT | S3_CALL_BLUFF))
+		if (c->d_ptr->special_effect == (S3_YOU_MAY_NOT | S3_CALL_BLUFF))
 		{
-			continue;
+			/* Bluff won't be callable */
+			return 99;
 		}
-
-		if (c->active && !c->text_ignored) return 99;
-
-		if (c->where == LOC_HAND && future) return 99;
 	}
 
 	/* Loop over cards */
@@ -705,8 +1074,10 @@ static int check_auto_bluff(game *g, int future)
  */
 static int legal_support(game *g, action *legal, int n)
 {
+	ai_search *s = g->search;
 	player *p;
 	card *c, *d;
+	unsigned int eligible;
 	int i, j;
 
 	/* Get player pointer */
@@ -715,6 +1086,9 @@ static int legal_support(game *g, action *legal, int n)
 	/* Check for no support actions allowed */
 	if (!support_allowed(g)) return n;
 
+	/* Get cards eligible to be played */
+	eligible = eligible_cards(g);
+
 	/* Look for played ships */
 	for (i = 1; i < DECK_SIZE; i++)
 	{
@@ -722,7 +1096,7 @@ static int legal_support(game *g, action *legal, int n)
 		c = &p->deck[i];
 
 		/* Don't load ships when checking forced retreat */
-		if (checking_retreat) break;
+		if (s->checking_retreat) break;
 
 		/* Skip inactive cards */
 		if (!c->active) continue;
@@ -737,7 +1111,7 @@ static int legal_support(game *g, action *legal, int n)
 			d = &p->deck[j];
 
 			/* Skip ineligible cards */
-			if (!card_eligible(g, d->d_ptr)) continue;
+			if (!(eligible & (1U << j))) continue;
 
 			/* Skip cards that aren't character/support/booster */
 			if (d->d_ptr->type != TYPE_CHARACTER &&
@@ -772,7 +1146,7 @@ static int legal_support(game *g, action *legal, int n)
 		c = &p->deck[i];
 
 		/* Skip ineligible cards */
-		if (!card_eligible(g, c->d_ptr)) continue;
+		if (!(eligible & (1U << i))) continue;
 
 		/* Skip cards without bluff icons */
 		if (!(c->icons & ICON_BLUFF_MASK)) continue;
@@ -783,7 +1157,7 @@ static int legal_support(game *g, action *legal, int n)
 		legal[n++].arg = c->d_ptr;
 
 		/* Any bluff is as good as another when checking retreat */
-		if (checking_retreat) break;
+		if (s->checking_retreat) break;
 	}
 
 	/* Return length of list */
@@ -797,8 +1171,10 @@ static int legal_support(game *g, action *legal, int n)
  */
 static int legal_act(game *g, action *legal)
 {
+	ai_search *s = g->search;
 	player *p, *opp;
 	card *c;
+	unsigned int eligible, mask;
 	int power;
 	int i, n = 0;
 	
@@ -845,7 +1221,7 @@ static int legal_act(game *g, action *legal)
 				if (!c->bluff) continue;
 
 				/* Don't reveal when checking retreat */
-				if (!checking_retreat)
+				if (!s->checking_retreat)
 				{
 					/* Add "reveal" action */
 					legal[n].act = ACT_REVEAL;
@@ -916,6 +1292,12 @@ static int legal_act(game *g, action *legal)
 			/* Always use special text first if possible */
 			if (n) return n;
 
+			/* Get cards eligible to be played */
+			eligible = eligible_cards(g);
+
+			/* Start with no candidate cards */
+			mask = 0;
+
 			/* Look for cards to play */
 			for (i = p->last_played + 1; i < DECK_SIZE; i++)
 			{
@@ -926,7 +1308,7 @@ static int legal_act(game *g, action *legal)
 				if (c->random_fake) continue;
 
 				/* Skip ineligible cards */
-				if (!card_eligible(g, c->d_ptr)) continue;
+				if (!(eligible & (1U << i))) continue;
 
 				/* Check for illegal leadership card */
 				if (c->d_ptr->type == TYPE_LEADERSHIP &&
@@ -944,15 +1326,31 @@ static int legal_act(game *g, action *legal)
 				if (c->d_ptr->type == TYPE_SUPPORT &&
 				    p->phase != PHASE_SUPPORT) continue;
 
-				/* Check card legality */
-				if (!card_allowed(g, c->d_ptr)) continue;
+				/* Card is a candidate */
+				mask |= 1U << i;
+			}
+
+			/* Check legality of all candidates at once */
+			mask = allowed_cards(g, mask);
+
+			/* Loop over cards that may be played */
+			while (mask)
+			{
+				/* Get lowest index */
+				i = ffs(mask) - 1;
+
+				/* Remove card from mask */
+				mask &= mask - 1;
+
+				/* Get card pointer */
+				c = &p->deck[i];
 
 				/* Check for optional special effect */
 				if (((c->d_ptr->special_cat == 4 &&
 				      c->d_ptr->special_effect & S4_OPTIONAL) ||
 				     (c->d_ptr->special_cat == 8 &&
 				      c->d_ptr->special_effect & S8_OPTIONAL))&&
-				    !checking_retreat)
+				    !s->checking_retreat)
 				{
 					/* Playing card without effect */
 					legal[n].act = ACT_PLAY_NO;
@@ -977,7 +1375,7 @@ static int legal_act(game *g, action *legal)
 			}
 
 			/* Check every action when checking retreat */
-			if (checking_retreat && n > 0) break;
+			if (s->checking_retreat && n > 0) break;
 
 			/* Advance phase allowed unless character is unplayed */
 			if (p->phase != PHASE_CHAR || p->char_played)
@@ -1089,20 +1487,11 @@ static int legal_act(game *g, action *legal)
 	if (p->phase == PHASE_CHAR) return n;
 
 	/* Check for active opponent "discard or..." cards */
-	for (i = 1; i < DECK_SIZE; i++)
+	for (i = next_special(opp, 7, 0); i; i = next_special(opp, 7, i))
 	{
 		/* Get card pointer */
 		c = &opp->deck[i];
 
-		/* Skip non-active cards */
-		if (!c->active) continue;
-
-		/* Skip cards with text ignored */
-		if (c->text_ignored) continue;
-
-		/* Skip non-category 7 cards */
-		if (c->d_ptr->special_cat != 7) continue;
-
 		/* Skip non-discard cards */
 		if (!(c->d_ptr->special_effect & S7_DISCARD_MASK)) continue;
 
@@ -1347,8 +1736,10 @@ static void perform_act(game *g, action a)
 	}
 }
 
-/* Foward declaration */
+/* Foward declarations */
 static double find_action(game *g);
+static double solve_score(game *g, int old_turn);
+static void add_candidate(game *g, double score);
 
 /*
  * Check if current player must retreat.
@@ -1359,6 +1750,7 @@ static double find_action(game *g);
  */
 static void check_retreat(game *g)
 {
+	ai_search *s = g->search;
 	game sim;
 	player *p, *opp;
 	card *c;
@@ -1377,25 +1769,22 @@ static void check_retreat(game *g)
 		/* Get card pointer */
 		c = &opp->deck[i];
 
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Check for bluff card */
-		if (c->bluff) bluff = 1;
-
-		/* Skip cards with text ignored */
-		if (c->text_ignored) continue;
-
-		/* Skip cards without category 3 special text */
-		if (c->d_ptr->special_cat != 3) continue;
+		/* Check for active bluff card */
+		if (c->active && c->bluff) bluff = 1;
+	}
 
-		/* Skip cards that don't disallow calling bluff */
-		if (c->d_ptr->special_effect !=(S3_YOU_MAY_NOT | S3_CALL_BLUFF))
-			continue;
+	/* Loop over opponent's active category 3 cards */
+	for (i = next_special(opp, 3, 0); i; i = next_special(opp, 3, i))
+	{
+		/* Get card pointer */
+		c = &opp->deck[i];
 
-		/* Assume no bluff cards are in play */
-		bluff = 0;
-		break;
+		/* Check for card that disallows calling bluff */
+		if (c->d_ptr->special_effect == (S3_YOU_MAY_NOT | S3_CALL_BLUFF))
+		{
+			/* Assume no bluff cards are in play */
+			bluff = 0;
+		}
 	}
 
 	/* Do not check for forced retreat if bluff may be called */
@@ -1423,7 +1812,7 @@ static void check_retreat(game *g)
 	/* Check for not all cards in hand known */
 	if (!all_known)
 	{
-		/* Pretend all unknown cards are in hand */
+		/* Pretend all unknown cards that may be in hand are */
 		for (i = 1; i < DECK_SIZE; i++)
 		{
 			/* Get card pointer */
@@ -1432,12 +1821,18 @@ static void check_retreat(game *g)
 			/* Skip cards with known locations */
 			if (c->loc_known && !c->random_fake) continue;
 
+			/* Skip cards that can't be in hand */
+			if (!c->hand_prob && !c->random_fake) continue;
+
 			/* Clear "random" flag */
 			c->random_fake = 0;
 
 			/* Move card to hand */
 			c->where = LOC_HAND;
 
+			/* Card no longer counts towards power */
+			update_power(&sim, sim.turn, c);
+
 			/* Count cards moved */
 			moved++;
 		}
@@ -1447,21 +1842,21 @@ static void check_retreat(game *g)
 	if (moved > 15) return;
 
 	/* Set retreat flag */
-	must_retreat = 1;
-	checking_retreat = 1;
+	s->must_retreat = 1;
+	s->checking_retreat = 1;
 
 	/* Simulate possible actions */
 	find_action(&sim);
 
 	/* Check for retreat flag still set */
-	if (must_retreat)
+	if (s->must_retreat)
 	{
 		/* Force current player to retreat before evaluating score */
 		retreat(g);
 	}
 
 	/* Clear retreat check flag */
-	checking_retreat = 0;
+	s->checking_retreat = 0;
 }
 
 /*
@@ -1472,6 +1867,7 @@ static void check_retreat(game *g)
  */
 static double check_decline(game *g, int who)
 {
+	ai_search *s = g->search;
 	game sim;
 	player *opp = &g->p[who];
 	double score, b_s;
@@ -1483,7 +1879,7 @@ static double check_decline(game *g, int who)
 	if (opp->stack[LOC_HAND] == 0) return b_s;
 
 	/* Set checking flag */
-	checking_decline = 1;
+	s->checking_decline = 1;
 
 	/* Simulate game */
 	simulate_game(&sim, g);
@@ -1514,41 +1910,109 @@ static double check_decline(game *g, int who)
 	if (score < b_s) b_s = score;
 
 	/* Clear checking flag */
-	checking_decline = 0;
+	s->checking_decline = 0;
 
 	/* Return worst case */
 	return b_s;
 }
 
+/*
+ * Start a new choice node after the existing ones.
+ */
+static node *new_node(ai_search *s)
+{
+	node *n_ptr;
+
+	/* Check for full node array */
+	if (s->node_len == s->max_nodes)
+	{
+		/* Grow array */
+		s->max_nodes = s->max_nodes * 2 + 10;
+
+		/* Reallocate array */
+		s->nodes = (node *)realloc(s->nodes,
+		                           sizeof(node) * s->max_nodes);
+	}
+
+	/* Get node */
+	n_ptr = &s->nodes[s->node_len];
+
+	/* Start combinations after previous node's */
+	n_ptr->first = s->node_len ? s->nodes[s->node_len - 1].first +
+	                          s->nodes[s->node_len - 1].num_legal : 0;
+
+	/* No combinations yet */
+	n_ptr->num_legal = 0;
+
+	/* Return node */
+	return n_ptr;
+}
+
+/*
+ * Add a legal combination to the choice node being built.
+ */
+static void add_legal(ai_search *s, int chosen)
+{
+	node *n_ptr = &s->nodes[s->node_len];
+	int pos;
+
+	/* Get arena position */
+	pos = n_ptr->first + n_ptr->num_legal;
+
+	/* Check for full arena */
+	if (pos == s->max_arena)
+	{
+		/* Grow arena */
+		s->max_arena = s->max_arena * 2 + 1024;
+
+		/* Reallocate arena */
+		s->choose_arena = (int *)realloc(s->choose_arena,
+		                              sizeof(int) * s->max_arena);
+	}
+
+	/* Add combination */
+	s->choose_arena[pos] = chosen;
+
+	/* One more combination */
+	n_ptr->num_legal++;
+}
+
 /*
  * Handle a choice to be made.
  */
 static double choose_action(game *g)
 {
+	ai_search *s = g->search;
 	game sim;
 	design *list[DECK_SIZE], **choices;
 	node *n_ptr;
 	void *data;
 	double score, b_s = -1;
-	int old_turn;
-	int best_combo = 0;
+	int old_turn, pos;
+	int best_combo = 0, combo;
 	int i, j, num_chosen;
 
 	/* Get current player's turn */
 	old_turn = g->turn;
 
-	/* Get pointer to choice node */
-	n_ptr = &nodes[node_pos];
+	/* Remember choice node (the node array may move while searching) */
+	pos = s->node_pos;
 
 	/* Track current choice node */
-	node_pos++;
-	best_path_pos++;
+	s->node_pos++;
+	s->best_path_pos++;
 
 	/* Loop over choices */
-	for (i = 0; i < n_ptr->num_legal; i++)
+	for (i = 0; i < s->nodes[pos].num_legal; i++)
 	{
 		/* Avoid unnecessary work when checking for forced retreat */
-		if (checking_retreat && !must_retreat) break;
+		if (s->checking_retreat && !s->must_retreat) break;
+
+		/* Get pointer to choice node */
+		n_ptr = &s->nodes[pos];
+
+		/* Get combination */
+		combo = s->choose_arena[n_ptr->first + i];
 
 		/* Clear number chosen */
 		num_chosen = 0;
@@ -1560,21 +2024,19 @@ static double choose_action(game *g)
 		data = n_ptr->data;
 
 		/* Loop over combination */
-		for (j = 0; (1 << j) <= n_ptr->legal[i]; j++)
+		for (j = 0; (1 << j) <= combo; j++)
 		{
 			/* Check for bit set */
-			if (n_ptr->legal[i] & (1 << j))
+			if (combo & (1 << j))
 			{
 				/* Add choice to list */
 				list[num_chosen++] = choices[j];
 			}
 		}
 
-#ifdef DEBUG
 		/* Remember current path */
-		cur_path[best_path_pos].act = ACT_CHOOSE;
-		cur_path[best_path_pos].chosen = n_ptr->legal[i];
-#endif
+		s->cur_path[s->best_path_pos].act = ACT_CHOOSE;
+		s->cur_path[s->best_path_pos].chosen = combo;
 
 		/* Simulate game */
 		simulate_game(&sim, g);
@@ -1585,11 +2047,18 @@ static double choose_action(game *g)
 			printf("Callback failed!\n");
 		}
 
+		/* Check for solving */
+		if (s->solving)
+		{
+			/* Search to the end of the game */
+			score = solve_score(&sim, old_turn);
+		}
+
 		/* Check for turn change */
-		if (sim.turn != old_turn)
+		else if (sim.turn != old_turn)
 		{
 			/* Are we checking forced retreat */
-			if (checking_retreat)
+			if (s->checking_retreat)
 			{
 				/* Score is unimportant */
 				score = 0;
@@ -1598,6 +2067,9 @@ static double choose_action(game *g)
 			{
 				/* Assume worst-case response from opponent */
 				score = check_decline(&sim, sim.sim_turn);
+
+				/* Remember end of turn */
+				add_candidate(&sim, score);
 			}
 		}
 		else
@@ -1611,26 +2083,26 @@ static double choose_action(game *g)
 		{
 			/* Remember best */
 			b_s = score;
-			best_combo = n_ptr->legal[i];
+			best_combo = combo;
 		}
 	}
 
 	/* Remove node from list */
-	node_pos--;
-	node_len--;
+	s->node_pos--;
+	s->node_len--;
 
 	/* Return to current path position */
-	best_path_pos--;
+	s->best_path_pos--;
 
 	/* Check for better actions than previously discovered */
-	if (!checking_retreat && b_s >= best_path_score)
+	if (!s->checking_retreat && b_s >= s->best_path_score)
 	{
 		/* Store action in best path */
-		best_path[best_path_pos].act = ACT_CHOOSE;
-		best_path[best_path_pos].chosen = best_combo;
+		s->best_path[s->best_path_pos].act = ACT_CHOOSE;
+		s->best_path[s->best_path_pos].chosen = best_combo;
 
 		/* Save best score seen */
-		best_path_score = b_s;
+		s->best_path_score = b_s;
 	}
 
 	/* Return best score */
@@ -1638,268 +2110,1574 @@ static double choose_action(game *g)
 }
 
 /*
- * Find the best "action path" available from the given state.
- *
- * We also return the score of the endstate that will result.
+ * Score the state after an action, continuing the search if needed.
+ */
+static double outcome_score(game *g, action a, int old_turn)
+{
+	ai_search *s = g->search;
+	double score;
+
+	/* Check for retreat */
+	if (a.act == ACT_RETREAT && s->node_pos == s->node_len)
+	{
+		/* Get score */
+		score = eval_game(g, g->sim_turn);
+
+		/* Remember end of action */
+		add_candidate(g, score);
+
+		/* Return score */
+		return score;
+	}
+
+	/* Check for turn change */
+	if (g->turn != old_turn)
+	{
+		/* Check for inevitable retreat from opponent */
+		check_retreat(g);
+
+		/* Get score */
+		score = eval_game(g, g->sim_turn);
+
+		/* Clear must retreat flag */
+		s->must_retreat = 0;
+
+		/* Remember end of turn */
+		add_candidate(g, score);
+
+		/* Return score */
+		return score;
+	}
+
+	/* Continue searching */
+	return find_action(g);
+}
+
+/*
+ * Score an action that involved a random event.
  *
- * We return -1 if no legal actions are available.
+ * The outcome in "first" (the action already performed from "g") is
+ * searched as usual, and the action is then performed again with other
+ * random seeds and each outcome searched.  We return the average score.
  *
- * This function is recursive.
+ * The best path is only taken from the first outcome, and only kept if
+ * the average is the best score seen.  Since the other outcomes can't
+ * change the path, they are not searched for random events themselves.
  */
-static double find_action(game *g)
+static double chance_score(game *g, action a, game *first)
 {
+	ai_search *s = g->search;
 	game sim;
-	player *p;
-	int old_turn;
-	int i, n;
-	action legal[MAX_ACTION], best_act;
-	double score, b_s = -1;
+	action old_path[MAX_ACTION];
+	double old_best, total;
+	int k, pos;
 
-	/* Get player pointer */
-	p = &g->p[g->turn];
+	/* Path after this action */
+	pos = s->best_path_pos;
 
-	/* Get current player's turn */
-	old_turn = g->turn;
+	/* Remember best path after this action and its score */
+	memcpy(old_path + pos, s->best_path + pos,
+	       sizeof(action) * (MAX_ACTION - pos));
+	old_best = s->best_path_score;
 
-	/* Check for game over */
-	if (g->game_over)
+	/* Store best path of first outcome regardless of score */
+	s->best_path_score = -2.0;
+
+	/* Search first outcome */
+	total = outcome_score(first, a, g->turn);
+
+	/* Keep other outcomes from storing paths */
+	s->best_path_score = 2.0;
+
+	/* Do not sample within other outcomes */
+	s->sampling = 1;
+
+	/* Loop over other outcomes */
+	for (k = 1; k < ai_chance_samples; k++)
 	{
-		/* Clear any choice nodes that haven't been examined */
-		node_len = node_pos;
+		/* Stop when out of budget */
+		if (s->search_nodes >= ai_search_budget) break;
+
+		/* Copy game */
+		simulate_game(&sim, g);
 
-		/* Return end of game score */
-		return eval_game(g, g->sim_turn);
+		/* Use a different outcome */
+		sim.random_seed += k;
+
+		/* Perform action */
+		perform_act(&sim, a);
+
+		/* Add score of outcome */
+		total += outcome_score(&sim, a, g->turn);
 	}
 
-	/* Check for choice to make */
-	if (node_pos < node_len)
+	/* Done sampling */
+	s->sampling = 0;
+
+	/* Average over outcomes */
+	total /= k;
+
+	/* Check for better than best path seen */
+	if (total >= old_best)
 	{
-		/* Handle choice node instead of normal */
-		return choose_action(g);
+		/* Keep path of first outcome */
+		s->best_path_score = total;
+	}
+	else
+	{
+		/* Restore previous best path */
+		memcpy(s->best_path + pos, old_path + pos,
+		       sizeof(action) * (MAX_ACTION - pos));
+		s->best_path_score = old_best;
 	}
 
-	/* Avoid needlees work when checking for forced retreat */
-	if (checking_retreat && !must_retreat) return 0;
+	/* Return average */
+	return total;
+}
 
-	/* Get legal actions to take */
-	n = legal_act(g, legal);
+/*
+ * Return the final result of a finished game for the given player.
+ */
+static double game_result(game *g, int who)
+{
+	double result;
 
-	/* Check for no legal actions */
-	if (!n) return -1;
+	/* Check for win */
+	if (g->p[who].crystals)
+	{
+		/* Compute margin of victory */
+		result = .5 + g->p[who].crystals * 0.1;
 
-	/* Check for only one possible action */
-	if (n == 1)
+		/* Check for instant win */
+		if (g->p[who].instant_win) result = 1.0;
+	}
+	else
 	{
-		/* Increase path position for future searching */
-		best_path_pos++;
+		/* Compute margin of defeat */
+		result = .5 - g->p[!who].crystals * 0.1;
 
-#ifdef DEBUG
-		/* Remember current path */
-		cur_path[best_path_pos] = legal[0];
-#endif
+		/* Check for instant loss */
+		if (g->p[!who].instant_win) result = 0.0;
+	}
 
-		/* Perform that action */
-		perform_act(g, legal[0]);
+	/* Return result */
+	return result;
+}
 
-		/* Check for turn change */
-		if (g->turn != old_turn)
-		{
-			/* Are we checking opponent's response */
-			if (checking_retreat)
-			{
-				/* Score is unimportant */
-				score = 0.0;
+/*
+ * Check whether nothing is hidden from either player: both draw piles are
+ * empty and every card's location is known.
+ */
+static int endgame_known(game *g)
+{
+	player *p;
+	int i, j;
 
-				/* We must not be forced to retreat */
-				must_retreat = 0;
-			}
-			else
-			{
-				/* Check for inevitable retreat from opponent */
-				check_retreat(g);
+	/* Loop over players */
+	for (i = 0; i < 2; i++)
+	{
+		/* Get player pointer */
+		p = &g->p[i];
 
-				/* Get score */
-				score = eval_game(g, g->sim_turn);
+		/* Check for cards left to draw */
+		if (p->stack[LOC_DRAW]) return 0;
 
-				/* Clear must retreat flag */
-				must_retreat = 0;
-			}
+		/* Loop over cards */
+		for (j = 1; j < DECK_SIZE; j++)
+		{
+			/* Check for unknown location */
+			if (!p->deck[j].loc_known) return 0;
 		}
+	}
 
-		/* Continue searching */
-		else score = find_action(g);
-
-		/* Return to current path position */
-		best_path_pos--;
+	/* Everything is known */
+	return 1;
+}
 
-		/* Check for better actions than previously discovered */
-		if (!checking_retreat && score >= best_path_score)
-		{
-			/* Store action in best path */
-			best_path[best_path_pos] = legal[0];
+/*
+ * Hash a game state (FNV-1a over the words of the structure).
+ *
+ * Every position seen while solving is copied from the same original, so
+ * identical states have identical bytes.
+ */
+static uint64_t hash_game(game *g)
+{
+	char *bytes = (char *)g;
+	uint64_t w, h = 14695981039346656037ULL;
+	int i;
 
-			/* Save best score seen */
-			best_path_score = score;
-		}
+	/* Loop over whole words */
+	for (i = 0; i < sizeof(game) / sizeof(uint64_t); i++)
+	{
+		/* Get word (copied, so that stores to the game are seen) */
+		memcpy(&w, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
 
-		/* Return score */
-		return score;
+		/* Mix in word */
+		h = (h ^ w) * 1099511628211ULL;
 	}
 
-	/* Increase path position for future searching */
-	best_path_pos++;
+	/* Spread high bits into low ones used for table index */
+	return h ^ (h >> 32);
+}
 
-	/* Loop over available actions */
-	for (i = 0; i < n; i++)
-	{
-#ifdef DEBUG
-		/* Remember current path */
-		cur_path[best_path_pos] = legal[i];
-#endif
+/*
+ * Solve the rest of the game from the start of a new turn.
+ *
+ * The player whose turn it now is searches their own turn, with their
+ * turn ending in another call to this function.  Results are remembered
+ * by state, since the same position is often reached through different
+ * orders of actions.
+ *
+ * We return the result from the point of view of the player whose turn
+ * just ended.
+ */
+static double solve_turn(game *g)
+{
+	ai_search *s = g->search;
+	game sim;
+	action old_path[MAX_ACTION];
+	solve_entry *e;
+	uint64_t hash;
+	double old_best, value;
+	int old_pos, old_len;
 
-		/* Avoid unnecessary work when checking for forced retreat */
-		if (checking_retreat && !must_retreat) break;
+	/* Check for game over */
+	if (g->game_over) return game_result(g, g->sim_turn);
 
-		/* Copy game */
-		simulate_game(&sim, g);
+	/* Simulate game */
+	simulate_game(&sim, g);
 
-		/* Perform action */
-		perform_act(&sim, legal[i]);
+	/* Search from point of view of player to move */
+	sim.sim_turn = sim.turn;
 
-		/* Check for retreat */
-		if (legal[i].act == ACT_RETREAT && node_pos == node_len)
-		{
-			/* Are we checking for forced retreat */
-			if (checking_retreat)
-			{
-				/* Score is unimportant */
-				score = 0;
-			}
-			else
-			{
-				/* Get score */
-				score = eval_game(&sim, sim.sim_turn);
-			}
-		}
+	/* Get table entry */
+	hash = hash_game(&sim);
+	e = &s->solve_table[hash % SOLVE_SIZE];
 
-		/* Normal action */
-		else
-		{
-			/* Continue searching */
-			score = find_action(&sim);
-		}
+	/* Check for solved position */
+	if (e->hash == hash) return 1.0 - e->value;
 
-		/* Check for better score among actions */
-		if (score >= b_s)
-		{
-			/* Remember best */
-			b_s = score;
-			best_act = legal[i];
-		}
-	}
+	/* Save search state of ended turn */
+	memcpy(old_path, s->best_path, sizeof(s->best_path));
+	old_pos = s->best_path_pos;
+	old_best = s->best_path_score;
+	old_len = s->node_len;
 
-	/* Return to current path position */
-	best_path_pos--;
+	/* Start new search */
+	s->best_path_pos = 0;
+	s->best_path_score = -1;
+	s->node_len = s->node_pos;
 
-	/* Check for better actions than previously discovered */
-	if (!checking_retreat && b_s >= best_path_score)
-	{
-		/* Store action in best path */
-		best_path[best_path_pos] = best_act;
+	/* Search new turn */
+	value = find_action(&sim);
 
-		/* Save best score seen */
-		best_path_score = b_s;
+	/* Restore search state */
+	memcpy(s->best_path, old_path, sizeof(s->best_path));
+	s->best_path_pos = old_pos;
+	s->best_path_score = old_best;
+	s->node_len = old_len;
+
+	/* Remember result unless search was cut short */
+	if (!s->solve_failed)
+	{
+		/* Store entry */
+		e->hash = hash;
+		e->value = value;
 	}
 
-	/* Return best score */
-	return b_s;
+	/* Return result for previous player */
+	return 1.0 - value;
 }
 
 /*
- * Have the AI player take an action.
+ * Score the state after an action while solving.
  */
-static void ai_take_action(game *g)
+static double solve_score(game *g, int old_turn)
+{
+	/* Check for game over */
+	if (g->game_over) return game_result(g, g->sim_turn);
+
+	/* Check for turn change */
+	if (g->turn != old_turn) return solve_turn(g);
+
+	/* Continue searching */
+	return find_action(g);
+}
+
+/*
+ * Solve a fully known endgame exactly, leaving the best path as the
+ * normal search would.
+ *
+ * Return 0 if the game isn't in such an endgame or the solver ran out of
+ * budget, in which case the normal search should be used.
+ */
+static int solve_endgame(game *g)
 {
+	ai_search *s = g->search;
 	game sim;
-	player *p;
-	action current;
-	int old_turn;
 
-	/* Get player pointer */
-	p = &g->p[g->turn];
+	/* Check for solver disabled or hidden information */
+	if (!ai_endgame_budget || !endgame_known(g)) return 0;
+
+	/* Check for too many cards to solve */
+	if (g->p[0].stack[LOC_HAND] + g->p[1].stack[LOC_HAND] >
+	    SOLVE_MAX_HAND) return 0;
+
+	/* Allocate table on first use */
+	if (!s->solve_table)
+	{
+		/* Allocate table */
+		s->solve_table = (solve_entry *)malloc(sizeof(solve_entry) *
+		                                    SOLVE_SIZE);
+	}
+
+	/* Forget positions from previous endgames */
+	memset(s->solve_table, 0, sizeof(solve_entry) * SOLVE_SIZE);
+
+	/* Start solving */
+	s->solving = 1;
+	s->solve_failed = 0;
+
+	/* Simulate game */
+	simulate_game(&sim, g);
+
+	/* Find best action path */
+	find_action(&sim);
+
+	/* Done solving */
+	s->solving = 0;
+
+	/* Check for success */
+	if (!s->solve_failed) return 1;
+
+	/* Clear partial best path */
+	s->best_path_pos = 0;
+	s->best_path_score = -1;
+
+	/* Give normal search its own budget */
+	s->search_nodes = 0;
+
+	/* Use normal search */
+	return 0;
+}
+
+/*
+ * Remember a position where the searched turn ended, if it is among the
+ * best few seen.
+ *
+ * Positions reached in several ways are kept once, with the best score.
+ */
+static void add_candidate(game *g, double score)
+{
+	ai_search *s = g->search;
+	candidate *c = NULL;
+	uint64_t hash;
+	int i;
+
+	/* Check for no lookahead or searching something else */
+	if (!s->cands || s->checking_retreat || s->checking_decline ||
+	    s->sampling || s->solving) return;
+
+	/* Get hash of position */
+	hash = hash_game(g);
+
+	/* Look for position already seen */
+	for (i = 0; i < s->num_cands; i++)
+	{
+		/* Check for match */
+		if (s->cands[i].hash == hash)
+		{
+			/* Keep better path */
+			if (score <= s->cands[i].score) return;
+
+			/* Replace */
+			c = &s->cands[i];
+			break;
+		}
+	}
+
+	/* Check for new position */
+	if (!c)
+	{
+		/* Check for room */
+		if (s->num_cands < LOOK_WIDTH)
+		{
+			/* Use next entry */
+			c = &s->cands[s->num_cands++];
+		}
+		else
+		{
+			/* Find worst entry */
+			c = &s->cands[0];
+			for (i = 1; i < s->num_cands; i++)
+			{
+				/* Check for worse */
+				if (s->cands[i].score < c->score)
+				{
+					/* Remember worst */
+					c = &s->cands[i];
+				}
+			}
+
+			/* Check for not better than worst */
+			if (score <= c->score) return;
+		}
+	}
+
+	/* Copy position */
+	c->state = *g;
+	c->hash = hash;
+	c->score = score;
+
+	/* Copy actions leading here */
+	c->len = s->best_path_pos;
+	memcpy(c->path, s->cur_path + 1, sizeof(action) * c->len);
+}
+
+/*
+ * Pick which of a player's cards with unknown locations are in their hand,
+ * according to the opponent's belief of each being there.
+ *
+ * The number of cards in hand and in the draw pile stay the same.
+ */
+static void sample_hand(game *g, int who)
+{
+	player *p = &g->p[who];
+	card *c, *list[DECK_SIZE];
+	double weight[DECK_SIZE], total, r;
+	int i, n = 0, num_hand = 0;
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Skip cards with known locations */
+		if (c->loc_known) continue;
+
+		/* Skip cards not in hand or draw pile */
+		if (c->where != LOC_HAND && c->where != LOC_DRAW) continue;
+
+		/* Count cards in hand to replace */
+		if (c->where == LOC_HAND) num_hand++;
+
+		/* Move card to draw pile for now */
+		c->where = LOC_DRAW;
+
+		/* Add card to list */
+		weight[n] = c->hand_prob;
+		list[n++] = c;
+	}
+
+	/* Pick cards for hand */
+	while (num_hand--)
+	{
+		/* Total weight of cards left */
+		for (total = 0, i = 0; i < n; i++) total += weight[i];
+
+		/* Pick a point in the total */
+		r = total * myrand(&g->random_seed) / 32768.0;
+
+		/* Find card at that point */
+		for (i = 0; i < n - 1; i++)
+		{
+			/* Check for chosen card (skipping unlikely ones) */
+			if (weight[i] > 0 && r < weight[i]) break;
+
+			/* Move past card */
+			r -= weight[i];
+		}
+
+		/* Put card in hand */
+		list[i]->where = LOC_HAND;
+
+		/* Remove from list */
+		list[i] = list[--n];
+		weight[i] = weight[n];
+	}
+}
+
+/*
+ * Sort collected positions by score (best first).
+ */
+static void sort_candidates(candidate *list, int n)
+{
+	candidate tmp;
+	int i, j;
+
+	/* Loop over positions */
+	for (i = 1; i < n; i++)
+	{
+		/* Insert into sorted part */
+		tmp = list[i];
+		for (j = i; j > 0 && list[j - 1].score < tmp.score; j--)
+		{
+			/* Move down */
+			list[j] = list[j - 1];
+		}
+		list[j] = tmp;
+	}
+}
+
+/* Forward declaration */
+static double search_turn(game *g, int depth);
+
+/*
+ * Look ahead from a position where a turn ended.
+ *
+ * Whoever plays next searches their turn from their point of view.  The
+ * first time the opponent of the player deciding plays, their hand is
+ * drawn from that player's belief.  As with random events, the result is
+ * averaged over several draws (and the random events of the turn) when
+ * sampling is enabled.  We return the result for the player whose turn
+ * ended.
+ */
+static double deepen(candidate *c, int depth)
+{
+	ai_search *s = c->state.search;
+	game sim;
+	int who, hidden, k;
+	double score, total = 0;
+
+	/* Check for game over */
+	if (c->state.game_over) return c->score;
+
+	/* Player whose turn ended */
+	who = c->state.sim_turn;
+
+	/* Remember whose hand is hidden */
+	hidden = s->look_hidden;
+
+	/* Loop over outcomes */
+	for (k = 0; k < ai_chance_samples; k++)
+	{
+		/* Stop when out of budget (after first outcome) */
+		if (k && s->search_nodes >= ai_search_budget) break;
+
+		/* Simulate game */
+		simulate_game(&sim, &c->state);
+
+		/* Use a different outcome */
+		sim.random_seed += k;
+
+		/* Search from point of view of player to move */
+		sim.sim_turn = sim.turn;
+
+		/* Check for actual hand hidden from player deciding */
+		if (sim.turn == hidden)
+		{
+			/* Replace with hand drawn from belief */
+			sample_hand(&sim, sim.turn);
+
+			/* Hand is no longer actual */
+			s->look_hidden = -1;
+		}
+
+		/* Search next turn */
+		score = search_turn(&sim, depth);
+
+		/* Restore hidden hand */
+		s->look_hidden = hidden;
+
+		/* Check for other player's turn */
+		if (sim.turn != who) score = 1.0 - score;
+
+		/* Add score of outcome */
+		total += score;
+	}
+
+	/* Average over outcomes */
+	return total / k;
+}
+
+/*
+ * Check whether the decision being made should stop searching.
+ *
+ * A cancelled decision stops at once.  One out of time stops once some
+ * best path is known, or at once while solving (so that the normal search
+ * can find one instead).
+ */
+static int search_stopped(ai_search *s)
+{
+	struct timeval now;
+
+	/* Check for cancelled decision */
+	if (s->cancelled) return 1;
+
+	/* Check for no time limit */
+	if (!s->timed) return 0;
+
+	/* Look at clock every so often */
+	if (!s->out_of_time && !(s->search_nodes & 255))
+	{
+		/* Get current time */
+		gettimeofday(&now, NULL);
+
+		/* Check for deadline passed */
+		if (timercmp(&now, &s->deadline, >=)) s->out_of_time = 1;
+	}
+
+	/* Stop once out of time and something is known */
+	return s->out_of_time && (s->solving || s->best_path_score >= 0);
+}
+
+/*
+ * Search the current turn, looking the given number of turns past it.
+ *
+ * The turn is searched as usual, collecting the best few positions where
+ * it ends.  Each is then looked ahead from, best first, while within the
+ * search budget (but always at least one).  The best path is left set to
+ * the actions leading to the best of these.
+ *
+ * Cutting the turn's alternatives down to a few keeps the search from
+ * growing with the product of the number of alternatives of each turn.
+ */
+static double search_turn(game *g, int depth)
+{
+	ai_search *s = g->search;
+	candidate list[LOOK_WIDTH], *old_cands;
+	double score, b_s = -1;
+	int old_num, i, j, best = 0;
+
+	/* Start new path */
+	s->best_path_pos = 0;
+	s->best_path_score = -1;
+
+	/* Check for no lookahead */
+	if (!depth) return find_action(g);
+
+	/* Collect end-of-turn positions */
+	old_cands = s->cands;
+	old_num = s->num_cands;
+	s->cands = list;
+	s->num_cands = 0;
+
+	/* Search turn */
+	score = find_action(g);
+
+	/* Stop collecting */
+	j = s->num_cands;
+	s->cands = old_cands;
+	s->num_cands = old_num;
+
+	/* Check for nothing to look ahead from */
+	if (!j) return score;
+
+	/* Sort by score (best first) */
+	sort_candidates(list, j);
+
+	/* Loop over positions */
+	for (i = 0; i < j; i++)
+	{
+		/* Stop when out of budget or time */
+		if (i && (s->search_nodes >= ai_search_budget ||
+		          s->out_of_time || s->cancelled)) break;
+
+		/* Get score after looking ahead */
+		score = deepen(&list[i], depth - 1);
+
+		/* Check for better */
+		if (score >= b_s)
+		{
+			/* Remember best */
+			b_s = score;
+			best = i;
+		}
+	}
+
+	/* Set best path to reach best position */
+	memcpy(s->best_path, list[best].path, sizeof(action) * list[best].len);
+	s->best_path_pos = 0;
+	s->best_path_score = b_s;
+
+	/* Return best score */
+	return b_s;
+}
+
+/*
+ * Find the best "action path" available from the given state.
+ *
+ * We also return the score of the endstate that will result.
+ *
+ * We return -1 if no legal actions are available.
+ *
+ * This function is recursive.
+ */
+static double find_action(game *g)
+{
+	ai_search *s = g->search;
+	game sim;
+	player *p;
+	int old_turn;
+	int i, n;
+	unsigned int seed;
+	action legal[MAX_ACTION], best_act;
+	double score, b_s = -1;
+
+	/* Count searched position */
+	s->search_nodes++;
+	s->searched++;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Get current player's turn */
+	old_turn = g->turn;
+
+	/* Check for game over */
+	if (g->game_over)
+	{
+		/* Clear any choice nodes that haven't been examined */
+		s->node_len = s->node_pos;
+
+		/* Use actual result when solving */
+		if (s->solving) return game_result(g, g->sim_turn);
+
+		/* Get end of game score */
+		score = eval_game(g, g->sim_turn);
+
+		/* Remember end of game */
+		add_candidate(g, score);
+
+		/* Return score */
+		return score;
+	}
+
+	/* Check for choice to make */
+	if (s->node_pos < s->node_len)
+	{
+		/* Handle choice node instead of normal */
+		return choose_action(g);
+	}
+
+	/* Check for solving */
+	if (s->solving)
+	{
+		/* Give up when out of budget */
+		if (s->search_nodes > ai_endgame_budget) s->solve_failed = 1;
+
+		/* Unwind quickly once failed */
+		if (s->solve_failed) return 0;
+	}
+
+	/* Check for decision to stop (forced retreat checks are quick) */
+	if (!s->checking_retreat && search_stopped(s))
+	{
+		/* Solver can't finish */
+		if (s->solving) s->solve_failed = 1;
+
+		/* Unwind */
+		return -1;
+	}
+
+	/* Avoid needlees work when checking for forced retreat */
+	if (s->checking_retreat && !s->must_retreat) return 0;
+
+	/* Get legal actions to take */
+	n = legal_act(g, legal);
+
+	/* Check for no legal actions */
+	if (!n) return -1;
+
+	/* Check for only one possible action */
+	if (n == 1)
+	{
+		/* Increase path position for future searching */
+		s->best_path_pos++;
+
+		/* Remember current path */
+		s->cur_path[s->best_path_pos] = legal[0];
+
+		/* Remember random seed before action */
+		seed = g->random_seed;
+
+		/* Keep state before action if random events are sampled */
+		if (ai_chance_samples > 1) simulate_game(&sim, g);
+
+		/* Perform that action */
+		perform_act(g, legal[0]);
+
+		/* Check for random event to sample */
+		if (ai_chance_samples > 1 && !s->checking_retreat &&
+		    !s->sampling && !s->solving && g->random_seed != seed)
+		{
+			/* Average over outcomes */
+			score = chance_score(&sim, legal[0], g);
+		}
+
+		/* Check for solving */
+		else if (s->solving)
+		{
+			/* Search to the end of the game */
+			score = solve_score(g, old_turn);
+		}
+
+		/* Check for turn change */
+		else if (g->turn != old_turn)
+		{
+			/* Are we checking opponent's response */
+			if (s->checking_retreat)
+			{
+				/* Score is unimportant */
+				score = 0.0;
+
+				/* We must not be forced to retreat */
+				s->must_retreat = 0;
+			}
+			else
+			{
+				/* Check for inevitable retreat from opponent */
+				check_retreat(g);
+
+				/* Get score */
+				score = eval_game(g, g->sim_turn);
+
+				/* Clear must retreat flag */
+				s->must_retreat = 0;
+
+				/* Remember end of turn */
+				add_candidate(g, score);
+			}
+		}
+
+		/* Continue searching */
+		else score = find_action(g);
+
+		/* Return to current path position */
+		s->best_path_pos--;
+
+		/* Check for better actions than previously discovered */
+		if (!s->checking_retreat && score >= s->best_path_score)
+		{
+			/* Store action in best path */
+			s->best_path[s->best_path_pos] = legal[0];
+
+			/* Save best score seen */
+			s->best_path_score = score;
+		}
+
+		/* Return score */
+		return score;
+	}
+
+	/* Increase path position for future searching */
+	s->best_path_pos++;
+
+	/* Loop over available actions */
+	for (i = 0; i < n; i++)
+	{
+		/* Remember current path */
+		s->cur_path[s->best_path_pos] = legal[i];
+
+		/* Avoid unnecessary work when checking for forced retreat */
+		if (s->checking_retreat && !s->must_retreat) break;
+
+		/* Copy game */
+		simulate_game(&sim, g);
+
+		/* Remember random seed before action */
+		seed = sim.random_seed;
+
+		/* Perform action */
+		perform_act(&sim, legal[i]);
+
+		/* Check for random event to sample */
+		if (ai_chance_samples > 1 && !s->checking_retreat &&
+		    !s->sampling && !s->solving && sim.random_seed != seed)
+		{
+			/* Average over outcomes */
+			score = chance_score(g, legal[i], &sim);
+		}
+
+		/* Check for solving */
+		else if (s->solving)
+		{
+			/* Search to the end of the game */
+			score = solve_score(&sim, old_turn);
+		}
+
+		/* Check for retreat */
+		else if (legal[i].act == ACT_RETREAT &&
+		         s->node_pos == s->node_len)
+		{
+			/* Are we checking for forced retreat */
+			if (s->checking_retreat)
+			{
+				/* Score is unimportant */
+				score = 0;
+			}
+			else
+			{
+				/* Get score */
+				score = eval_game(&sim, sim.sim_turn);
+
+				/* Remember end of action */
+				add_candidate(&sim, score);
+			}
+		}
+
+		/* Normal action */
+		else
+		{
+			/* Continue searching */
+			score = find_action(&sim);
+		}
+
+		/* Check for better score among actions */
+		if (score >= b_s)
+		{
+			/* Remember best */
+			b_s = score;
+			best_act = legal[i];
+		}
+	}
+
+	/* Return to current path position */
+	s->best_path_pos--;
+
+	/* Check for better actions than previously discovered */
+	if (!s->checking_retreat && b_s >= s->best_path_score)
+	{
+		/* Store action in best path */
+		s->best_path[s->best_path_pos] = best_act;
+
+		/* Save best score seen */
+		s->best_path_score = b_s;
+	}
+
+	/* Return best score */
+	return b_s;
+}
+
+/*
+ * Find the best action path for the player to move in a simulated copy of
+ * the real game (which the search may change).
+ */
+static void search_position(game *sim)
+{
+	ai_search *s = sim->search;
+	int depth;
+
+	/* Try to solve a fully known endgame exactly */
+	if (solve_endgame(sim)) return;
+
+	/* Get turns to look ahead */
+	depth = ai_lookahead[sim->turn];
+
+	/* Limit depth */
+	if (depth > MAX_LOOKAHEAD) depth = MAX_LOOKAHEAD;
+
+	/* Opponent's turns can't be searched without their network */
+	if (!s->nets[!sim->turn]->num_inputs) depth = 0;
+
+	/* Opponent's actual hand is hidden from us */
+	s->look_hidden = !sim->turn;
+
+	/* Find best action path */
+	search_turn(sim, depth);
+}
+
+/*
+ * Hash a simulated copy of the real game, to look for it among pondered
+ * positions.
+ *
+ * Beliefs are left out, since they are not updated in the simulated turn
+ * the position was predicted from, and so is the search the copy belongs
+ * to.
+ */
+static uint64_t ponder_key(game *sim)
+{
+	game key;
+	int i, j;
+
+	/* Copy game */
+	memcpy(&key, sim, sizeof(game));
+
+	/* Loop over players */
+	for (i = 0; i < 2; i++)
+	{
+		/* Loop over cards */
+		for (j = 1; j < DECK_SIZE; j++)
+		{
+			/* Clear belief */
+			key.p[i].deck[j].hand_prob = 0;
+		}
+	}
+
+	/* Clear search */
+	key.search = NULL;
+
+	/* Return hash */
+	return hash_game(&key);
+}
+
+/*
+ * Look for the position to decide from among those pondered, and use its
+ * best path if found.
+ *
+ * Pondered positions are forgotten either way.
+ */
+static int ponder_lookup(game *sim)
+{
+	ai_state *ai = sim->ai;
+	ai_search *s = sim->search;
+	uint64_t hash;
+	int who = sim->turn, i, found = 0;
+
+	/* Check for nothing pondered */
+	if (!ai->num_ponder[who]) return 0;
+
+	/* Count pondered decision */
+	ai->ponder_tries++;
+
+	/* Get hash of position */
+	hash = ponder_key(sim);
+
+	/* Loop over pondered positions */
+	for (i = 0; i < ai->num_ponder[who]; i++)
+	{
+		/* Skip different positions */
+		if (ai->ponder_cache[who][i].hash != hash) continue;
+
+		/* Use pondered path */
+		memcpy(s->best_path, ai->ponder_cache[who][i].path,
+		       sizeof(s->best_path));
+		s->best_path_pos = 0;
+
+		/* Count hit */
+		ai->ponder_hits++;
+
+		/* Found */
+		found = 1;
+		break;
+	}
+
+	/* Forget pondered positions */
+	ai->num_ponder[who] = 0;
+
+	/* Return whether found */
+	return found;
+}
+
+/*
+ * Perform an action in the real game.
+ */
+static void take_act(game *g, action a)
+{
+	/* Check for recording decisions */
+	if (record_journal && !g->simulation)
+	{
+		/* Record action */
+		journal_add(record_journal, JOURNAL_ACT, a.act, a.index, a.arg,
+		            a.target, 0);
+	}
+
+	/* Perform action */
+	perform_act(g, a);
+}
+
+/*
+ * Perform actions that are the only legal one, as long as they need no
+ * choice of cards.
+ *
+ * This is used when a turn resumes after a random event.  The search
+ * that led there looked past the event using faked cards, so none of its
+ * path beyond the event applies to the real outcome, and searching again
+ * for an action that is forced anyway is wasted work.
+ *
+ * Return -1 if the AI's action is over (after a random event, retreat,
+ * turn change or game over), otherwise the number of actions taken.
+ */
+static int take_forced(game *g)
+{
+	ai_search *s = g->search;
+	game sim;
+	action legal[MAX_ACTION];
+	int old_turn, n = 0;
+
+	/* Get current player's turn */
+	old_turn = g->turn;
+
+	/* Loop until a decision is needed */
+	while (1)
+	{
+		/* Simulate game */
+		simulate_game(&sim, g);
+
+		/* Check for more than one legal action */
+		if (legal_act(&sim, legal) != 1) return n;
+
+		/* Try action */
+		perform_act(&sim, legal[0]);
+
+		/* Check for choice to make */
+		if (s->node_len > 0)
+		{
+			/* Discard choice */
+			s->node_len = s->node_pos = 0;
+
+			/* Search is needed */
+			return n;
+		}
+
+		/* Perform action */
+		take_act(g, legal[0]);
+
+		/* Count actions */
+		n++;
+
+		/* Check for another random event */
+		if (g->random_event)
+		{
+			/* Remember to resume again */
+			g->ai->resuming = g->turn == old_turn && !g->game_over;
+			return -1;
+		}
+
+		/* Check for end of AI's action */
+		if (legal[0].act == ACT_RETREAT || g->turn != old_turn ||
+		    g->game_over) return -1;
+	}
+}
+
+/*
+ * Have the AI player take an action.
+ */
+static void ai_take_action(game *g)
+{
+	ai_search *s = g->search;
+	game sim;
+	player *p;
+	action current;
+	int old_turn;
+	unsigned int seed;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Save current turn */
+	old_turn = g->turn;
+
+	/* Clear best path */
+	s->best_path_pos = 0;
+	s->best_path_score = -1;
+
+	/* Check for beginning of turn */
+	if (p->phase == PHASE_START)
+	{
+		/* Train networks with past inputs */
+		perform_training(g, g->turn, NULL);
+		perform_training(g, !g->turn, NULL);
+	}
+
+	/* Clear random event flag */
+	g->random_event = 0;
+
+	/* Check for error in handling choice nodes */
+	if (s->node_len > 0 || s->node_pos > 0)
+	{
+		printf("Choice nodes around\n");
+	}
+
+	/* Check for turn resuming after a random event */
+	if (g->ai->resuming)
+	{
+		/* Clear flag */
+		g->ai->resuming = 0;
+
+		/* Take actions that need no search, unless action is over */
+		if (take_forced(g) < 0) return;
+	}
+
+	/* Simulate game */
+	simulate_game(&sim, g);
+
+	/* Check for time limit */
+	if (s->time_limit > 0)
+	{
+		/* Get current time */
+		gettimeofday(&s->deadline, NULL);
+
+		/* Add time allowed */
+		s->deadline.tv_sec += s->time_limit / 1000;
+		s->deadline.tv_usec += (s->time_limit % 1000) * 1000;
+
+		/* Carry microseconds */
+		if (s->deadline.tv_usec >= 1000000)
+		{
+			s->deadline.tv_sec++;
+			s->deadline.tv_usec -= 1000000;
+		}
+
+		/* Start timing */
+		s->timed = 1;
+		s->out_of_time = 0;
+	}
+
+#ifdef DEBUG
+	printf("START\n");
+#endif
+
+	/* Check for position searched while pondering */
+	if (!ponder_lookup(&sim))
+	{
+		/* Find best action path */
+		search_position(&sim);
+	}
+
+#ifdef DEBUG
+	printf("END\n");
+#endif
+
+	/* Stop timing (later searches are not limited) */
+	s->timed = 0;
+	s->out_of_time = 0;
+
+	/* Check for cancelled decision */
+	if (s->cancelled)
+	{
+		/* Clear partial path and any choices left unexamined */
+		s->best_path_pos = 0;
+		s->node_len = s->node_pos = 0;
+
+		/* Take no action */
+		return;
+	}
+
+	/* Start at beginning of path */
+	s->best_path_pos = 0;
+
+	/* Loop until end */
+	while (1)
+	{
+		/* Get current action */
+		current = s->best_path[s->best_path_pos];
+
+		/* Check for error */
+		if (current.act == ACT_CHOOSE)
+		{
+			printf("Trying to perform choose action!\n");
+			break;
+		}
+
+		/* Advance to next */
+		s->best_path_pos++;
+
+		/* Remember random seed before action */
+		seed = g->random_seed;
+
+		/* Perform current action */
+		take_act(g, current);
+
+		/* Check for random event (or random outcome that was sampled) */
+		if (g->random_event ||
+		    (ai_chance_samples > 1 && g->random_seed != seed))
+		{
+			/* Remember that the rest of the path was thrown away */
+			g->ai->resuming = g->turn == old_turn && !g->game_over;
+			break;
+		}
+
+		/* Check for retreat */
+		if (current.act == ACT_RETREAT) break;
+
+		/* Check for turn change */
+		if (g->turn != old_turn) break;
+
+		/* Check for game over */
+		if (g->game_over) break;
+	}
+}
+
+/*
+ * Get ready to think ahead for the given AI player while the opponent
+ * decides.
+ *
+ * The game and both players' networks are copied, so that pondering
+ * (see ai_ponder) may run on another thread while the real game goes on
+ * and the networks are trained.  Anything pondered before for this player
+ * is forgotten.
+ *
+ * We return the copy of the game, which may be given to ai_ponder and
+ * ai_cancel instead of the real game, or NULL if the game has no AI.
+ */
+game *ai_ponder_prepare(game *g, int who)
+{
+	ai_state *ai = g->ai;
+	int i;
+
+	/* Check for no AI state */
+	if (!ai) return NULL;
+
+	/* Forget positions pondered before */
+	ai->num_ponder[who] = 0;
+
+	/* Loop over players */
+	for (i = 0; i < 2; i++)
+	{
+		/* Destroy any previous copy */
+		if (ai->ponder_net[i].num_inputs)
+		{
+			/* Free network */
+			free_learner(&ai->ponder_net[i]);
+		}
+
+		/* Skip players without a network */
+		if (!ai->learner[i].num_inputs) continue;
+
+		/* Check for weights that are never trained */
+		if (ai->learner[i].borrowed)
+		{
+			/* Share them */
+			borrow_net(&ai->ponder_net[i], &ai->learner[i]);
+		}
+		else
+		{
+			/* Copy weights */
+			copy_net(&ai->ponder_net[i], &ai->learner[i]);
+		}
+	}
+
+	/* Copy game */
+	ai->ponder_game = *g;
+
+	/* Copy belongs to pondering search */
+	ai->ponder_game.search = &ai->ponder;
+
+	/* Remember player pondering */
+	ai->ponder_who = who;
+
+	/* Return copy */
+	return &ai->ponder_game;
+}
+
+/*
+ * Think ahead while the opponent decides, from the position given to
+ * ai_ponder_prepare.
+ *
+ * The opponent's turn is searched from their point of view to predict the
+ * few positions in which it most likely ends.  Each where the AI player
+ * is to move is searched as their own decision would be, and the path
+ * remembered, so that if the real game reaches one of them the AI can act
+ * without searching.  Searching stops after the pondering budget (but
+ * after predicting the opponent's turn), or at once when cancelled.
+ *
+ * Only the copies are used, so this may run on another thread (given the
+ * copy returned by ai_ponder_prepare, the real game isn't read at all).
+ */
+void ai_ponder(game *g)
+{
+	ai_state *ai = g->ai;
+	ai_search *s;
+	game *start, sim, pos;
+	candidate list[LOOK_WIDTH];
+	ponder_entry *e;
+	struct timeval begin, end;
+	int who, i, n, searched;
+
+	/* Check for no AI state */
+	if (!ai) return;
+
+	/* Get pondering search and position */
+	s = &ai->ponder;
+	start = &ai->ponder_game;
+	who = ai->ponder_who;
+
+	/* Check for our turn or game over */
+	if (start->turn == who || start->game_over) return;
+
+	/* Opponent's turn can't be predicted without their network */
+	if (!s->nets[start->turn]->num_inputs) return;
+
+	/* Get start time */
+	gettimeofday(&begin, NULL);
+
+	/* Simulate game from opponent's point of view */
+	simulate_game(&sim, start);
+
+	/* Collect positions where opponent's turn ends */
+	s->cands = list;
+	s->num_cands = 0;
+
+	/* Search opponent's turn */
+	s->best_path_pos = 0;
+	s->best_path_score = -1;
+	find_action(&sim);
+
+	/* Stop collecting */
+	n = s->num_cands;
+	s->cands = NULL;
+	s->num_cands = 0;
+
+	/* Positions searched so far */
+	searched = s->search_nodes;
+
+	/* Sort by score (most likely first) */
+	sort_candidates(list, n);
+
+	/* Loop over predicted positions */
+	for (i = 0; i < n; i++)
+	{
+		/* Stop when out of budget or cancelled */
+		if (searched >= ai_ponder_budget || s->cancelled) break;
+
+		/* Skip positions where we aren't to move */
+		if (list[i].state.game_over || list[i].state.turn != who)
+		{
+			continue;
+		}
+
+		/* Copy position as our decision would */
+		simulate_game(&pos, &list[i].state);
+		pos.sim_turn = who;
+		pos.random_seed = 0;
+		pos.random_event = 0;
+
+		/* Get cache entry */
+		e = &ai->ponder_cache[who][ai->num_ponder[who]];
+
+		/* Remember position */
+		e->hash = ponder_key(&pos);
+
+		/* Count positions as our decision would */
+		s->search_nodes = 0;
+
+		/* Find best action path */
+		s->best_path_pos = 0;
+		s->best_path_score = -1;
+		search_position(&pos);
+
+		/* Count positions searched */
+		searched += s->search_nodes;
+
+		/* Partial paths are not kept */
+		if (s->cancelled) break;
+
+		/* Remember path */
+		memcpy(e->path, s->best_path, sizeof(s->best_path));
+
+		/* Entry is complete */
+		ai->num_ponder[who]++;
+	}
+
+	/* Clear choices left unexamined by a cancelled search */
+	s->node_len = s->node_pos = 0;
+
+	/* Get end time */
+	gettimeofday(&end, NULL);
+
+	/* Add time taken */
+	ai->ponder_time += (end.tv_sec - begin.tv_sec) * 1000.0 +
+	                   (end.tv_usec - begin.tv_usec) / 1000.0;
+}
+
+/*
+ * Ask the search for the game's decisions (or its pondering) to stop
+ * (or allow it to run again).
+ *
+ * A cancelled decision returns without taking the action being decided,
+ * leaving the game as it was after the last action taken.  This may be
+ * called from any thread.
+ */
+void ai_cancel(game *g, int pondering, int cancel)
+{
+	/* Check for no AI state */
+	if (!g->ai) return;
 
-	/* Save current turn */
-	old_turn = g->turn;
+	/* Set flag of search */
+	if (pondering) g->ai->ponder.cancelled = cancel;
+	else g->ai->decide.cancelled = cancel;
+}
 
-	/* Clear best path */
-	best_path_pos = 0;
-	best_path_score = -1;
+/*
+ * Set the milliseconds each later decision of the game's AI may search
+ * (zero for no limit).
+ */
+void ai_set_time_limit(game *g, int time_limit)
+{
+	/* Check for no AI state */
+	if (!g->ai) return;
 
-	/* Check for beginning of turn */
-	if (p->phase == PHASE_START)
-	{
-		/* Train networks with past inputs */
-		perform_training(g, g->turn, NULL);
-		perform_training(g, !g->turn, NULL);
-	}
+	/* Set limit of decisions */
+	g->ai->decide.time_limit = time_limit;
+}
 
-	/* Clear random event flag */
-	g->random_event = 0;
+/*
+ * Get the positions the AI of a game has searched for its decisions and
+ * while pondering, the milliseconds spent pondering, and how many of its
+ * decisions could have been and were pondered.
+ */
+void ai_stats(game *g, long *searched, long *pondered, double *ponder_time,
+              long *tries, long *hits)
+{
+	ai_state *ai = g->ai;
 
-	/* Check for error in handling choice nodes */
-	if (node_len > 0 || node_pos > 0)
+	/* Check for no AI state */
+	if (!ai)
 	{
-		printf("Choice nodes around\n");
+		/* Nothing done */
+		*searched = *pondered = *tries = *hits = 0;
+		*ponder_time = 0.0;
+		return;
 	}
 
-	/* Simulate game */
-	simulate_game(&sim, g);
+	/* Get counts */
+	*searched = ai->decide.searched;
+	*pondered = ai->ponder.searched;
+	*ponder_time = ai->ponder_time;
+	*tries = ai->ponder_tries;
+	*hits = ai->ponder_hits;
+}
 
-#ifdef DEBUG
-	printf("START\n");
-#endif
+/*
+ * Destroy the storage of one search.
+ */
+static void free_search(ai_search *s)
+{
+	/* Free choice nodes and combinations */
+	free(s->nodes);
+	free(s->choose_arena);
 
-	/* Find best action path */
-	find_action(&sim);
+	/* Free solved positions */
+	free(s->solve_table);
+}
 
-#ifdef DEBUG
-	printf("END\n");
-#endif
+/*
+ * Destroy the AI state of a game.
+ *
+ * Nothing may be searching in the game (or pondering for it).
+ */
+void ai_free(game *g)
+{
+	ai_state *ai = g->ai;
+	int i;
 
-	/* Start at beginning of path */
-	best_path_pos = 0;
+	/* Check for no AI state */
+	if (!ai) return;
 
-	/* Loop until end */
-	while (1)
+	/* Loop over players */
+	for (i = 0; i < 2; i++)
 	{
-		/* Get current action */
-		current = best_path[best_path_pos];
-
-		/* Check for error */
-		if (current.act == ACT_CHOOSE)
+		/* Free networks */
+		if (ai->learner[i].num_inputs) free_learner(&ai->learner[i]);
+		if (ai->ponder_net[i].num_inputs)
 		{
-			printf("Trying to perform choose action!\n");
-			break;
+			/* Free copy */
+			free_learner(&ai->ponder_net[i]);
 		}
+	}
 
-		/* Advance to next */
-		best_path_pos++;
-
-		/* Perform current action */
-		perform_act(g, current);
-
-		/* Check for random event */
-		if (g->random_event) break;
-
-		/* Check for retreat */
-		if (current.act == ACT_RETREAT) break;
+	/* Free searches */
+	free_search(&ai->decide);
+	free_search(&ai->ponder);
 
-		/* Check for turn change */
-		if (g->turn != old_turn) break;
+	/* Free state */
+	free(ai);
 
-		/* Check for game over */
-		if (g->game_over) break;
-	}
+	/* Game has no AI state */
+	g->ai = NULL;
+	g->search = NULL;
 }
 
 /*
@@ -1908,13 +3686,15 @@ static void ai_take_action(game *g)
  */
 void ai_assist(game *g, char *buf)
 {
+	ai_search *s = g->search;
 	game sim;
 	action current;
 	char tmp[1024];
+	unsigned int seed;
 
 	/* Clear best path */
-	best_path_pos = 0;
-	best_path_score = -1;
+	s->best_path_pos = 0;
+	s->best_path_score = -1;
 
 	/* Simulate game */
 	simulate_game(&sim, g);
@@ -1923,7 +3703,7 @@ void ai_assist(game *g, char *buf)
 	find_action(&sim);
 
 	/* Check for no legal moves */
-	if (best_path_score == -1)
+	if (s->best_path_score == -1)
 	{
 		/* Add message */
 		strcpy(buf, "No legal moves!\n");
@@ -1937,19 +3717,19 @@ void ai_assist(game *g, char *buf)
 	strcpy(buf, "");
 
 	/* Use buffer for assist messages */
-	assist_str = buf;
+	s->assist_str = buf;
 
 	/* Start at beginning of path */
-	best_path_pos = 0;
+	s->best_path_pos = 0;
 
 	/* Loop until done */
 	while (sim.p[g->turn].phase <= PHASE_ANNOUNCE)
 	{
 		/* Get current action */
-		current = best_path[best_path_pos];
+		current = s->best_path[s->best_path_pos];
 
 		/* Advance position */
-		best_path_pos++;
+		s->best_path_pos++;
 
 		/* Check current action */
 		switch (current.act)
@@ -2059,24 +3839,31 @@ void ai_assist(game *g, char *buf)
 		/* Add message to buffer */
 		strcat(buf, tmp);
 
+		/* Remember random seed before action */
+		seed = sim.random_seed;
+
 		/* Perform action */
 		perform_act(&sim, current);
 
 		/* Check for retreat */
 		if (current.act == ACT_RETREAT) break;
 
+		/* Stop at random outcome that was sampled */
+		if (ai_chance_samples > 1 && sim.random_seed != seed) break;
+
 		/* Check for game over */
 		if (sim.game_over) break;
 	}
 
 	/* Clear assist string */
-	assist_str = NULL;
+	s->assist_str = NULL;
 }
 
 /*
  * Add message to assist string from chooser.
  */
-static void choose_assist(design *chosen[DECK_SIZE], int num_chosen)
+static void choose_assist(ai_search *s, design *chosen[DECK_SIZE],
+                          int num_chosen)
 {
 	char tmp[1024];
 	int i;
@@ -2090,7 +3877,7 @@ static void choose_assist(design *chosen[DECK_SIZE], int num_chosen)
 	else
 	{
 		/* Add message */
-		strcat(assist_str, "Choose none\n");
+		strcat(s->assist_str, "Choose none\n");
 		return;
 	}
 
@@ -2108,18 +3895,9 @@ static void choose_assist(design *chosen[DECK_SIZE], int num_chosen)
 	strcat(tmp, "\n");
 
 	/* Add to string */
-	strcat(assist_str, tmp);
+	strcat(s->assist_str, tmp);
 }
 
-/*
- * Flag to stop searching for legal combinations.
- *
- * Sometimes when checking for opponent forced retreat, we don't care to
- * search for the best combination, just one that works.
- */
-static int stop_choose;
-
-
 /*
  * Card chooser helper function.
  *
@@ -2129,15 +3907,15 @@ static void ai_choose_aux(game *g, int chooser, int who, design **choices,
                           int n, int c, int chosen, int *best, double *b_s,
                           choose_result callback, void *data)
 {
+	ai_search *s = g->search;
 	game sim;
 	design *list[DECK_SIZE];
 	int i, num_chosen = 0;
-	int num_legal;
 	int callback_value;
 	double score;
 
 	/* Check for no need to look further */
-	if (stop_choose) return;
+	if (s->stop_choose) return;
 
 	/* Check for too few choices */
 	if (c > n) return;
@@ -2156,6 +3934,13 @@ static void ai_choose_aux(game *g, int chooser, int who, design **choices,
 			}
 		}
 
+		/* Skip combinations the callback will reject */
+		if (!choice_legal(g, who, list, num_chosen, callback, data))
+		{
+			/* Combination was illegal */
+			return;
+		}
+
 		/* Copy game */
 		simulate_game(&sim, g);
 
@@ -2170,19 +3955,17 @@ static void ai_choose_aux(game *g, int chooser, int who, design **choices,
 		}
 
 		/* Check for ability to stop looking if desired */
-		if (callback_value > 1 && checking_retreat) stop_choose = 1;
+		if (callback_value > 1 && s->checking_retreat)
+		{
+			/* Any working combination will do */
+			s->stop_choose = 1;
+		}
 
 		/* Check for chooser's turn */
 		if (chooser == g->turn)
 		{
-			/* Get number of legal combinations */
-			num_legal = nodes[node_len].num_legal;
-
 			/* Add combination */
-			nodes[node_len].legal[num_legal] = chosen;
-
-			/* One more combination */
-			nodes[node_len].num_legal++;
+			add_legal(s, chosen);
 		}
 		else
 		{
@@ -2206,6 +3989,9 @@ static void ai_choose_aux(game *g, int chooser, int who, design **choices,
 	ai_choose_aux(g, chooser, who, choices, n - 1, c, chosen << 1,
 	              best, b_s, callback, data);
 
+	/* Check for identical next choice that was not taken */
+	if ((s->choose_same & (1 << (n - 1))) && !(chosen & 1)) return;
+
 	/* Try with current card (if more cards can be chosen) */
 	if (c) ai_choose_aux(g, chooser, who, choices, n - 1, c - 1,
 	                     (chosen << 1) + 1, best, b_s, callback, data);
@@ -2218,20 +4004,22 @@ static void ai_choose(game *g, int chooser, int who, design **choices,
                       int num_choices, int min, int max, choose_result callback,
                       void *data, char *prompt)
 {
+	ai_search *s = g->search;
 	double b_s = -2;
 	int best = 0;
 	int c, i;
+	node *n_ptr;
 	design *chosen[DECK_SIZE];
 	int num_chosen = 0;
 
 	/* Check for unsimulated game */
-	if ((!g->simulation && chooser == g->turn) || assist_str)
+	if ((!g->simulation && chooser == g->turn) || s->assist_str)
 	{
 		/* Check current action */
-		if (best_path[best_path_pos].act == ACT_CHOOSE)
+		if (s->best_path[s->best_path_pos].act == ACT_CHOOSE)
 		{
 			/* Get best from stored choice */
-			best = best_path[best_path_pos].chosen;
+			best = s->best_path[s->best_path_pos].chosen;
 
 			/* Loop over chosen cards */
 			for (i = 0; (1 << i) <= best; i++)
@@ -2245,16 +4033,24 @@ static void ai_choose(game *g, int chooser, int who, design **choices,
 			}
 
 			/* Advance to next path position */
-			best_path_pos++;
+			s->best_path_pos++;
+
+			/* Check for recording decisions */
+			if (record_journal && !g->simulation && !s->assist_str)
+			{
+				/* Record choice */
+				journal_add(record_journal, JOURNAL_CHOOSE, 0,
+				            num_choices, NULL, NULL, best);
+			}
 
 			/* Just use previously computed choice */
 			callback(g, who, chosen, num_chosen, data);
 
 			/* Check for assist string */
-			if (assist_str)
+			if (s->assist_str)
 			{
 				/* Add assist message */
-				choose_assist(chosen, num_chosen);
+				choose_assist(s, chosen, num_chosen);
 			}
 
 			/* Done */
@@ -2287,30 +4083,42 @@ static void ai_choose(game *g, int chooser, int who, design **choices,
 	}
 
 	/* Prevent recursive calls to ai_choose() */
-	if (inside_choose) return;
+	if (s->inside_choose) return;
 	
 	/* We are inside choose function */
-	inside_choose = 1;
+	s->inside_choose = 1;
 
 	/* Check for chooser's turn */
 	if (chooser == g->turn)
 	{
+		/* Start new choice node */
+		n_ptr = new_node(s);
+
 		/* Set choice data */
-		nodes[node_len].callback = callback;
-		nodes[node_len].data = data;
-		nodes[node_len].num_legal = 0;
-		nodes[node_len].who = who;
+		n_ptr->callback = callback;
+		n_ptr->data = data;
+		n_ptr->who = who;
 
 		/* Set choices */
 		for (i = 0; i < num_choices; i++)
 		{
 			/* Set choice */
-			nodes[node_len].choices[i] = choices[i];
+			n_ptr->choices[i] = choices[i];
 		}
 	}
 
 	/* Do not stop looking */
-	stop_choose = 0;
+	s->stop_choose = 0;
+
+	/* Clear identical choices */
+	s->choose_same = 0;
+
+	/* Loop over choices */
+	for (i = 0; i + 1 < num_choices; i++)
+	{
+		/* Check for same as next choice */
+		if (choices[i] == choices[i + 1]) s->choose_same |= 1 << i;
+	}
 
 	/* Loop over number of cards allowed */
 	for (c = min; c <= max; c++)
@@ -2324,7 +4132,7 @@ static void ai_choose(game *g, int chooser, int who, design **choices,
 	if (chooser == g->turn)
 	{
 		/* One more choice to make */
-		node_len++;
+		s->node_len++;
 	}
 	else
 	{
@@ -2339,19 +4147,28 @@ static void ai_choose(game *g, int chooser, int who, design **choices,
 			}
 		}
 
+		/* Check for recording decisions */
+		if (record_journal && !g->simulation)
+		{
+			/* Record choice */
+			journal_add(record_journal, JOURNAL_CHOOSE, 0,
+			            num_choices, NULL, NULL, best);
+		}
+
 		/* Go ahead and perform choice */
 		callback(g, who, chosen, num_chosen, data);
 	}
 
 	/* No longer inside choose function */
-	inside_choose = 0;
+	s->inside_choose = 0;
 }
 
 /*
  * Decide whether to call bluff.
  */
-static int ai_call_bluff(game *g)
+static int ai_call_bluff_aux(game *g)
 {
+	ai_search *s = g->search;
 	game sim;
 	player *opp;
 	card *c;
@@ -2382,7 +4199,7 @@ static int ai_call_bluff(game *g)
 	if (bluff > unknown) return 1;
 
 	/* Clear best path */
-	best_path_pos = 0;
+	s->best_path_pos = 0;
 
 	/* Simulate game */
 	simulate_game(&sim, g);
@@ -2450,41 +4267,54 @@ static int ai_call_bluff(game *g)
 }
 
 /*
- * Perform final training and reset neural net.
+ * Decide whether to call bluff, and record the decision.
  */
-static void ai_game_over(game *g, int who)
+static int ai_call_bluff(game *g)
 {
-	double result[2];
+	int call;
 
-	/* Check for win */
-	if (g->p[who].crystals)
-	{
-		/* Compute margin of victory */
-		result[who] = .5 + g->p[who].crystals * 0.1;
+	/* Make decision */
+	call = ai_call_bluff_aux(g);
 
-		/* Check for instant win */
-		if (g->p[who].instant_win) result[who] = 1.0;
-	}
-	else
+	/* Check for recording decisions */
+	if (record_journal && !g->simulation)
 	{
-		/* Compute margin of defeat */
-		result[who] = .5 - g->p[!who].crystals * 0.1;
-
-		/* Check for instant loss */
-		if (g->p[!who].instant_win) result[who] = 0.0;
+		/* Record decision */
+		journal_add(record_journal, JOURNAL_BLUFF, 0, 0, NULL, NULL,
+		            call);
 	}
 
+	/* Return decision */
+	return call;
+}
+
+/*
+ * Perform final training and reset neural net.
+ */
+static void ai_game_over(game *g, int who)
+{
+	double result[2];
+
+	/* Get our result */
+	result[who] = game_result(g, who);
+
 	/* Compute opponent's result */
 	result[!who] = 1.0 - result[who];
 
 	/* Perform final training */
 	perform_training(g, who, result);
 
+	/* Write exported positions with final result */
+	if (export_data) dataset_finish(export_data, who, result[who]);
+
+	/* Frozen networks keep no training state */
+	if (ai_frozen) return;
+
 	/* Clear past input array */
-	clear_store(&learner[who]);
+	clear_store(&g->ai->learner[who]);
 
 	/* One more training iteration done */
-	learner[who].num_training++;
+	g->ai->learner[who].num_training++;
 }
 
 /*
@@ -2492,15 +4322,37 @@ static void ai_game_over(game *g, int who)
  */
 static void ai_shutdown(game *g, int who)
 {
+	net *l = &g->ai->learner[who];
 	char fname[1024];
 
+	/* Frozen networks are never changed */
+	if (ai_frozen) return;
+
+	/* Check for head on shared trunk */
+	if (l->trunk)
+	{
+		/* Create head filename */
+		sprintf(fname, DATADIR "/networks/bluemoon.head.%s.%s",
+		                                     g->p[who].p_ptr->name,
+		                                     g->p[!who].p_ptr->name);
+
+		/* Save head weights */
+		save_net(l, fname);
+
+		/* Save shared trunk */
+		save_net(&trunk, DATADIR "/networks/bluemoon.trunk");
+
+		/* Done */
+		return;
+	}
+
 	/* Create network filename */
 	sprintf(fname, DATADIR "/networks/bluemoon.net.%s.%s",
 	                                     g->p[who].p_ptr->name,
 	                                     g->p[!who].p_ptr->name);
 
 	/* Save network weights to disk */
-	save_net(&learner[who], fname);
+	save_net(l, fname);
 }
 
 /*
@@ -2515,3 +4367,252 @@ interface ai_func =
 	ai_game_over,
 	ai_shutdown,
 };
+
+/*
+ * Journal being replayed.
+ */
+static journal *replay_journal;
+
+/*
+ * Replayed game has gone out of step with its journal.
+ */
+static int replay_failed;
+
+/*
+ * Inside a replayed choice made by the player whose turn it is not.
+ *
+ * This mirrors ai_choose(), which ignores further choices then.
+ */
+static int replay_inside;
+
+/*
+ * Return the next journal entry, if it has the given type.
+ */
+static journal_entry *replay_next(int type)
+{
+	journal *j = replay_journal;
+
+	/* Check for end of journal */
+	if (j->pos >= (int)j->game.num_entries) return NULL;
+
+	/* Check for wrong type */
+	if (j->entry[j->pos].type != type) return NULL;
+
+	/* Return entry */
+	return &j->entry[j->pos];
+}
+
+/*
+ * Nothing to initialize when replaying.
+ */
+static void replay_initialize(game *g, int who)
+{
+}
+
+/*
+ * Perform the next journaled action.
+ */
+static void replay_take_action(game *g)
+{
+	journal_entry *e;
+	action a;
+
+	/* Get next action */
+	e = replay_next(JOURNAL_ACT);
+
+	/* Check for missing action */
+	if (!e)
+	{
+		/* Journal does not match game */
+		replay_failed = 1;
+		return;
+	}
+
+	/* Advance to next entry */
+	replay_journal->pos++;
+
+	/* Rebuild action */
+	a.act = e->act;
+	a.index = e->index;
+	a.arg = journal_design(e->arg);
+	a.target = journal_design(e->target);
+	a.chosen = 0;
+
+	/* Clear random event flag */
+	g->random_event = 0;
+
+	/* Perform action */
+	perform_act(g, a);
+}
+
+/*
+ * Make the next journaled choice.
+ */
+static void replay_choose(game *g, int chooser, int who, design **choices,
+                          int num_choices, int min, int max,
+                          choose_result callback, void *data, char *prompt)
+{
+	journal_entry *e;
+	design *chosen[DECK_SIZE];
+	int num_chosen = 0;
+	int i;
+
+	/* Opponent's choices are ignored inside another one */
+	if (chooser != g->turn && replay_inside) return;
+
+	/* Get next choice */
+	e = replay_next(JOURNAL_CHOOSE);
+
+	/* No choice was made here */
+	if (!e) return;
+
+	/* Check for different choices than when recorded */
+	if (e->index != num_choices)
+	{
+		/* Journal does not match game */
+		replay_failed = 1;
+		return;
+	}
+
+	/* Advance to next entry */
+	replay_journal->pos++;
+
+	/* Loop over choices */
+	for (i = 0; i < num_choices; i++)
+	{
+		/* Add chosen cards to list */
+		if (e->value & (1U << i)) chosen[num_chosen++] = choices[i];
+	}
+
+	/* Check for opponent's choice */
+	if (chooser != g->turn)
+	{
+		/* Ignore nested choices */
+		replay_inside = 1;
+
+		/* Perform choice */
+		callback(g, who, chosen, num_chosen, data);
+
+		/* Done with choice */
+		replay_inside = 0;
+	}
+	else
+	{
+		/* Perform choice */
+		callback(g, who, chosen, num_chosen, data);
+	}
+}
+
+/*
+ * Return the journaled decision about calling a bluff.
+ */
+static int replay_call_bluff(game *g)
+{
+	journal_entry *e;
+
+	/* Get next decision */
+	e = replay_next(JOURNAL_BLUFF);
+
+	/* Check for missing decision */
+	if (!e)
+	{
+		/* Journal does not match game */
+		replay_failed = 1;
+		return 0;
+	}
+
+	/* Advance to next entry */
+	replay_journal->pos++;
+
+	/* Return decision */
+	return e->value;
+}
+
+/*
+ * Nothing to do at the end of a replayed game.
+ */
+static void replay_game_over(game *g, int who)
+{
+}
+
+/*
+ * Nothing to shut down after replaying.
+ */
+static void replay_shutdown(game *g, int who)
+{
+}
+
+/*
+ * Set of functions that replay a journal.
+ */
+interface replay_func =
+{
+	replay_initialize,
+	replay_take_action,
+	replay_choose,
+	replay_call_bluff,
+	replay_game_over,
+	replay_shutdown,
+};
+
+/*
+ * Reconstruct the journal's current game.
+ *
+ * Replaying stops after the action that uses entry "num", or at the end
+ * of the game if "num" is negative.
+ *
+ * Return -1 if the game does not follow the journal.
+ */
+int replay_game(game *g, journal *j, int num)
+{
+	event_log *events = g->events;
+	ai_state *ai = g->ai;
+
+	/* Clear game */
+	memset(g, 0, sizeof(game));
+
+	/* Keep event log and AI state */
+	g->events = events;
+	g->ai = ai;
+	g->search = ai ? &ai->decide : NULL;
+
+	/* Set peoples */
+	g->p[0].p_ptr = &peoples[j->game.people[0]];
+	g->p[1].p_ptr = &peoples[j->game.people[1]];
+
+	/* Set random seed */
+	g->random_seed = j->game.start_seed;
+
+	/* Start game */
+	init_game(g, 1);
+
+	/* Both players follow the journal */
+	g->p[0].control = g->p[1].control = &replay_func;
+
+	/* Start at first entry */
+	replay_journal = j;
+	j->pos = 0;
+
+	/* Clear flags */
+	replay_failed = 0;
+	replay_inside = 0;
+
+	/* Play until game is over */
+	while (!g->game_over)
+	{
+		/* Check for enough entries replayed */
+		if (num >= 0 && j->pos > num) break;
+
+		/* Have current player take next action */
+		g->p[g->turn].control->take_action(g);
+
+		/* Check for failure */
+		if (replay_failed) return -1;
+	}
+
+	/* Check for unused entries at end of game */
+	if (num < 0 && j->pos != (int)j->game.num_entries) return -1;
+
+	/* Success */
+	return 0;
+}
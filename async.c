@@ -0,0 +1,351 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bluemoon.h"
+#include "async.h"
+
+/*
+ * Asynchronous turns.
+ *
+ * A turn is played on a worker thread by calling the control interface of
+ * the player to move until the other player is to move or the game is
+ * over, so that the caller's thread stays free.  The caller can poll for
+ * the turn to finish, wait for it, or be called back when it does, and
+ * can cancel it.  How long each AI decision of the turn may search is
+ * given when it is started.
+ *
+ * Each turn is tracked by a handle owned by the caller.  A handle plays
+ * one turn at a time, and nothing else may use the game while it does,
+ * but games with their own handles may be played at once.  Some AI state
+ * is still shared by the whole process, however: the journal decisions
+ * are recorded to (record_journal), the dataset positions are exported
+ * to (export_data) and the shared trunk trained by every game using it
+ * (ai_shared_trunk).  While any of these is in use, only one game may be
+ * played at a time.
+ *
+ * A handle may instead let a player ponder (think ahead during the other
+ * player's turn).  Pondering uses copies of the game and networks, so the
+ * game may be played on (even with another handle) meanwhile, but the
+ * pondering should be finished or cancelled before the pondering player
+ * decides.
+ */
+
+/*
+ * Stack size of the worker thread (the search recurses with a copy of the
+ * game in every frame, which is too deep for some default thread stacks).
+ */
+#define WORKER_STACK (8 * 1024 * 1024)
+
+/*
+ * Prepare a handle for playing turns.
+ */
+void async_init(async_turn *t)
+{
+	/* Create lock and signal */
+	pthread_mutex_init(&t->mutex, NULL);
+	pthread_cond_init(&t->cond, NULL);
+
+	/* Nothing played yet */
+	t->state = ASYNC_IDLE;
+	t->cancelled = 0;
+}
+
+/*
+ * Destroy a handle, once no turn is being played with it.
+ */
+void async_destroy(async_turn *t)
+{
+	/* Destroy lock and signal */
+	pthread_mutex_destroy(&t->mutex);
+	pthread_cond_destroy(&t->cond);
+}
+
+/*
+ * Play a turn (or ponder) on the worker thread.
+ */
+static void *play_turn(void *arg)
+{
+	async_turn *t = (async_turn *)arg;
+	game *g = t->g;
+	async_done done = t->done;
+	void *data = t->data;
+	int pondering = t->pondering;
+	int who = t->who, result;
+
+	/* Check for pondering */
+	if (pondering)
+	{
+		/* Think ahead from the copy taken when started */
+		ai_ponder(g);
+	}
+
+	/* Loop until other player's turn or game over */
+	while (!pondering && g->turn == who && !g->game_over)
+	{
+		/* Check for cancelled turn */
+		if (t->cancelled) break;
+
+		/* Have player take an action */
+		g->p[who].control->take_action(g);
+
+		/* Count actions */
+		t->actions++;
+	}
+
+	/* Lock state */
+	pthread_mutex_lock(&t->mutex);
+
+	/* Check for cancelled turn */
+	result = t->cancelled ? ASYNC_CANCELLED : ASYNC_DONE;
+
+	/* Set state */
+	t->state = result;
+
+	/* Let later decisions (or pondering) run */
+	t->cancelled = 0;
+	ai_cancel(g, pondering, 0);
+
+	/* Wake any waiting thread */
+	pthread_cond_broadcast(&t->cond);
+
+	/* Unlock state */
+	pthread_mutex_unlock(&t->mutex);
+
+	/* Call completion function */
+	if (done) done(g, result, data);
+
+	/* Done */
+	return NULL;
+}
+
+/*
+ * Start a worker thread playing a turn (or pondering for the given player).
+ */
+static int start_worker(async_turn *t, game *g, int pondering, int who,
+                        int time_limit, async_done done, void *data)
+{
+	pthread_t thread;
+	pthread_attr_t attr;
+	int err;
+
+	/* Lock state */
+	pthread_mutex_lock(&t->mutex);
+
+	/* Check for turn already being played */
+	if (t->state == ASYNC_RUNNING)
+	{
+		/* Unlock state */
+		pthread_mutex_unlock(&t->mutex);
+
+		/* Failure */
+		return -1;
+	}
+
+	/* Check for pondering */
+	if (pondering)
+	{
+		/* Copy position and networks, and ponder with the copy only */
+		g = ai_ponder_prepare(g, who);
+
+		/* Check for nothing to ponder with */
+		if (!g)
+		{
+			/* Unlock state */
+			pthread_mutex_unlock(&t->mutex);
+
+			/* Error */
+			fprintf(stderr, "Game has no AI to ponder\n");
+
+			/* Failure */
+			return -1;
+		}
+	}
+	else
+	{
+		/* Player to move */
+		who = g->turn;
+
+		/* Limit decisions of the turn */
+		ai_set_time_limit(g, time_limit);
+	}
+
+	/* Remember turn to play */
+	t->g = g;
+	t->done = done;
+	t->data = data;
+	t->cancelled = 0;
+	t->pondering = pondering;
+	t->who = who;
+	t->actions = 0;
+
+	/* Set state */
+	t->state = ASYNC_RUNNING;
+
+	/* Create detached worker with a large stack */
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setstacksize(&attr, WORKER_STACK);
+
+	/* Start worker */
+	err = pthread_create(&thread, &attr, play_turn, t);
+
+	/* Done with attributes */
+	pthread_attr_destroy(&attr);
+
+	/* Check for failure */
+	if (err)
+	{
+		/* Error */
+		fprintf(stderr, "Can't start AI thread: %s\n", strerror(err));
+
+		/* Nothing is running */
+		t->state = ASYNC_IDLE;
+	}
+
+	/* Unlock state */
+	pthread_mutex_unlock(&t->mutex);
+
+	/* Return success or failure */
+	return err ? -1 : 0;
+}
+
+/*
+ * Start playing the current player's turn on a worker thread, letting
+ * each AI decision search for at most the given milliseconds (zero for no
+ * limit).
+ *
+ * The given function (if any) is called from the worker thread, with the
+ * game, the result and the given data, once the turn is finished.  It may
+ * start another turn with the same handle.
+ *
+ * We return -1 if a turn is already being played with the handle, the
+ * player to move has no control interface that takes actions, or no
+ * thread could be started.
+ */
+int async_start(async_turn *t, game *g, int time_limit, async_done done,
+                void *data)
+{
+	interface *control = g->p[g->turn].control;
+
+	/* Check for player that can't take actions */
+	if (!control || !control->take_action)
+	{
+		/* Error */
+		fprintf(stderr, "Player to move can't take actions\n");
+
+		/* Failure */
+		return -1;
+	}
+
+	/* Start worker */
+	return start_worker(t, g, 0, 0, time_limit, done, data);
+}
+
+/*
+ * Let the given player ponder on a worker thread from the current position
+ * (see ai_ponder), while the other player's turn is played.
+ *
+ * The position and networks are copied before we return, and only the
+ * copies are used after that, so the game may be played on meanwhile.
+ * The given function (if any) is called as for async_start, with the
+ * copy of the game, once pondering stops.  Cancelling stops pondering
+ * early, keeping only the positions pondered completely.
+ *
+ * We return -1 if the handle is busy, the game has no AI, or no thread
+ * could be started.
+ */
+int async_ponder(async_turn *t, game *g, int who, async_done done,
+                 void *data)
+{
+	/* Start worker */
+	return start_worker(t, g, 1, who, 0, done, data);
+}
+
+/*
+ * Return the state of the last turn started with a handle, without
+ * waiting.
+ */
+int async_poll(async_turn *t)
+{
+	int s;
+
+	/* Get state */
+	pthread_mutex_lock(&t->mutex);
+	s = t->state;
+	pthread_mutex_unlock(&t->mutex);
+
+	/* Return state */
+	return s;
+}
+
+/*
+ * Wait for the turn being played with a handle (if any) to finish, and
+ * return how it finished.
+ *
+ * The completion function may still be running when we return.
+ */
+int async_wait(async_turn *t)
+{
+	int s;
+
+	/* Lock state */
+	pthread_mutex_lock(&t->mutex);
+
+	/* Wait for turn to finish */
+	while (t->state == ASYNC_RUNNING)
+	{
+		/* Wait for signal */
+		pthread_cond_wait(&t->cond, &t->mutex);
+	}
+
+	/* Get state */
+	s = t->state;
+
+	/* Unlock state */
+	pthread_mutex_unlock(&t->mutex);
+
+	/* Return state */
+	return s;
+}
+
+/*
+ * Cancel the turn being played (or pondering) with a handle (if any).
+ *
+ * The AI stops searching as soon as it notices and returns without taking
+ * the action being decided, leaving the game as it was after the last
+ * action taken.  Actions of other players' control interfaces are not
+ * interrupted.
+ */
+void async_cancel(async_turn *t)
+{
+	/* Lock state */
+	pthread_mutex_lock(&t->mutex);
+
+	/* Check for turn being played */
+	if (t->state == ASYNC_RUNNING)
+	{
+		/* Ask AI to stop */
+		t->cancelled = 1;
+		ai_cancel(t->g, t->pondering, 1);
+	}
+
+	/* Unlock state */
+	pthread_mutex_unlock(&t->mutex);
+}
@@ -0,0 +1,87 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* bluemoon.h must be included first */
+
+#include <pthread.h>
+
+/*
+ * States of a turn played asynchronously (see async.c).
+ */
+#define ASYNC_IDLE      0
+#define ASYNC_RUNNING   1
+#define ASYNC_DONE      2
+#define ASYNC_CANCELLED 3
+
+/*
+ * Function called when a turn played asynchronously is finished.
+ */
+typedef void (*async_done)(game *g, int result, void *data);
+
+/*
+ * A turn (or pondering) played on a worker thread.
+ *
+ * Each is owned by the caller, so several games may be played at once,
+ * each with its own (but see async.c for what can't be shared).
+ */
+typedef struct async_turn
+{
+	/* Protects the state */
+	pthread_mutex_t mutex;
+
+	/* Signalled when a turn finishes */
+	pthread_cond_t cond;
+
+	/* State of the last turn started */
+	int state;
+
+	/* Set when the turn being played is cancelled */
+	volatile int cancelled;
+
+	/* Pondering (see async_ponder) instead of playing a turn */
+	int pondering;
+
+	/* Player whose turn is played (or who ponders) */
+	int who;
+
+	/* Actions taken in the turn played */
+	int actions;
+
+	/* Game */
+	game *g;
+
+	/* Function to call when done */
+	async_done done;
+
+	/* Data to pass to function */
+	void *data;
+
+} async_turn;
+
+/* External functions */
+extern void async_init(async_turn *t);
+extern void async_destroy(async_turn *t);
+extern int async_start(async_turn *t, game *g, int time_limit,
+                       async_done done, void *data);
+extern int async_ponder(async_turn *t, game *g, int who, async_done done,
+                        void *data);
+extern int async_poll(async_turn *t);
+extern int async_wait(async_turn *t);
+extern void async_cancel(async_turn *t);
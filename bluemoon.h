@@ -23,6 +23,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <stdint.h>
 #include <time.h>
 #include <sys/types.h>
 #include <ctype.h>
@@ -54,6 +56,16 @@
  */
 #define MAX_PEOPLE      9
 
+/*
+ * Number of inputs to the AI's neural nets.
+ */
+#define NET_INPUT 443
+
+/*
+ * Number of hidden nodes in the AI's neural nets.
+ */
+#define HIDDEN_NODES 50
+
 /*
  * Number of cards in a deck.
  */
@@ -103,6 +115,11 @@
  *  8) Cards which force opponent to discard/disclose their hand.
  */
 
+/*
+ * Number of special power categories (including "none").
+ */
+#define MAX_SPECIAL_CAT 9
+
 /*
  * Category one.
  */
@@ -313,6 +330,37 @@
 #define LOC_INFLUENCE   7
 #define LOC_MAX         8
 
+/*
+ * Game events.
+ */
+#define EV_MOVE           0
+#define EV_BOOST          1
+#define EV_RETRIEVE       2
+#define EV_DRAGON_USING   3
+#define EV_PLAY           4
+#define EV_PLAY_BLUFF     5
+#define EV_REVEAL_BLUFF   6
+#define EV_CALL_BLUFF     7
+#define EV_BLUFF_DRAGON   8
+#define EV_CALLED_DRAGON  9
+#define EV_LOAD           10
+#define EV_LAND           11
+#define EV_USE            12
+#define EV_SATISFY        13
+#define EV_DRAGON_DUE     14
+#define EV_STORMS         15
+#define EV_RETREAT        16
+#define EV_DRAGONS        17
+#define EV_DECLINE        18
+#define EV_ANNOUNCE       19
+#define EV_FLOODS         20
+#define EV_GAME_OVER      21
+
+/*
+ * Number of events kept in a game's event log.
+ */
+#define MAX_EVENT       256
+
 /*
  * Turn phases.
  */
@@ -334,6 +382,13 @@
  */
 struct game;
 
+/*
+ * Compiled special effect handlers.
+ */
+struct design;
+typedef void (*effect_func)(struct game *g, int who, struct design *d_ptr);
+typedef void (*timed_func)(struct game *g, struct design *d_ptr, int time);
+
 /*
  * Information about a card design.
  */
@@ -369,6 +424,22 @@ typedef struct design
 	/* Special text value (usually amount of some sort) */
 	int special_value;
 
+	/* Compiled category 1 effect handler */
+	effect_func effect_1;
+
+	/* Compiled category 4 and 8 effect handlers */
+	timed_func effect_4;
+	timed_func effect_8;
+
+	/* Card types affected by compiled effect */
+	int effect_types;
+
+	/* Fight element needed by compiled effect (-1 for any) */
+	int effect_element;
+
+	/* Special priority 2 interaction (see fix_priority_2) */
+	int effect_rule;
+
 	/* People card belongs to (different from deck they are found in) */
 	int people;
 
@@ -458,6 +529,12 @@ typedef struct card
 	/* Card's effective icons (some or all icons may be ignored) */
 	int icons;
 
+	/* Card's values, icons or flags may differ from their reset state */
+	int modified;
+
+	/* Values counted in owner's power totals */
+	int counted[2];
+
 	/* Card's special power has been used this turn */
 	int used;
 
@@ -467,6 +544,9 @@ typedef struct card
 	/* This card's location is known to both players */
 	int loc_known;
 
+	/* Opponent's belief that card is in hand (if location unknown) */
+	double hand_prob;
+
 	/* This card is in the hand, but face-up */
 	int disclosed;
 
@@ -543,12 +623,18 @@ typedef struct player
 	/* Last card discarded */
 	design *last_discard;
 
+	/* Active cards with each special category (one bit per deck index) */
+	unsigned int active_special[MAX_SPECIAL_CAT];
+
 	/* Player has played needed character */
 	int char_played;
 
 	/* Minimum total power */
 	int min_power;
 
+	/* Total fire and earth values of active combat and support cards */
+	int power[2];
+
 	/* Cards drawn this turn */
 	int cards_drawn;
 
@@ -592,8 +678,61 @@ typedef struct game
 	/* Seed used to start the game */
 	unsigned int start_seed;
 
+	/* Log receiving the game's events (if any) */
+	struct event_log *events;
+
+	/* AI state of the game (if any AI player was initialized) */
+	struct ai_state *ai;
+
+	/* AI search the game belongs to (or decides with) */
+	struct ai_search *search;
+
 } game;
 
+/*
+ * Something that happened in a (non-simulated) game.
+ *
+ * Events are kept in compact form, and only turned into text by
+ * event_message() when someone wants to display them.
+ */
+typedef struct event
+{
+	/* Event type */
+	int type;
+
+	/* Player the event concerns */
+	int who;
+
+	/* That player's people */
+	people *p_ptr;
+
+	/* Cards involved (if any) */
+	design *d_ptr, *other;
+
+	/* Event-specific values */
+	int value[2];
+
+} event;
+
+/*
+ * Recent events from a game.
+ *
+ * The log is a ring buffer, so event number "n" is stored at index
+ * n % MAX_EVENT, and only the last MAX_EVENT events are kept.  Each game
+ * that wants its events kept points to its own log.
+ */
+typedef struct event_log
+{
+	/* Logged events */
+	event entry[MAX_EVENT];
+
+	/* Total number of events logged */
+	unsigned int num_events;
+
+	/* Function called with the game and each new event (if set) */
+	void (*hook)(struct game *g, event *e);
+
+} event_log;
 
 
 /*
@@ -602,6 +741,17 @@ typedef struct game
 extern people peoples[MAX_PEOPLE];
 
 extern interface ai_func;
+extern int ai_hidden;
+extern int ai_hidden2;
+extern int ai_activation;
+extern int ai_shared_trunk;
+extern int ai_frozen;
+extern int ai_chance_samples;
+extern int ai_search_budget;
+extern int ai_endgame_budget;
+extern int ai_lookahead[2];
+extern int ai_ponder_budget;
+extern int ai_time_limit;
 
 
 /*
@@ -610,13 +760,19 @@ extern interface ai_func;
 extern int myrand(unsigned int *seed);
 extern int hand_limit(game *g, int who);
 extern card *find_card(game *g, int who, design *d_ptr);
+extern void update_power(game *g, int who, card *c);
+extern int next_special(player *p, int cat, int i);
 extern void move_card(game *g, int who, design *d_ptr, int to, int faceup);
 extern design *random_card(game *g, int who, int stack);
+extern void update_belief(game *g, int who);
 extern void reset_cards(game *g);
+extern void compile_effects(void);
 extern int retrieve_legal(game *g, card *c);
 extern void retrieve_card(game *g, design *d_ptr);
 extern int card_allowed(game *g, design *d_ptr);
 extern int card_eligible(game *g, design *d_ptr);
+extern unsigned int allowed_cards(game *g, unsigned int mask);
+extern unsigned int eligible_cards(game *g);
 extern int support_allowed(game *g);
 extern int load_allowed(game *g, design *d_ptr);
 extern void play_card(game *g, design *d_ptr, int no_effect, int check);
@@ -628,6 +784,8 @@ extern void land_ship(game *g, design *d_ptr);
 extern int special_possible(game *g, design *d_ptr);
 extern void use_special(game *g, design *d_ptr);
 extern int satisfy_possible(game *g, design *d_ptr);
+extern int choice_legal(game *g, int who, design **list, int num,
+                        choose_result callback, void *data);
 extern void satisfy_discard(game *g, design *d_ptr);
 extern void start_turn(game *g);
 extern void attract_dragon(game *g, int who);
@@ -638,10 +796,20 @@ extern int check_end_support(game *g);
 extern void end_support(game *g);
 extern void announce_power(game *g, int element);
 extern void end_turn(game *g);
+extern void event_message(event *e, char *buf);
 
 extern void read_cards(void);
+extern void parse_cards(void);
+extern int write_card_db(char *fname);
 extern void init_game(game *g, int first);
 
 extern void ai_assist(game *g, char *buf);
+extern game *ai_ponder_prepare(game *g, int who);
+extern void ai_ponder(game *g);
+extern void ai_cancel(game *g, int pondering, int cancel);
+extern void ai_set_time_limit(game *g, int time_limit);
+extern void ai_stats(game *g, long *searched, long *pondered,
+                     double *ponder_time, long *tries, long *hits);
+extern void ai_free(game *g);
 
 extern void message_add(char *msg);
@@ -0,0 +1,622 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bluemoon.h"
+#include "net.h"
+#include "dataset.h"
+
+#include <math.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Network calibration tool.
+ *
+ * Evaluates one or more sets of networks over every position in a
+ * dataset (as written by "learner -d") and reports how well the
+ * predicted win probabilities match the actual game results.
+ *
+ * The dataset is mapped into memory rather than read, so files much
+ * larger than physical memory can be processed.  Positions are split
+ * into batches which are spread over a number of threads.
+ */
+
+/*
+ * Maximum number of network sets to compare.
+ */
+#define MAX_SET 8
+
+/*
+ * Maximum number of evaluation threads.
+ */
+#define MAX_THREAD 64
+
+/*
+ * Number of calibration buckets.
+ */
+#define NUM_BUCKET 10
+
+/*
+ * Statistics for one group of positions.
+ */
+typedef struct stats
+{
+	/* Number of positions */
+	long num;
+
+	/* Sum of squared errors */
+	double brier;
+
+	/* Sum of log losses */
+	double log_loss;
+
+	/* Positions with predictions in each bucket */
+	long bucket_num[NUM_BUCKET];
+
+	/* Sum of predictions in each bucket */
+	double bucket_pred[NUM_BUCKET];
+
+	/* Sum of actual results in each bucket */
+	double bucket_result[NUM_BUCKET];
+
+} stats;
+
+/*
+ * Per-thread work.
+ */
+typedef struct worker
+{
+	/* Thread */
+	pthread_t thread;
+
+	/* Thread index */
+	int index;
+
+	/* Statistics for each set and matchup */
+	stats matchup[MAX_SET][MAX_PEOPLE][MAX_PEOPLE];
+
+	/* Positions skipped for lack of a network */
+	long skipped;
+
+} worker;
+
+/*
+ * Verbosity level.
+ */
+int verbose;
+
+/*
+ * Directories of network sets.
+ */
+static char *set_dir[MAX_SET];
+
+/*
+ * Number of network sets.
+ */
+static int num_set;
+
+/*
+ * Networks of each set for each matchup (NULL if missing).
+ */
+static net *networks[MAX_SET][MAX_PEOPLE][MAX_PEOPLE];
+
+/*
+ * Mapped positions.
+ */
+static position *records;
+
+/*
+ * Number of positions.
+ */
+static long num_records;
+
+/*
+ * Number of network inputs in each position.
+ */
+static int num_inputs;
+
+/*
+ * Number of positions per batch.
+ */
+static long batch_size = 4096;
+
+/*
+ * Number of threads.
+ */
+static int num_thread;
+
+/*
+ * Print a message from the game engine.
+ */
+void message_add(char *msg)
+{
+	/* Print message */
+	printf("%s", msg);
+}
+
+/*
+ * Load the networks of one set.
+ */
+static void load_set(int set)
+{
+	char fname[1024];
+	net *l, *trunk;
+	int i, j;
+
+	/* Create shared trunk */
+	trunk = (net *)malloc(sizeof(net));
+	make_learner(trunk, NET_INPUT, HIDDEN_NODES, 2);
+
+	/* Create trunk filename */
+	sprintf(fname, "%s/bluemoon.trunk", set_dir[set]);
+
+	/* Attempt to load trunk */
+	if (load_net(trunk, fname))
+	{
+		/* No trunk */
+		free_learner(trunk);
+		free(trunk);
+		trunk = NULL;
+	}
+
+	/* Loop over evaluating peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Loop over opposing peoples */
+		for (j = 0; j < MAX_PEOPLE; j++)
+		{
+			/* Skip mirror matches */
+			if (i == j) continue;
+
+			/* Create network */
+			l = (net *)malloc(sizeof(net));
+
+			/* Create network (loading gives it the file's shape) */
+			make_learner(l, NET_INPUT, HIDDEN_NODES, 2);
+
+			/* Check for trunk */
+			if (trunk)
+			{
+				/* Make network a head on the trunk */
+				free_learner(l);
+				make_net(l, NET_INPUT, trunk->num_hidden, 0, 2,
+				         trunk->activation);
+				share_trunk(l, trunk);
+
+				/* Create head filename */
+				sprintf(fname, "%s/bluemoon.head.%s.%s",
+				        set_dir[set], peoples[i].name,
+				        peoples[j].name);
+
+				/* Attempt to load head */
+				if (!load_net(l, fname))
+				{
+					/* Remember network */
+					networks[set][i][j] = l;
+					continue;
+				}
+			}
+
+			/* Create network filename */
+			sprintf(fname, "%s/bluemoon.net.%s.%s", set_dir[set],
+			        peoples[i].name, peoples[j].name);
+
+			/* Attempt to load network */
+			if (load_net(l, fname))
+			{
+				/* Message */
+				printf("Couldn't load %s\n", fname);
+
+				/* Destroy network */
+				free_learner(l);
+				free(l);
+
+				/* Skip this matchup */
+				continue;
+			}
+
+			/* Remember network */
+			networks[set][i][j] = l;
+		}
+	}
+}
+
+/*
+ * Add one prediction to a set of statistics.
+ */
+static void add_stats(stats *s, double pred, double result)
+{
+	double p;
+	int b;
+
+	/* Count position */
+	s->num++;
+
+	/* Add squared error */
+	s->brier += (pred - result) * (pred - result);
+
+	/* Keep prediction away from 0 and 1 */
+	p = pred < 1e-9 ? 1e-9 : (pred > 1 - 1e-9 ? 1 - 1e-9 : pred);
+
+	/* Add log loss (results may fall between 0 and 1) */
+	s->log_loss -= result * log(p) + (1 - result) * log(1 - p);
+
+	/* Find bucket */
+	b = (int)(pred * NUM_BUCKET);
+
+	/* Keep top prediction in last bucket */
+	if (b >= NUM_BUCKET) b = NUM_BUCKET - 1;
+
+	/* Add to bucket */
+	s->bucket_num[b]++;
+	s->bucket_pred[b] += pred;
+	s->bucket_result[b] += result;
+}
+
+/*
+ * Combine two sets of statistics.
+ */
+static void merge_stats(stats *dst, stats *src)
+{
+	int b;
+
+	/* Add totals */
+	dst->num += src->num;
+	dst->brier += src->brier;
+	dst->log_loss += src->log_loss;
+
+	/* Loop over buckets */
+	for (b = 0; b < NUM_BUCKET; b++)
+	{
+		/* Add bucket totals */
+		dst->bucket_num[b] += src->bucket_num[b];
+		dst->bucket_pred[b] += src->bucket_pred[b];
+		dst->bucket_result[b] += src->bucket_result[b];
+	}
+}
+
+/*
+ * Evaluate every batch assigned to one thread.
+ *
+ * Batches are dealt out round-robin by thread index so that the results
+ * do not depend on thread scheduling.
+ */
+static void *evaluate_batches(void *arg)
+{
+	worker *w = (worker *)arg;
+	position *pos;
+	net *l;
+	int input[DATASET_MAX_INPUT];
+	double hidden[2 * NET_MAX_HIDDEN + 2], prob[2];
+	long batch, start, end, i;
+	int set, a, b;
+
+	/* Loop over this thread's batches */
+	for (batch = w->index; batch * batch_size < num_records;
+	     batch += num_thread)
+	{
+		/* Get range of positions */
+		start = batch * batch_size;
+		end = start + batch_size;
+
+		/* Stop at end of dataset */
+		if (end > num_records) end = num_records;
+
+		/* Loop over positions */
+		for (i = start; i < end; i++)
+		{
+			/* Get position */
+			pos = &records[i];
+
+			/* Get evaluating and opposing peoples */
+			a = pos->people[pos->who];
+			b = pos->people[!pos->who];
+
+			/* Check for bad people */
+			if (a >= MAX_PEOPLE || b >= MAX_PEOPLE || a == b)
+			{
+				/* Skip position */
+				w->skipped++;
+				continue;
+			}
+
+			/* Expand inputs */
+			dataset_unpack(pos, input, num_inputs);
+
+			/* Loop over network sets */
+			for (set = 0; set < num_set; set++)
+			{
+				/* Get network */
+				l = networks[set][a][b];
+
+				/* Skip missing networks */
+				if (!l)
+				{
+					/* Count skipped position */
+					w->skipped++;
+					continue;
+				}
+
+				/* Evaluate position */
+				eval_net(l, input, hidden, prob);
+
+				/* Add to statistics */
+				add_stats(&w->matchup[set][a][b],
+				          prob[pos->who], pos->result);
+			}
+		}
+	}
+
+	/* Done */
+	return NULL;
+}
+
+/*
+ * Print one set of statistics.
+ */
+static void print_stats(char *label, stats *s, int buckets)
+{
+	int b;
+
+	/* Skip empty statistics */
+	if (!s->num) return;
+
+	/* Print totals */
+	printf("%-16s %10ld  brier %.5f  log loss %.5f\n", label, s->num,
+	       s->brier / s->num, s->log_loss / s->num);
+
+	/* Check for bucket output */
+	if (!buckets) return;
+
+	/* Loop over buckets */
+	for (b = 0; b < NUM_BUCKET; b++)
+	{
+		/* Skip empty buckets */
+		if (!s->bucket_num[b]) continue;
+
+		/* Print average prediction against average result */
+		printf("  %.1f-%.1f %10ld  predicted %.4f  actual %.4f\n",
+		       (double)b / NUM_BUCKET, (double)(b + 1) / NUM_BUCKET,
+		       s->bucket_num[b],
+		       s->bucket_pred[b] / s->bucket_num[b],
+		       s->bucket_result[b] / s->bucket_num[b]);
+	}
+}
+
+/*
+ * Print usage information.
+ */
+static void usage(char *name)
+{
+	printf("Usage: %s [-v] [-t threads] [-b batch] [-n dir]... "
+	       "dataset\n", name);
+	printf("  -v            print calibration buckets per matchup\n");
+	printf("  -t threads    number of threads (default: all cores)\n");
+	printf("  -b batch      positions per batch (default 4096)\n");
+	printf("  -n dir        directory of networks to evaluate "
+	       "(default " DATADIR "/networks)\n");
+	exit(1);
+}
+
+/*
+ * Evaluate networks over a dataset.
+ */
+int main(int argc, char *argv[])
+{
+	dataset_header *header;
+	worker *workers;
+	stats total, *s;
+	struct stat st;
+	char *fname = NULL, label[80];
+	void *map;
+	long skipped = 0;
+	int fd, i, j, t, set;
+
+	/* Default to one thread per core */
+	num_thread = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* Parse arguments */
+	for (i = 1; i < argc; i++)
+	{
+		/* Check for verbosity */
+		if (!strcmp(argv[i], "-v"))
+		{
+			/* Increase verbosity */
+			verbose++;
+		}
+
+		/* Check for number of threads */
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+		{
+			/* Set number of threads */
+			num_thread = atoi(argv[++i]);
+		}
+
+		/* Check for batch size */
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+		{
+			/* Set batch size */
+			batch_size = atol(argv[++i]);
+		}
+
+		/* Check for network set */
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc &&
+		         num_set < MAX_SET)
+		{
+			/* Add network set */
+			set_dir[num_set++] = argv[++i];
+		}
+
+		/* Check for dataset name */
+		else if (argv[i][0] != '-' && !fname)
+		{
+			/* Remember dataset name */
+			fname = argv[i];
+		}
+
+		/* Unknown argument */
+		else
+		{
+			/* Print usage and exit */
+			usage(argv[0]);
+		}
+	}
+
+	/* Check for missing dataset */
+	if (!fname) usage(argv[0]);
+
+	/* Keep thread count and batch size sane */
+	if (num_thread < 1) num_thread = 1;
+	if (num_thread > MAX_THREAD) num_thread = MAX_THREAD;
+	if (batch_size < 1) batch_size = 1;
+
+	/* Default to installed networks */
+	if (!num_set) set_dir[num_set++] = DATADIR "/networks";
+
+	/* Open dataset */
+	fd = open(fname, O_RDONLY);
+
+	/* Check for failure */
+	if (fd < 0 || fstat(fd, &st) < 0 ||
+	    st.st_size < (off_t)sizeof(dataset_header))
+	{
+		/* Error */
+		fprintf(stderr, "Couldn't open dataset %s\n", fname);
+		exit(1);
+	}
+
+	/* Map dataset */
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	/* Check for failure */
+	if (map == MAP_FAILED)
+	{
+		/* Error */
+		perror("mmap");
+		exit(1);
+	}
+
+	/* We will read the positions in order */
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	/* Get header */
+	header = (dataset_header *)map;
+
+	/* Check header */
+	if (header->magic != DATASET_MAGIC ||
+	    header->version != DATASET_VERSION ||
+	    header->num_inputs != NET_INPUT ||
+	    header->record_size != sizeof(position))
+	{
+		/* Error */
+		fprintf(stderr, "Bad dataset header in %s\n", fname);
+		exit(1);
+	}
+
+	/* Get positions */
+	records = (position *)(header + 1);
+	num_inputs = header->num_inputs;
+
+	/* Count complete positions */
+	num_records = (st.st_size - sizeof(dataset_header)) /
+	              sizeof(position);
+
+	/* Read card database (for people names) */
+	read_cards();
+
+	/* Load network sets */
+	for (set = 0; set < num_set; set++) load_set(set);
+
+	/* Create workers */
+	workers = (worker *)calloc(num_thread, sizeof(worker));
+
+	/* Loop over threads */
+	for (t = 0; t < num_thread; t++)
+	{
+		/* Set thread index */
+		workers[t].index = t;
+
+		/* Start thread */
+		pthread_create(&workers[t].thread, NULL, evaluate_batches,
+		               &workers[t]);
+	}
+
+	/* Loop over threads */
+	for (t = 0; t < num_thread; t++)
+	{
+		/* Wait for thread */
+		pthread_join(workers[t].thread, NULL);
+
+		/* Count skipped positions */
+		skipped += workers[t].skipped;
+	}
+
+	/* Message */
+	printf("%ld positions, %d threads\n", num_records, num_thread);
+
+	/* Check for skipped positions */
+	if (skipped) printf("%ld evaluations skipped\n", skipped);
+
+	/* Loop over network sets */
+	for (set = 0; set < num_set; set++)
+	{
+		/* Print set name */
+		printf("\n%s:\n", set_dir[set]);
+
+		/* Clear set total */
+		memset(&total, 0, sizeof(stats));
+
+		/* Loop over matchups */
+		for (i = 0; i < MAX_PEOPLE; i++)
+		{
+			for (j = 0; j < MAX_PEOPLE; j++)
+			{
+				/* Merge threads in order into first worker */
+				s = &workers[0].matchup[set][i][j];
+
+				/* Loop over remaining threads */
+				for (t = 1; t < num_thread; t++)
+				{
+					/* Merge statistics */
+					merge_stats(s,
+					        &workers[t].matchup[set][i][j]);
+				}
+
+				/* Create matchup label */
+				sprintf(label, "%s vs %s", peoples[i].name,
+				        peoples[j].name);
+
+				/* Print matchup */
+				print_stats(label, s, verbose);
+
+				/* Add to total */
+				merge_stats(&total, s);
+			}
+		}
+
+		/* Print set totals with calibration buckets */
+		print_stats("Total", &total, 1);
+	}
+
+	/* Done */
+	return 0;
+}
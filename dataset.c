@@ -0,0 +1,270 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "dataset.h"
+
+/*
+ * Dataset that training positions are exported to (if any).
+ */
+dataset *export_data;
+
+/*
+ * Open a dataset file for appending.
+ *
+ * A header is written if the file is new, otherwise the existing header
+ * is checked against the given number of inputs.
+ *
+ * Return -1 on error.
+ */
+int dataset_create(dataset *ds, char *fname, int num_inputs)
+{
+	dataset_header header;
+
+	/* Check for too many inputs */
+	if (num_inputs > DATASET_MAX_INPUT) return -1;
+
+	/* Clear dataset */
+	memset(ds, 0, sizeof(dataset));
+
+	/* Open file for reading and appending */
+	ds->fp = fopen(fname, "a+b");
+
+	/* Check for failure */
+	if (!ds->fp) return -1;
+
+	/* Remember number of inputs */
+	ds->num_inputs = num_inputs;
+
+	/* Go to beginning of file */
+	fseek(ds->fp, 0, SEEK_SET);
+
+	/* Attempt to read existing header */
+	if (fread(&header, sizeof(dataset_header), 1, ds->fp) == 1)
+	{
+		/* Check for mismatched header */
+		if (header.magic != DATASET_MAGIC ||
+		    header.version != DATASET_VERSION ||
+		    header.num_inputs != num_inputs ||
+		    header.record_size != sizeof(position))
+		{
+			/* Close file */
+			fclose(ds->fp);
+			ds->fp = NULL;
+
+			/* Error */
+			return -1;
+		}
+
+		/* Done */
+		return 0;
+	}
+
+	/* Create new header */
+	header.magic = DATASET_MAGIC;
+	header.version = DATASET_VERSION;
+	header.num_inputs = num_inputs;
+	header.record_size = sizeof(position);
+
+	/* Write header */
+	fwrite(&header, sizeof(dataset_header), 1, ds->fp);
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Add a position to the dataset.
+ *
+ * The position is held until the game result for the evaluating player
+ * is known.
+ */
+void dataset_add(dataset *ds, int who, int turn, int people_0, int people_1,
+                 unsigned int game_id, int *input)
+{
+	position *pos;
+	int i;
+
+	/* Check for full pending array */
+	if (ds->num_pending[who] == ds->max_pending[who])
+	{
+		/* Grow array */
+		ds->max_pending[who] = ds->max_pending[who] * 2 + 32;
+
+		/* Reallocate array */
+		ds->pending[who] = (position *)realloc(ds->pending[who],
+		                       sizeof(position) * ds->max_pending[who]);
+	}
+
+	/* Get next position */
+	pos = &ds->pending[who][ds->num_pending[who]];
+
+	/* Clear position */
+	memset(pos, 0, sizeof(position));
+
+	/* Loop over inputs */
+	for (i = 0; i < ds->num_inputs; i++)
+	{
+		/* Set bit for active inputs */
+		if (input[i]) pos->input[i / 8] |= 1 << (i % 8);
+	}
+
+	/* Store position information */
+	pos->who = who;
+	pos->turn = turn;
+	pos->people[0] = people_0;
+	pos->people[1] = people_1;
+	pos->game_id = game_id;
+	pos->turn_id = ds->num_pending[who];
+
+	/* One more position pending */
+	ds->num_pending[who]++;
+}
+
+/*
+ * Write out a player's pending positions with the given final result.
+ */
+void dataset_finish(dataset *ds, int who, double result)
+{
+	int i;
+
+	/* Loop over pending positions */
+	for (i = 0; i < ds->num_pending[who]; i++)
+	{
+		/* Set result */
+		ds->pending[who][i].result = result;
+	}
+
+	/* Write positions */
+	fwrite(ds->pending[who], sizeof(position), ds->num_pending[who],
+	       ds->fp);
+
+	/* Count records */
+	ds->num_records += ds->num_pending[who];
+
+	/* Clear pending positions */
+	ds->num_pending[who] = 0;
+}
+
+/*
+ * Write a complete position (with result) to the dataset.
+ */
+void dataset_write(dataset *ds, position *pos)
+{
+	/* Write position */
+	fwrite(pos, sizeof(position), 1, ds->fp);
+
+	/* Count records */
+	ds->num_records++;
+}
+
+/*
+ * Open a dataset file for reading.
+ *
+ * Return -1 on error.
+ */
+int dataset_open(dataset *ds, char *fname)
+{
+	dataset_header header;
+
+	/* Clear dataset */
+	memset(ds, 0, sizeof(dataset));
+
+	/* Open file */
+	ds->fp = fopen(fname, "rb");
+
+	/* Check for failure */
+	if (!ds->fp) return -1;
+
+	/* Read header */
+	if (fread(&header, sizeof(dataset_header), 1, ds->fp) != 1 ||
+	    header.magic != DATASET_MAGIC ||
+	    header.version != DATASET_VERSION ||
+	    header.num_inputs > DATASET_MAX_INPUT ||
+	    header.record_size != sizeof(position))
+	{
+		/* Close file */
+		fclose(ds->fp);
+		ds->fp = NULL;
+
+		/* Error */
+		return -1;
+	}
+
+	/* Remember number of inputs */
+	ds->num_inputs = header.num_inputs;
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Read the next position from a dataset.
+ *
+ * Return 0 at the end of the file.
+ */
+int dataset_read(dataset *ds, position *pos)
+{
+	/* Read record */
+	if (fread(pos, sizeof(position), 1, ds->fp) != 1) return 0;
+
+	/* Count records */
+	ds->num_records++;
+
+	/* Success */
+	return 1;
+}
+
+/*
+ * Expand a position's input bits into an array of network inputs.
+ */
+void dataset_unpack(position *pos, int *input, int num_inputs)
+{
+	int i;
+
+	/* Loop over inputs */
+	for (i = 0; i < num_inputs; i++)
+	{
+		/* Extract bit */
+		input[i] = (pos->input[i / 8] >> (i % 8)) & 1;
+	}
+}
+
+/*
+ * Close a dataset.
+ *
+ * Positions still waiting for a result are discarded.
+ */
+void dataset_close(dataset *ds)
+{
+	int i;
+
+	/* Close file */
+	if (ds->fp) fclose(ds->fp);
+
+	/* Loop over players */
+	for (i = 0; i < 2; i++)
+	{
+		/* Free pending positions */
+		free(ds->pending[i]);
+	}
+
+	/* Clear dataset */
+	memset(ds, 0, sizeof(dataset));
+}
@@ -0,0 +1,141 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * Position datasets.
+ *
+ * A dataset file is a small header followed by fixed-size position
+ * records, one per network evaluation that was used for training.  Files
+ * are only ever appended to, so several runs may be collected into one
+ * file as long as they agree on the number of network inputs.
+ *
+ * All values are stored in host byte order.
+ */
+
+/*
+ * Magic number at the start of every dataset file ("BMDS").
+ */
+#define DATASET_MAGIC 0x53444d42
+
+/*
+ * Current dataset format version.
+ */
+#define DATASET_VERSION 1
+
+/*
+ * Largest number of network inputs a record can hold.
+ */
+#define DATASET_MAX_INPUT 448
+
+/*
+ * Dataset file header.
+ */
+typedef struct dataset_header
+{
+	/* Magic number */
+	uint32_t magic;
+
+	/* Format version */
+	uint32_t version;
+
+	/* Number of network inputs in each record */
+	uint32_t num_inputs;
+
+	/* Size of each record in bytes */
+	uint32_t record_size;
+
+} dataset_header;
+
+/*
+ * One recorded position.
+ */
+typedef struct position
+{
+	/* Network inputs, one bit each */
+	uint8_t input[DATASET_MAX_INPUT / 8];
+
+	/* Player whose network evaluated the position */
+	uint8_t who;
+
+	/* Player whose turn it was */
+	uint8_t turn;
+
+	/* People of each player (index into peoples[]) */
+	uint8_t people[2];
+
+	/* Final result of the game for the evaluating player */
+	float result;
+
+	/* Game identifier (starting random seed) */
+	uint32_t game_id;
+
+	/* Index of position among those the player evaluated in the game */
+	uint32_t turn_id;
+
+} position;
+
+/*
+ * An open dataset file.
+ */
+typedef struct dataset
+{
+	/* File pointer */
+	FILE *fp;
+
+	/* Number of network inputs per record */
+	int num_inputs;
+
+	/* Positions waiting for each player's game result */
+	position *pending[2];
+
+	/* Number of pending positions */
+	int num_pending[2];
+
+	/* Size of pending position arrays */
+	int max_pending[2];
+
+	/* Number of records written or read */
+	long num_records;
+
+} dataset;
+
+/* External variables */
+extern dataset *export_data;
+
+/* External functions */
+extern int dataset_create(dataset *ds, char *fname, int num_inputs);
+extern void dataset_add(dataset *ds, int who, int turn, int people_0,
+                        int people_1, unsigned int game_id, int *input);
+extern void dataset_finish(dataset *ds, int who, double result);
+extern void dataset_write(dataset *ds, position *pos);
+extern int dataset_open(dataset *ds, char *fname);
+extern int dataset_read(dataset *ds, position *pos);
+extern void dataset_unpack(position *pos, int *input, int num_inputs);
+extern void dataset_close(dataset *ds);
+
+#endif
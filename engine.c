@@ -20,8 +20,10 @@
 
 #include "bluemoon.h"
 
-/* Forward declaration */
+/* Forward declarations */
 static void notice_effect_1(game *g);
+static void compile_effect_4(design *d_ptr);
+static void compile_effect_8(design *d_ptr);
 
 /*
  * Return a random number using the given argument as a seed.
@@ -34,6 +36,38 @@ int myrand(unsigned int *seed)
 	return ((unsigned)(*seed/65536) % 32768);
 }
 
+/*
+ * Record an event in the game's log, unless the game is a simulation or
+ * has no log.
+ */
+static void add_event(game *g, int type, int who, design *d_ptr,
+                      design *other, int value_0, int value_1)
+{
+	event_log *log = g->events;
+	event *e;
+
+	/* Simulated games have no events */
+	if (g->simulation) return;
+
+	/* Check for no log */
+	if (!log) return;
+
+	/* Get next log entry */
+	e = &log->entry[log->num_events++ % MAX_EVENT];
+
+	/* Store event */
+	e->type = type;
+	e->who = who;
+	e->p_ptr = g->p[who].p_ptr;
+	e->d_ptr = d_ptr;
+	e->other = other;
+	e->value[0] = value_0;
+	e->value[1] = value_1;
+
+	/* Tell front end */
+	if (log->hook) log->hook(g, e);
+}
+
 /*
  * Return a player's hand limit.
  *
@@ -49,21 +83,12 @@ int hand_limit(game *g, int who)
 	/* Get opponent pointer */
 	p = &g->p[!who];
 
-	/* Loop over cards */
-	for (i = 1; i < DECK_SIZE; i++)
+	/* Loop over active category 3 cards */
+	for (i = next_special(p, 3, 0); i; i = next_special(p, 3, i))
 	{
 		/* Get card pointer */
 		c = &p->deck[i];
 
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Skip cards with text ignored */
-		if (c->text_ignored) continue;
-
-		/* Skip cards without category 3 effects */
-		if (c->d_ptr->special_cat != 3) continue;
-
 		/* Check for "you may not take" */
 		if (c->d_ptr->special_effect == (S3_YOU_MAY_NOT | S3_TAKE))
 		{
@@ -89,6 +114,17 @@ card *find_card(game *g, int who, design *d_ptr)
 	card *c;
 	int i;
 
+	/* Check for design from player's own people */
+	if (p->p_ptr && d_ptr >= p->p_ptr->deck &&
+	    d_ptr < p->p_ptr->deck + DECK_SIZE)
+	{
+		/* Card at the same index normally has the design */
+		c = &p->deck[d_ptr - p->p_ptr->deck];
+
+		/* Check design */
+		if (c->d_ptr == d_ptr) return c;
+	}
+
 	/* Loop over player's cards */
 	for (i = 0; i < DECK_SIZE; i++)
 	{
@@ -104,15 +140,108 @@ card *find_card(game *g, int who, design *d_ptr)
 }
 
 /*
- * Deactivate a card.
+ * Return the deck index of the next active card after index "i" with a
+ * special power of the given category and text that is not ignored.
+ *
+ * Return 0 if there are no more such cards.
+ */
+int next_special(player *p, int cat, int i)
+{
+	unsigned int mask;
+
+	/* Get active cards after the given index */
+	mask = p->active_special[cat] & ~((2U << i) - 1);
+
+	/* Loop over remaining cards */
+	while (mask)
+	{
+		/* Get lowest index */
+		i = ffs(mask) - 1;
+
+		/* Check for text not ignored */
+		if (!p->deck[i].text_ignored) return i;
+
+		/* Remove card from mask */
+		mask &= mask - 1;
+	}
+
+	/* No more cards */
+	return 0;
+}
+
+/*
+ * Bring a player's power totals up to date with one of their cards.
+ *
+ * This must be called whenever a card's location, active flag, values or
+ * value ignored flag may have changed.
+ */
+void update_power(game *g, int who, card *c)
+{
+	player *p;
+	int value[2] = { 0, 0 };
+
+	/* Get player pointer */
+	p = &g->p[who];
+
+	/* Check for active combat or support card with values */
+	if ((c->where == LOC_COMBAT || c->where == LOC_SUPPORT) &&
+	    c->active && !c->value_ignored)
+	{
+		/* Card counts towards power */
+		value[0] = c->value[0];
+		value[1] = c->value[1];
+	}
+
+	/* Adjust totals by change in card's values */
+	p->power[0] += value[0] - c->counted[0];
+	p->power[1] += value[1] - c->counted[1];
+
+	/* Remember values counted */
+	c->counted[0] = value[0];
+	c->counted[1] = value[1];
+}
+
+/*
+ * Activate a player's card.
+ */
+static void activate_card(game *g, int who, card *c)
+{
+	player *p;
+
+	/* Get player pointer */
+	p = &g->p[who];
+
+	/* Set active card */
+	c->active = 1;
+
+	/* Add to active cards of its special category */
+	p->active_special[c->d_ptr->special_cat] |= 1U << (c - p->deck);
+
+	/* Count card's power */
+	update_power(g, who, c);
+}
+
+/*
+ * Deactivate a player's card.
  *
  * Clear several flags.
  */
-void deactivate_card(card *c)
+void deactivate_card(game *g, int who, card *c)
 {
+	player *p;
+
+	/* Get player pointer */
+	p = &g->p[who];
+
 	/* Clear active card */
 	c->active = 0;
 
+	/* Remove from active cards of its special category */
+	p->active_special[c->d_ptr->special_cat] &= ~(1U << (c - p->deck));
+
+	/* Card no longer counts towards power */
+	update_power(g, who, c);
+
 	/* Not played recently */
 	c->recent = 0;
 
@@ -202,15 +331,219 @@ static void remove_fake(game *g, int who)
 	}
 }
 
+/*
+ * Opponent's beliefs about a player's hidden cards.
+ *
+ * Each card's "hand_prob" is the chance, as far as the opponent can tell,
+ * that the card is in its owner's hand.  Cards with known locations have
+ * a chance of one or zero.  The others are updated as unseen cards enter
+ * or leave the hand, assuming each time that any of the unknown cards
+ * that could have moved was equally likely to.
+ *
+ * Simulations keep the beliefs of the position they started from, which
+ * saves work during searches.
+ */
+
+/*
+ * An unknown card has entered a player's hand (usually drawn).
+ */
+static void belief_draw(game *g, int who)
+{
+	player *p;
+	card *c;
+	double sum = 0;
+	int i;
+
+	/* Beliefs are only tracked in real games */
+	if (g->simulation) return;
+
+	/* Get player pointer */
+	p = &g->p[who];
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Sum chances of unknown cards being outside hand */
+		if (!c->loc_known) sum += 1 - c->hand_prob;
+	}
+
+	/* Check for no card that could have been drawn */
+	if (sum <= 0) return;
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Skip known cards */
+		if (c->loc_known) continue;
+
+		/* Add chance of this card being the one drawn */
+		c->hand_prob += (1 - c->hand_prob) / sum;
+	}
+}
+
+/*
+ * An unknown card has left a player's hand face-down.
+ */
+static void belief_leave(game *g, int who)
+{
+	player *p;
+	card *c;
+	double sum = 0;
+	int i;
+
+	/* Beliefs are only tracked in real games */
+	if (g->simulation) return;
+
+	/* Get player pointer */
+	p = &g->p[who];
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Sum chances of unknown cards being in hand */
+		if (!c->loc_known) sum += c->hand_prob;
+	}
+
+	/* Check for no card that could have left */
+	if (sum <= 0) return;
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Skip known cards */
+		if (c->loc_known) continue;
+
+		/* Remove chance of this card being the one that left */
+		c->hand_prob -= c->hand_prob / sum;
+	}
+}
+
+/*
+ * Bring a player's card beliefs in line with what the opponent knows.
+ *
+ * Known cards get a chance of one or zero, and the chances of the unknown
+ * cards are scaled to add up to the number of unknown cards in hand.
+ */
+void update_belief(game *g, int who)
+{
+	player *p;
+	card *c;
+	double sum, scale;
+	int i, k, num = 0, hidden, full;
+
+	/* Beliefs are only tracked in real games */
+	if (g->simulation) return;
+
+	/* Get player pointer */
+	p = &g->p[who];
+
+	/* Start with all cards in hand */
+	hidden = p->stack[LOC_HAND];
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Count unknown cards */
+		if (!c->loc_known)
+		{
+			/* Count card */
+			num++;
+
+			/* Next card */
+			continue;
+		}
+
+		/* Set chance from known location */
+		c->hand_prob = (c->where == LOC_HAND);
+
+		/* Known cards in hand are not hidden */
+		if (c->where == LOC_HAND) hidden--;
+	}
+
+	/* Check for no unknown cards */
+	if (!num) return;
+
+	/* Try a few times (scaling may push chances past one) */
+	for (k = 0; k < 3; k++)
+	{
+		/* Clear sums */
+		sum = 0;
+		full = 0;
+
+		/* Loop over cards */
+		for (i = 1; i < DECK_SIZE; i++)
+		{
+			/* Get card pointer */
+			c = &p->deck[i];
+
+			/* Skip known cards */
+			if (c->loc_known) continue;
+
+			/* Count cards surely in hand */
+			if (c->hand_prob >= 1) full++;
+
+			/* Sum other chances */
+			else sum += c->hand_prob;
+		}
+
+		/* Check for chances already adding up */
+		if (sum + full > hidden - 0.0001 &&
+		    sum + full < hidden + 0.0001) break;
+
+		/* Loop over cards */
+		for (i = 1; i < DECK_SIZE; i++)
+		{
+			/* Get card pointer */
+			c = &p->deck[i];
+
+			/* Skip known cards */
+			if (c->loc_known) continue;
+
+			/* Check for nothing to scale or too many sure cards */
+			if (sum <= 0 || full > hidden)
+			{
+				/* Spread hidden cards evenly */
+				c->hand_prob = (double)hidden / num;
+			}
+
+			/* Scale cards not surely in hand */
+			else if (c->hand_prob < 1)
+			{
+				/* Scale chance */
+				scale = (hidden - full) / sum;
+				c->hand_prob *= scale;
+			}
+
+			/* Keep chance in range */
+			if (c->hand_prob > 1) c->hand_prob = 1;
+			if (c->hand_prob < 0) c->hand_prob = 0;
+		}
+	}
+}
+
 /*
  * Move a given card to a new pile.
  */
 void move_card(game *g, int who, design *d_ptr, int to, int faceup)
 {
-	char msg[1024];
 	player *p;
 	card *c;
-	int i;
+	int i, from, hidden;
 
 	/* Get player pointer */
 	p = &g->p[who];
@@ -218,6 +551,12 @@ void move_card(game *g, int who, design *d_ptr, int to, int faceup)
 	/* Find card */
 	c = find_card(g, who, d_ptr);
 
+	/* Remember source pile */
+	from = c->where;
+
+	/* Check for opponent not seeing which card moves */
+	hidden = !faceup && !c->loc_known;
+
 	/* Reduce from stack by one */
 	p->stack[c->where]--;
 
@@ -227,8 +566,22 @@ void move_card(game *g, int who, design *d_ptr, int to, int faceup)
 	/* Increase destination stack by one */
 	p->stack[to]++;
 
+	/* Check for unseen card entering hand */
+	if (hidden && from != LOC_HAND && to == LOC_HAND)
+	{
+		/* Update beliefs */
+		belief_draw(g, who);
+	}
+
+	/* Check for unseen card leaving hand */
+	if (hidden && from == LOC_HAND && to != LOC_HAND)
+	{
+		/* Update beliefs */
+		belief_leave(g, who);
+	}
+
 	/* Moving cards always deactivates them */
-	deactivate_card(c);
+	deactivate_card(g, who, c);
 
 	/* Moved cards lose disclosed flag */
 	c->disclosed = 0;
@@ -246,66 +599,8 @@ void move_card(game *g, int who, design *d_ptr, int to, int faceup)
 	/* Track last card moved to discard pile */
 	if (to == LOC_DISCARD) p->last_discard = d_ptr;
 
-	/* Message */
-	if (!g->simulation && faceup)
-	{
-		/* Switch on destination */
-		switch (to)
-		{
-			/* Hand */
-			case LOC_HAND:
-
-				/* Format message */
-				sprintf(msg, _("%s takes %s into hand.\n"),
-				        _(p->p_ptr->name), _(d_ptr->name));
-				break;
-
-			/* Draw pile */
-			case LOC_DRAW:
-
-				/* Format message */
-				sprintf(msg, _("Moving %s to draw pile.\n"),
-				        _(d_ptr->name));
-				break;
-
-			/* Combat area */
-			case LOC_COMBAT:
-
-				/* Format message */
-				sprintf(msg, _("Moving %s to combat area.\n"),
-				        _(d_ptr->name));
-				break;
-
-			/* Support area */
-			case LOC_SUPPORT:
-
-				/* Format message */
-				sprintf(msg, _("Moving %s to support area.\n"),
-				        _(d_ptr->name));
-				break;
-
-			/* Leadership */
-			case LOC_LEADERSHIP:
-
-				/* Format message */
-				sprintf(msg,
-				        _("%s moves %s to leadership area.\n"),
-				        _(p->p_ptr->name), _(d_ptr->name));
-				break;
-
-			/* Discard */
-			case LOC_DISCARD:
-
-				/* Format message */
-				sprintf(msg,
-				        _("%s moves %s to discard pile.\n"),
-				        _(p->p_ptr->name), _(d_ptr->name));
-				break;
-		}
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record face-up moves */
+	if (faceup) add_event(g, EV_MOVE, who, d_ptr, NULL, to, 0);
 
 	/* If move is "face-up", card's location is known */
 	if (faceup) c->loc_known = 1;
@@ -343,6 +638,9 @@ void move_card(game *g, int who, design *d_ptr, int to, int faceup)
 
 	/* Check for removable fake flags */
 	remove_fake(g, who);
+
+	/* Update beliefs from known locations */
+	update_belief(g, who);
 }
 
 /*
@@ -456,21 +754,12 @@ design *random_draw(game *g, int who)
 	/* Get opponent pointer */
 	opp = &g->p[!who];
 
-	/* Loop over opponent's cards */
-	for (i = 1; i < DECK_SIZE; i++)
+	/* Loop over opponent's active category 3 cards */
+	for (i = next_special(opp, 3, 0); i; i = next_special(opp, 3, i))
 	{
 		/* Get card pointer */
 		c = &opp->deck[i];
 
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Skip cards with ignored text */
-		if (c->text_ignored) continue;
-
-		/* Skip cards with non-category 3 effects */
-		if (c->d_ptr->special_cat != 3) continue;
-
 		/* Get card's effect code */
 		effect = c->d_ptr->special_effect;
 		value = c->d_ptr->special_value;
@@ -531,6 +820,9 @@ static void reset_card(card *c)
 	/* Reset icons */
 	c->icons = c->d_ptr->icons;
 
+	/* Card is in its reset state */
+	c->modified = 0;
+
 	/* Check for bluff card */
 	if (c->bluff)
 	{
@@ -584,6 +876,9 @@ void reset_cards(game *g)
 			
 			/* Reset card */
 			reset_card(c);
+
+			/* Recount card's power */
+			update_power(g, i, c);
 		}
 
 		/* Clear player's minimum power level */
@@ -596,6 +891,9 @@ void reset_cards(game *g)
  */
 static void s1_ignore_card(card *c, int effect)
 {
+	/* Card may be changed */
+	c->modified = 1;
+
 	/* Check for ignore icons except STOP */
 	if (effect & S1_ICONS_BUT_S)
 	{
@@ -695,6 +993,9 @@ static void s1_ignore_card(card *c, int effect)
  */
 static void s1_boost_card(card *c, int effect, int value)
 {
+	/* Card may be changed */
+	c->modified = 1;
+
 	/* Check for boosting fire */
 	if (effect & S1_FIRE_VAL)
 	{
@@ -769,7 +1070,6 @@ static int boost_callback(game *g, int who, design **list, int num, void *data)
 	design *d_ptr = (design *)data;
 	card *c;
 	int effect, value;
-	char msg[1024];
 
 	/* Get effect code and value */
 	effect = d_ptr->special_effect;
@@ -787,163 +1087,125 @@ static int boost_callback(game *g, int who, design **list, int num, void *data)
 	/* Notice special text */
 	notice_effect_1(g);
 
-	/* Check for simulation */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("Boosting %s with %s.\n"), _(c->target->name),
-						          _(d_ptr->name));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_BOOST, who, c->target, d_ptr, 0, 0);
 
 	/* Success */
 	return 1;
 }
 
 /*
- * Handle a category 1 effect.
+ * Handle a category 1 "ignore" effect.
  */
-static void handle_effect_1(game *g, int who, design *d_ptr)
+static void s1_ignore(game *g, int who, design *d_ptr)
 {
 	player *p;
-	card *c, *t;
-	int effect, value;
-	int i;
+	card *c;
+	int effect, all, i;
 
-	/* Get effect code and value */
+	/* Get effect code */
 	effect = d_ptr->special_effect;
-	value = d_ptr->special_value;
 
-	/* Handle "ignore" effects */
-	if (effect & S1_IGNORE)
+	/* Check for all cards */
+	all = effect & S1_ALL_CARDS;
+
+	/* Get opponent pointer */
+	p = &g->p[!who];
+
+	/* Loop over opponent cards */
+	for (i = 1; i < DECK_SIZE; i++)
 	{
-		/* Get opponent pointer */
-		p = &g->p[!who];
+		/* Get card pointer */
+		c = &p->deck[i];
 
-		/* Loop over opponent cards */
-		for (i = 1; i < DECK_SIZE; i++)
+		/* Check for all cards */
+		if (all)
 		{
-			/* Get card pointer */
-			c = &p->deck[i];
-
-			/* Check for all cards */
-			if (effect & S1_ALL_CARDS)
-			{
-				/* Ignore this card */
-				s1_ignore_card(c, effect);
-			}
+			/* Ignore this card */
+			s1_ignore_card(c, effect);
+		}
 
-			/* Check for leadership card */
-			if (c->type == TYPE_LEADERSHIP &&
-			    (effect & S1_LEADERSHIP))
-			{
-				/* Ignore this card */
-				s1_ignore_card(c, effect);
-			}
+		/* Check for card of affected type */
+		if (c->type & d_ptr->effect_types)
+		{
+			/* Ignore this card */
+			s1_ignore_card(c, effect);
+		}
+	}
+}
 
-			/* Check for character card */
-			if (c->type == TYPE_CHARACTER &&
-			    (effect & S1_ALL_CHAR))
-			{
-				/* Ignore this card */
-				s1_ignore_card(c, effect);
-			}
+/*
+ * Handle a category 1 total power increase.
+ */
+static void s1_min_power(game *g, int who, design *d_ptr)
+{
+	player *p;
+	int value;
 
-			/* Check for booster card */
-			if (c->type == TYPE_BOOSTER &&
-			    (effect & S1_ALL_BOOSTER))
-			{
-				/* Ignore this card */
-				s1_ignore_card(c, effect);
-			}
+	/* Get effect value */
+	value = d_ptr->special_value;
 
-			/* Check for support card */
-			if (c->type == TYPE_SUPPORT &&
-			    (effect & S1_ALL_SUPPORT))
-			{
-				/* Ignore this card */
-				s1_ignore_card(c, effect);
-			}
-		}
+	/* We increase our own power */
+	p = &g->p[who];
 
-		/* Done with ignoring */
+	/* Check for fight in wrong element */
+	if (d_ptr->effect_element >= 0 &&
+	    (!g->fight_started || g->fight_element != d_ptr->effect_element))
+	{
+		/* No effect */
 		return;
 	}
 
-	/* We increase our own cards */
-	p = &g->p[who];
+	/* Increase minimum power */
+	if (p->min_power < value) p->min_power = value;
+}
 
-	/* Check for total power increase */
-	if (effect & S1_TOTAL_POWER)
-	{
-		/* Increase minimum power */
-		if (p->min_power < value) p->min_power = value;
+/*
+ * Handle a category 1 "one card" booster effect.
+ */
+static void s1_boost_one(game *g, int who, design *d_ptr)
+{
+	card *c, *t;
 
-		/* Done */
-		return;
-	}
+	/* Get card with effect */
+	c = find_card(g, who, d_ptr);
 
-	/* Check for total power in element increase */
-	if (effect & S1_TOTAL_FIRE)
-	{
-		/* Check for fight in fire */
-		if (g->fight_started && !g->fight_element)
-		{
-			/* Increase minimum power */
-			if (p->min_power < value) p->min_power = value;
-		}
+	/* Check for no target set */
+	if (!c->target) return;
 
-		/* Done */
-		return;
-	}
+	/* Get target card */
+	t = find_card(g, who, c->target);
 
-	/* Check for total power in element increase */
-	if (effect & S1_TOTAL_EARTH)
+	/* Check for inactive */
+	if (!t->active)
 	{
-		/* Check for fight in earth */
-		if (g->fight_started && g->fight_element)
-		{
-			/* Increase minimum power */
-			if (p->min_power < value) p->min_power = value;
-		}
+		/* Clear target */
+		c->target = NULL;
 
 		/* Done */
 		return;
 	}
 
-	/* Check for "one card" booster effects */
-	if (effect & (S1_ONE_CHAR | S1_ONE_BOOSTER | S1_ONE_SUPPORT))
-	{
-		/* Get card with effect */
-		c = find_card(g, who, d_ptr);
-
-		/* Check for target already set */
-		if (c->target)
-		{
-			/* Get target card */
-			t = find_card(g, who, c->target);
+	/* Apply effect to target card */
+	s1_boost_card(t, d_ptr->special_effect, d_ptr->special_value);
+}
 
-			/* Check for inactive */
-			if (!t->active)
-			{
-				/* Clear target */
-				c->target = NULL;
-			}
-			else
-			{
-				/* Apply effect to target card */
-				s1_boost_card(t, effect, value);
+/*
+ * Handle a category 1 effect that boosts all of our cards of some kind.
+ */
+static void s1_boost_all(game *g, int who, design *d_ptr)
+{
+	player *p;
+	card *c;
+	int effect, value;
+	int i;
 
-				/* Done */
-				return;
-			}
-		}
+	/* Get effect code and value */
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
 
-		/* Done */
-		return;
-	}
+	/* We increase our own cards */
+	p = &g->p[who];
 
 	/* Loop over our cards */
 	for (i = 1; i < DECK_SIZE; i++)
@@ -954,19 +1216,8 @@ static void handle_effect_1(game *g, int who, design *d_ptr)
 		/* Inactive cards cannot be boosted */
 		if (!c->active) continue;
 
-		/* Check for character card */
-		if (c->where == LOC_COMBAT &&
-		    c->type == TYPE_CHARACTER &&
-		    (effect & S1_ALL_CHAR))
-		{
-			/* Boost this card */
-			s1_boost_card(c, effect, value);
-		}
-
-		/* Check for booster card */
-		if (c->where == LOC_COMBAT &&
-		    c->type == TYPE_BOOSTER &&
-		    (effect & S1_ALL_BOOSTER))
+		/* Check for character or booster card */
+		if (c->where == LOC_COMBAT && (c->type & d_ptr->effect_types))
 		{
 			/* Boost this card */
 			s1_boost_card(c, effect, value);
@@ -989,6 +1240,170 @@ static void handle_effect_1(game *g, int who, design *d_ptr)
 	}
 }
 
+/*
+ * Special interactions between priority 2 cards.
+ */
+#define RULE_NONE		0
+#define RULE_ENTHRALL		1
+#define RULE_LAUGHING_GAS	2
+#define RULE_FLITTERFLUTTER	3
+
+/*
+ * Compile a design's category 1 effect into a handler and the parameters
+ * it needs, so that effects need not be decoded each time they apply.
+ */
+static void compile_effect_1(design *d_ptr)
+{
+	int effect, types = 0;
+
+	/* Get effect code */
+	effect = d_ptr->special_effect;
+
+	/* Assume any fight element */
+	d_ptr->effect_element = -1;
+
+	/* Check for "ignore" effects */
+	if (effect & S1_IGNORE)
+	{
+		/* Get types of opponent cards ignored */
+		if (effect & S1_LEADERSHIP) types |= TYPE_LEADERSHIP;
+		if (effect & S1_ALL_CHAR) types |= TYPE_CHARACTER;
+		if (effect & S1_ALL_BOOSTER) types |= TYPE_BOOSTER;
+		if (effect & S1_ALL_SUPPORT) types |= TYPE_SUPPORT;
+
+		/* Set handler */
+		d_ptr->effect_1 = s1_ignore;
+	}
+
+	/* Check for total power increases */
+	else if (effect & (S1_TOTAL_POWER | S1_TOTAL_FIRE | S1_TOTAL_EARTH))
+	{
+		/* Get element needed */
+		if (effect & S1_TOTAL_POWER) d_ptr->effect_element = -1;
+		else if (effect & S1_TOTAL_FIRE) d_ptr->effect_element = 0;
+		else d_ptr->effect_element = 1;
+
+		/* Set handler */
+		d_ptr->effect_1 = s1_min_power;
+	}
+
+	/* Check for "one card" booster effects */
+	else if (effect & (S1_ONE_CHAR | S1_ONE_BOOSTER | S1_ONE_SUPPORT))
+	{
+		/* Set handler */
+		d_ptr->effect_1 = s1_boost_one;
+	}
+
+	/* Boost all cards of some kinds */
+	else
+	{
+		/* Get types of combat cards boosted */
+		if (effect & S1_ALL_CHAR) types |= TYPE_CHARACTER;
+		if (effect & S1_ALL_BOOSTER) types |= TYPE_BOOSTER;
+
+		/* Set handler */
+		d_ptr->effect_1 = s1_boost_all;
+	}
+
+	/* Store card types affected */
+	d_ptr->effect_types = types;
+}
+
+/*
+ * Compile a design's category 3 effect.
+ *
+ * Only the card types named by the effect are needed ahead of time.
+ */
+static void compile_effect_3(design *d_ptr)
+{
+	int effect, types = 0;
+
+	/* Get effect code */
+	effect = d_ptr->special_effect;
+
+	/* Get types of cards named */
+	if (effect & S3_CHARACTER) types |= TYPE_CHARACTER;
+	if (effect & S3_BOOSTER) types |= TYPE_BOOSTER;
+	if (effect & S3_SUPPORT) types |= TYPE_SUPPORT;
+	if (effect & S3_LEADERSHIP) types |= TYPE_LEADERSHIP;
+
+	/* Store card types affected */
+	d_ptr->effect_types = types;
+}
+
+/*
+ * Compile a design's category 5 condition.
+ *
+ * Only the types of opponent cards counted are needed ahead of time.
+ */
+static void compile_effect_5(design *d_ptr)
+{
+	int effect, types = 0;
+
+	/* Get effect code */
+	effect = d_ptr->special_effect;
+
+	/* Get types of opponent cards counted */
+	if (effect & S5_YOU_CHARACTER) types |= TYPE_CHARACTER;
+	if (effect & S5_YOU_BOOSTER) types |= TYPE_BOOSTER;
+	if (effect & S5_YOU_SUPPORT) types |= TYPE_SUPPORT;
+
+	/* Store card types affected */
+	d_ptr->effect_types = types;
+}
+
+/*
+ * Compile the special effects of every card design.
+ *
+ * This is called once after the card designs are read.
+ */
+void compile_effects(void)
+{
+	design *d_ptr;
+	int i, j;
+
+	/* Loop over peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Loop over designs */
+		for (j = 0; j < DECK_SIZE; j++)
+		{
+			/* Get design pointer */
+			d_ptr = &peoples[i].deck[j];
+
+			/* Assume no compiled effect */
+			d_ptr->effect_1 = NULL;
+			d_ptr->effect_4 = NULL;
+			d_ptr->effect_8 = NULL;
+			d_ptr->effect_types = 0;
+			d_ptr->effect_rule = RULE_NONE;
+
+			/* Compile other categories of effect */
+			if (d_ptr->special_cat == 3) compile_effect_3(d_ptr);
+			if (d_ptr->special_cat == 4) compile_effect_4(d_ptr);
+			if (d_ptr->special_cat == 5) compile_effect_5(d_ptr);
+			if (d_ptr->special_cat == 8) compile_effect_8(d_ptr);
+
+			/* Skip designs without category 1 effects */
+			if (d_ptr->special_cat != 1) continue;
+
+			/* Compile effect */
+			compile_effect_1(d_ptr);
+
+			/* Skip cards that aren't priority 2 */
+			if (d_ptr->special_prio != 2) continue;
+
+			/* Check for cards with special interactions */
+			if (!strcmp(d_ptr->name, "Enthrall Opposition"))
+				d_ptr->effect_rule = RULE_ENTHRALL;
+			else if (!strcmp(d_ptr->name, "Laughing Gas"))
+				d_ptr->effect_rule = RULE_LAUGHING_GAS;
+			else if (!strcmp(d_ptr->name, "Flitterflutter"))
+				d_ptr->effect_rule = RULE_FLITTERFLUTTER;
+		}
+	}
+}
+
 /*
  * There are currently 3 "priority 2" cards with a "category 1" ignore
  * effect.
@@ -1015,11 +1430,14 @@ static void fix_priority_2(card *c, card *d)
 	/* Check for cards already ignored */
 	if (c->text_ignored || d->text_ignored) return;
 
+	/* Either card may be changed */
+	c->modified = d->modified = 1;
+
 	/* Check for matching cards */
 	if (c->d_ptr == d->d_ptr)
 	{
 		/* Check for Laughing Gas */
-		if (!strcmp(c->d_ptr->name, "Laughing Gas"))
+		if (c->d_ptr->effect_rule == RULE_LAUGHING_GAS)
 		{
 			/* Both cards are ignored */
 			c->text_ignored = 1;
@@ -1031,17 +1449,17 @@ static void fix_priority_2(card *c, card *d)
 	}
 
 	/* Check for "Enthrall Opposition" */
-	if (!strcmp(c->d_ptr->name, "Enthrall Opposition"))
+	if (c->d_ptr->effect_rule == RULE_ENTHRALL)
 	{
 		/* Check for opposing "Flitterflutter" */
-		if (!strcmp(d->d_ptr->name, "Flitterflutter"))
+		if (d->d_ptr->effect_rule == RULE_FLITTERFLUTTER)
 		{
 			/* Ignore Flitterflutter */
 			d->text_ignored = 1;
 		}
 
 		/* Check for opposing "Laughing Gas" */
-		else if (!strcmp(d->d_ptr->name, "Laughing Gas"))
+		else if (d->d_ptr->effect_rule == RULE_LAUGHING_GAS)
 		{
 			/* Ignore Enthrall Opposition */
 			c->text_ignored = 1;
@@ -1049,17 +1467,17 @@ static void fix_priority_2(card *c, card *d)
 	}
 
 	/* Check for "Flitterflutter" */
-	else if (!strcmp(c->d_ptr->name, "Flitterflutter"))
+	else if (c->d_ptr->effect_rule == RULE_FLITTERFLUTTER)
 	{
 		/* Check for opposing "Laughing Gas" */
-		if (!strcmp(d->d_ptr->name, "Laughing Gas"))
+		if (d->d_ptr->effect_rule == RULE_LAUGHING_GAS)
 		{
 			/* Ignore Laughing Gas */
 			d->text_ignored = 1;
 		}
 
 		/* Check for opposing "Enthrall Opposition" */
-		else if (!strcmp(d->d_ptr->name, "Enthrall Opposition"))
+		else if (d->d_ptr->effect_rule == RULE_ENTHRALL)
 		{
 			/* Ignore Flitterflutter */
 			c->text_ignored = 1;
@@ -1067,17 +1485,17 @@ static void fix_priority_2(card *c, card *d)
 	}
 
 	/* Check for "Laughing Gas" */
-	else if (!strcmp(c->d_ptr->name, "Laughing Gas"))
+	else if (c->d_ptr->effect_rule == RULE_LAUGHING_GAS)
 	{
 		/* Check for opposing "Enthrall Opposition" */
-		if (!strcmp(d->d_ptr->name, "Enthrall Opposition"))
+		if (d->d_ptr->effect_rule == RULE_ENTHRALL)
 		{
 			/* Ignore Enthrall Opposition */
 			d->text_ignored = 1;
 		}
 
 		/* Check for opposing "Flitterflutter" */
-		if (!strcmp(d->d_ptr->name, "Flitterflutter"))
+		if (d->d_ptr->effect_rule == RULE_FLITTERFLUTTER)
 		{
 			/* Ignore Laughing Gas */
 			c->text_ignored = 1;
@@ -1087,23 +1505,66 @@ static void fix_priority_2(card *c, card *d)
 
 
 /*
- * Notice "category 1" effects on cards.
+ * Reset only those cards that may differ from their reset state.
  *
- * This should be called anytime a card is played, discarded, retrieved,
- * made inactive, etc.
+ * Cards in the discard pile are skipped, as in reset_cards().
  */
-void notice_effect_1(game *g)
+static void reset_modified(game *g)
+{
+	player *p;
+	card *c;
+	int i, j;
+
+	/* Loop over each player */
+	for (i = 0; i < 2; i++)
+	{
+		/* Get player pointer */
+		p = &g->p[i];
+
+		/* Loop over cards */
+		for (j = 1; j < DECK_SIZE; j++)
+		{
+			/* Get card pointer */
+			c = &p->deck[j];
+
+			/* Skip unmodified cards */
+			if (!c->modified) continue;
+
+			/* Cards in discard pile may be skipped */
+			if (c->where == LOC_DISCARD) continue;
+
+			/* Reset card */
+			reset_card(c);
+
+			/* Recount card's power */
+			update_power(g, i, c);
+		}
+
+		/* Clear player's minimum power level */
+		p->min_power = 0;
+	}
+}
+
+/*
+ * Apply "category 1" effects.
+ *
+ * If "full" is set, every card is reset first.  Otherwise only cards
+ * changed by earlier effects (or whose reset state has changed) are
+ * reset, and nothing more is done if no category 1 card is active.
+ */
+static void resolve_effect_1(game *g, int full)
 {
 	int i, j;
 	player *p;
 	card *c;
-	card *list[DECK_SIZE];
+	card *list[DECK_SIZE * 2];
 	int num = 0;
 	int b_p, b_i = 0;
 
 	/* First reset card effects */
-	reset_cards(g);
-	
+	if (full) reset_cards(g);
+	else reset_modified(g);
+
 	/* Loop over each player */
 	for (i = 0; i < 2; i++)
 	{
@@ -1156,22 +1617,117 @@ void notice_effect_1(game *g)
 		if (!list[b_i]->text_ignored)
 		{
 			/* Handle effect */
-			handle_effect_1(g, list[b_i]->owner, list[b_i]->d_ptr);
+			list[b_i]->d_ptr->effect_1(g, list[b_i]->owner,
+			                           list[b_i]->d_ptr);
 		}
 
 		/* Remove card from list */
 		list[b_i] = list[--num];
 	}
+
+	/* Loop over each player */
+	for (i = 0; i < 2; i++)
+	{
+		/* Get player pointer */
+		p = &g->p[i];
+
+		/* Loop over cards */
+		for (j = 1; j < DECK_SIZE; j++)
+		{
+			/* Get card pointer */
+			c = &p->deck[j];
+
+			/* Recount cards changed by effects */
+			if (c->modified) update_power(g, i, c);
+		}
+	}
+}
+
+#ifdef DEBUG
+/*
+ * Check that incrementally resolved effects match a full recompute.
+ */
+static void check_effect_1(game *g, game *full)
+{
+	card *c, *d;
+	int i, j;
+
+	/* Recompute from scratch */
+	resolve_effect_1(full, 1);
+
+	/* Loop over each player */
+	for (i = 0; i < 2; i++)
+	{
+		/* Check minimum power */
+		if (g->p[i].min_power != full->p[i].min_power)
+		{
+			/* Error */
+			fprintf(stderr, "Effect 1 mismatch: min power\n");
+			exit(1);
+		}
+
+		/* Loop over cards */
+		for (j = 1; j < DECK_SIZE; j++)
+		{
+			/* Get card pointers */
+			c = &g->p[i].deck[j];
+			d = &full->p[i].deck[j];
+
+			/* Compare everything effects may change */
+			if (c->printed[0] != d->printed[0] ||
+			    c->printed[1] != d->printed[1] ||
+			    c->value[0] != d->value[0] ||
+			    c->value[1] != d->value[1] ||
+			    c->icons != d->icons ||
+			    c->value_ignored != d->value_ignored ||
+			    c->text_ignored != d->text_ignored ||
+			    c->text_boosted != d->text_boosted ||
+			    c->playing_free != d->playing_free)
+			{
+				/* Error */
+				fprintf(stderr, "Effect 1 mismatch: %s\n",
+				        c->d_ptr->name);
+				exit(1);
+			}
+		}
+	}
+}
+#endif
+
+/*
+ * Notice "category 1" effects on cards.
+ *
+ * This should be called anytime a card is played, discarded, retrieved,
+ * made inactive, etc.
+ */
+void notice_effect_1(game *g)
+{
+#ifdef DEBUG
+	game full;
+
+	/* Copy game for full recompute */
+	full = *g;
+#endif
+
+	/* Apply effects to changed cards */
+	resolve_effect_1(g, 0);
+
+#ifdef DEBUG
+	/* Compare with full recompute */
+	check_effect_1(g, &full);
+#endif
 }
 
 /*
  * Check that cards with a phrase like "one of my ..." have a valid
  * target card.  If there are multiple choices, we might ask the player
  * to choose.
+ *
+ * Power-boosting targets are tried directly on the game, since noticing
+ * effects again after the final target is set undoes the others.
  */
 static void check_targets(game *g, int who, int ask)
 {
-	game sim;
 	player *p;
 	card *c, *t;
 	design *list[DECK_SIZE], *b_t = NULL;
@@ -1296,17 +1852,14 @@ static void check_targets(game *g, int who, int ask)
 			/* Loop over possible targets */
 			for (j = 0; j < num; j++)
 			{
-				/* Simulate game */
-				sim = *g;
-
-				/* Set target */
-				sim.p[who].deck[i].target = list[j];
+				/* Try target */
+				c->target = list[j];
 
 				/* Notice effect */
-				notice_effect_1(&sim);
+				notice_effect_1(g);
 
 				/* Get power */
-				power = compute_power(&sim, who);
+				power = compute_power(g, who);
 
 				/* Check for more power */
 				if (power > b_p)
@@ -1320,7 +1873,7 @@ static void check_targets(game *g, int who, int ask)
 			/* Set target to that which resulted in most power */
 			c->target = b_t;
 
-			/* Consider target changed */
+			/* Consider target changed (effects are noticed below) */
 			changed = 1;
 
 			/* Done */
@@ -1388,20 +1941,11 @@ int retrieve_legal(game *g, card *c)
  */
 void retrieve_card(game *g, design *d_ptr)
 {
-	char msg[1024];
 	player *p;
 	card *c;
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s retrieves %s.\n"),
-		             _(g->p[g->turn].p_ptr->name), _(d_ptr->name));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_RETRIEVE, g->turn, d_ptr, NULL, 0, 0);
 
 	/* Current player */
 	p = &g->p[g->turn];
@@ -1410,7 +1954,7 @@ void retrieve_card(game *g, design *d_ptr)
 	c = find_card(g, g->turn, d_ptr);
 
 	/* Cards in hand become inactive */
-	deactivate_card(c);
+	deactivate_card(g, g->turn, c);
 
 	/* Reduce old stack size */
 	p->stack[c->where]--;
@@ -1424,6 +1968,9 @@ void retrieve_card(game *g, design *d_ptr)
 	/* Card's location in hand is known */
 	c->loc_known = 1;
 
+	/* Update beliefs */
+	update_belief(g, g->turn);
+
 	/* Take notice of affected special texts */
 	notice_effect_1(g);
 }
@@ -1568,18 +2115,13 @@ static int card_text_matches(game *g, design *d_ptr)
 	}
 
 	/* Check for opponent active cards */
-	if (effect & (S5_YOU_CHARACTER | S5_YOU_BOOSTER | S5_YOU_SUPPORT))
+	if (d_ptr->effect_types)
 	{
 		/* Clear count */
 		count = 0;
 
-		/* Clear type mask */
-		type = 0;
-
-		/* Set type mask */
-		if (effect & S5_YOU_CHARACTER) type |= TYPE_CHARACTER;
-		if (effect & S5_YOU_BOOSTER) type |= TYPE_BOOSTER;
-		if (effect & S5_YOU_SUPPORT) type |= TYPE_SUPPORT;
+		/* Get compiled type mask */
+		type = d_ptr->effect_types;
 
 		/* Loop over cards */
 		for (i = 1; i < DECK_SIZE; i++)
@@ -1649,37 +2191,65 @@ static int card_text_matches(game *g, design *d_ptr)
 }
 
 /*
- * Return true if a given card design can be played.
- *
- * "Category 3" special effects affect this.
- *
- * FREE, PAIR, and GANG icons affect this.
+ * What the current player has played this turn, as far as it affects
+ * which further cards may be played.
  */
-int card_allowed(game *g, design *d_ptr)
+typedef struct allow_info
 {
-	player *p, *opp;
-	card *c;
+	/* Cards counted against support and booster limits */
+	int played_support, played_booster;
+
+	/* Cards played this turn */
+	int played_all;
+
+	/* Characters and boosters actually played */
+	int real_char, real_booster;
+
+	/* A card with a STOP icon has been played */
+	int stop_played;
+
+	/* Gangs that still match every combat card played */
+	int gang_good;
+
+	/* Unmatched PAIR cards played */
 	design *pair_list[DECK_SIZE];
-	int num_pair = 0, match;
-	int gang_good = ICON_GANG_MASK;
-	int effect, value;
-	int played_support, played_booster, played_all;
-	int real_support, real_booster, real_char;
+	int num_pair;
+
+	/* Remaining support, booster and either-type plays */
 	int max_support, max_booster, max_either;
-	int stop_played = 0, temp_free = 0;
+
+	/* An "I may play as free" effect is available */
+	int temp_free;
+
+} allow_info;
+
+/*
+ * Gather the information about the current turn that card_allowed()
+ * needs, which is the same for every card tested.
+ */
+static void allow_prepare(game *g, allow_info *a)
+{
+	player *p;
+	card *c;
+	int effect, value;
+	int real_support, match;
 	int i, j;
 
 	/* Get our pointer */
 	p = &g->p[g->turn];
 
-	/* Get opponent pointer */
-	opp = &g->p[!g->turn];
-
 	/* Clear counts of played cards */
-	played_support = real_support = 0;
-	played_booster = real_booster = 0;
-	real_char = 0;
-	played_all = 0;
+	a->played_support = real_support = 0;
+	a->played_booster = a->real_booster = 0;
+	a->real_char = 0;
+	a->played_all = 0;
+
+	/* No STOP icon or pairs yet */
+	a->stop_played = 0;
+	a->num_pair = 0;
+
+	/* All gangs are good */
+	a->gang_good = ICON_GANG_MASK;
 
 	/* Loop over cards */
 	for (i = 1; i < DECK_SIZE; i++)
@@ -1691,30 +2261,30 @@ int card_allowed(game *g, design *d_ptr)
 		if (!c->recent) continue;
 
 		/* Count card */
-		played_all++;
+		a->played_all++;
 
 		/* Check for cards loaded onto ship */
 		if (c->where == LOC_INFLUENCE &&
 		    c->type != TYPE_INFLUENCE)
 		{
 			/* Count as played support */
-			played_support++;
+			a->played_support++;
 
 			/* Done */
 			continue;
 		}
 
 		/* Check for character */
-		if (c->type == TYPE_CHARACTER) real_char++;
+		if (c->type == TYPE_CHARACTER) a->real_char++;
 
 		/* Check for support */
 		if (c->type == TYPE_SUPPORT) real_support++;
 
 		/* Check for booster */
-		if (c->type == TYPE_BOOSTER) real_booster++;
+		if (c->type == TYPE_BOOSTER) a->real_booster++;
 
 		/* Cards with STOP icons prevent further cards */
-		if (c->icons & ICON_STOP) stop_played = 1;
+		if (c->icons & ICON_STOP) a->stop_played = 1;
 
 		/* Don't count cards with FREE icon */
 		if (c->icons & ICON_FREE) continue;
@@ -1729,13 +2299,14 @@ int card_allowed(game *g, design *d_ptr)
 			match = 0;
 
 			/* Attempt to find matching pair */
-			for (j = 0; j < num_pair; j++)
+			for (j = 0; j < a->num_pair; j++)
 			{
 				/* Check for match */
-				if (pair_match(c->d_ptr, pair_list[j]))
+				if (pair_match(c->d_ptr, a->pair_list[j]))
 				{
 					/* Remove pair from list */
-					pair_list[j] = pair_list[--num_pair];
+					a->pair_list[j] =
+					              a->pair_list[--a->num_pair];
 
 					/* Pair was matched */
 					match = 1;
@@ -1749,33 +2320,126 @@ int card_allowed(game *g, design *d_ptr)
 			if (match) continue;
 
 			/* Add design to pair list */
-			pair_list[num_pair++] = c->d_ptr;
+			a->pair_list[a->num_pair++] = c->d_ptr;
 		}
 
 		/* Check for combat cards */
 		if (c->where == LOC_COMBAT)
 		{
 			/* Track which gang is legal to play */
-			gang_good &= (c->icons & ICON_GANG_MASK);
+			a->gang_good &= (c->icons & ICON_GANG_MASK);
 		}
 
 		/* Check for support */
-		if (c->type == TYPE_SUPPORT) played_support++;
+		if (c->type == TYPE_SUPPORT) a->played_support++;
 
 		/* Check for booster */
-		if (c->type == TYPE_BOOSTER) played_booster++;
+		if (c->type == TYPE_BOOSTER) a->played_booster++;
 	}
 
 	/* Check for stop icon */
-	if (stop_played)
+	if (a->stop_played)
 	{
 		/* Count FREE cards among number played */
-		played_support = real_support;
-		played_booster = real_booster;
+		a->played_support = real_support;
+		a->played_booster = a->real_booster;
+	}
+
+	/* Normal maximum amounts */
+	a->max_support = a->max_booster = 0;
+	a->max_either = 1;
+
+	/* Check for beginning of fight */
+	if (!g->fight_started) a->max_either = 0;
+
+	/* Check for STOP icon */
+	if (a->stop_played) a->max_either = 0;
+
+	/* No temporary free effect yet */
+	a->temp_free = 0;
+
+	/* Check our cards for "I may play" effects */
+	for (i = next_special(p, 3, 0); i; i = next_special(p, 3, i))
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Get effect code and value */
+		effect = c->d_ptr->special_effect;
+		value = c->d_ptr->special_value;
+
+		/* Skip cards that aren't "I may" */
+		if (!(effect & S3_I_MAY_PLAY)) continue;
+
+		/* Check for support flag */
+		if (effect & S3_SUPPORT)
+		{
+			/* Check for additional */
+			if (effect & S3_ADDITIONAL) a->max_support += value;
+
+			/* Set value */
+			else a->max_support = value;
+		}
+
+		/* Check for booster flag */
+		if (effect & S3_BOOSTER)
+		{
+			/* Check for additional */
+			if (effect & S3_ADDITIONAL) a->max_booster += value;
+			
+			/* Set value */
+			else a->max_booster = value;
+		}
+
+		/* Check for unused "as free" flag */
+		if ((effect & S3_AS_FREE) && !c->used)
+		{
+			/* Set temporary free flag */
+			a->temp_free = 1;
+		}
+	}
+
+	/* Account for booster cards played */
+	for (i = 0; i < a->played_booster; i++)
+	{
+		/* Reduce max boosters if possible */
+		if (a->max_booster) a->max_booster--;
+
+		/* Otherwise reduce booster/support */
+		else if (a->max_either) a->max_either--;
+	}
+
+	/* Account for support cards played */
+	for (i = 0; i < a->played_support; i++)
+	{
+		/* Reduce max support if possible */
+		if (a->max_support) a->max_support--;
+
+		/* Otherwise reduce booster/support */
+		else if (a->max_either) a->max_either--;
 	}
+}
+
+/*
+ * Return true if a given card design can be played, given information
+ * about the turn from allow_prepare().
+ */
+static int allow_check(game *g, allow_info *a, design *d_ptr)
+{
+	player *p, *opp;
+	card *c;
+	int effect, value;
+	int temp_free;
+	int i;
+
+	/* Get our pointer */
+	p = &g->p[g->turn];
+
+	/* Get opponent pointer */
+	opp = &g->p[!g->turn];
 
 	/* Check for a card played */
-	if (played_all)
+	if (a->played_all)
 	{
 		/* Leadership phase cards can no longer be played */
 		if (d_ptr->type == TYPE_LEADERSHIP ||
@@ -1786,21 +2450,12 @@ int card_allowed(game *g, design *d_ptr)
 		}
 	}
 
-	/* Loop over opponent cards */
-	for (i = 1; i < DECK_SIZE; i++)
+	/* Loop over opponent's active category 3 cards */
+	for (i = next_special(opp, 3, 0); i; i = next_special(opp, 3, i))
 	{
 		/* Get card pointer */
 		c = &opp->deck[i];
 
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Skip cards with ignored text */
-		if (c->text_ignored) continue;
-
-		/* Skip cards that do not have "category 3" effects */
-		if (c->d_ptr->special_cat != 3) continue;
-
 		/* Get effect code and value */
 		effect = c->d_ptr->special_effect;
 		value = c->d_ptr->special_value;
@@ -1815,7 +2470,7 @@ int card_allowed(game *g, design *d_ptr)
 			if (effect & S3_COMBAT)
 			{
 				/* Check for too many combat cards */
-				if (real_char + real_booster >= value)
+				if (a->real_char + a->real_booster >= value)
 				{
 					/* Disallow characters and boosters */
 					if (d_ptr->type == TYPE_CHARACTER ||
@@ -1831,19 +2486,15 @@ int card_allowed(game *g, design *d_ptr)
 			else if (effect & S3_CHARACTER)
 			{
 				/* Disallow multiple characters */
-				if (real_char > value) return 0;
+				if (a->real_char > value) return 0;
 			}
 
 			/* Otherwise check all cards played */
-			else if (played_all >= value) return 0;
+			else if (a->played_all >= value) return 0;
 		}
 
 		/* Check for type match */
-		else if
-		   ((d_ptr->type == TYPE_SUPPORT && (effect & S3_SUPPORT)) ||
-		   (d_ptr->type == TYPE_BOOSTER && (effect & S3_BOOSTER)) ||
-		   (d_ptr->type == TYPE_CHARACTER && (effect & S3_CHARACTER)) ||
-		   (d_ptr->type == TYPE_LEADERSHIP && (effect & S3_LEADERSHIP)))
+		else if (d_ptr->type & c->d_ptr->effect_types)
 		{
 			/* Check for "has special text" flag */
 			if (effect & S3_HAVE_SPECIAL)
@@ -1872,65 +2523,8 @@ int card_allowed(game *g, design *d_ptr)
 		}
 	}
 
-	/* Normal maximum amounts */
-	max_support = max_booster = 0;
-	max_either = 1;
-
-	/* Check for beginning of fight */
-	if (!g->fight_started) max_either = 0;
-
-	/* Check for STOP icon */
-	if (stop_played) max_either = 0;
-
-	/* Check our cards for "I may play" effects */
-	for (i = 1; i < DECK_SIZE; i++)
-	{
-		/* Get card pointer */
-		c = &p->deck[i];
-
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Skip cards with ignored text */
-		if (c->text_ignored) continue;
-
-		/* Skip cards that do not have "category 3" effects */
-		if (c->d_ptr->special_cat != 3) continue;
-
-		/* Get effect code and value */
-		effect = c->d_ptr->special_effect;
-		value = c->d_ptr->special_value;
-
-		/* Skip cards that aren't "I may" */
-		if (!(effect & S3_I_MAY_PLAY)) continue;
-
-		/* Check for support flag */
-		if (effect & S3_SUPPORT)
-		{
-			/* Check for additional */
-			if (effect & S3_ADDITIONAL) max_support += value;
-
-			/* Set value */
-			else max_support = value;
-		}
-
-		/* Check for booster flag */
-		if (effect & S3_BOOSTER)
-		{
-			/* Check for additional */
-			if (effect & S3_ADDITIONAL) max_booster += value;
-			
-			/* Set value */
-			else max_booster = value;
-		}
-
-		/* Check for unused "as free" flag */
-		if ((effect & S3_AS_FREE) && !c->used)
-		{
-			/* Set temporary free flag */
-			temp_free = 1;
-		}
-	}
+	/* Start with "I may play as free" effects */
+	temp_free = a->temp_free;
 
 	/* Find card we are attempting to play */
 	c = find_card(g, g->turn, d_ptr);
@@ -1952,7 +2546,7 @@ int card_allowed(game *g, design *d_ptr)
 	}
 
 	/* Set temporary free if needed */
-	if (temp_free && !stop_played)
+	if (temp_free && !a->stop_played)
 	{
 		/* Set temp free on card */
 		c->playing_free = 1;
@@ -1962,7 +2556,7 @@ int card_allowed(game *g, design *d_ptr)
 	}
 
 	/* Check for usable FREE icon */
-	if (((c->icons & ICON_FREE) || c->playing_free) && !stop_played)
+	if (((c->icons & ICON_FREE) || c->playing_free) && !a->stop_played)
 	{
 		/* Check for temporary free */
 		if (temp_free)
@@ -1984,48 +2578,28 @@ int card_allowed(game *g, design *d_ptr)
 	}
 
 	/* Check for PAIR icon */
-	if ((c->icons & ICON_PAIR) && !stop_played)
+	if ((c->icons & ICON_PAIR) && !a->stop_played)
 	{
 		/* Loop over active pairs */
-		for (i = 0; i < num_pair; i++)
+		for (i = 0; i < a->num_pair; i++)
 		{
 			/* Check for match */
-			if (pair_match(d_ptr, pair_list[i])) return 1;
+			if (pair_match(d_ptr, a->pair_list[i])) return 1;
 		}
 	}
 
 	/* Check for GANG icon */
-	if ((c->icons & ICON_GANG_MASK) && !stop_played)
+	if ((c->icons & ICON_GANG_MASK) && !a->stop_played)
 	{
 		/* Check for match with existing gang (if any) */
-		if ((c->icons & ICON_GANG_MASK) & gang_good) return 1;
-	}
-
-	/* Account for booster cards played */
-	for (i = 0; i < played_booster; i++)
-	{
-		/* Reduce max boosters if possible */
-		if (max_booster) max_booster--;
-
-		/* Otherwise reduce booster/support */
-		else if (max_either) max_either--;
-	}
-
-	/* Account for support cards played */
-	for (i = 0; i < played_support; i++)
-	{
-		/* Reduce max support if possible */
-		if (max_support) max_support--;
-
-		/* Otherwise reduce booster/support */
-		else if (max_either) max_either--;
+		if ((c->icons & ICON_GANG_MASK) & a->gang_good) return 1;
 	}
 
 	/* Check for booster */
 	if (d_ptr->type == TYPE_BOOSTER)
 	{
 		/* Check for allowed boosters */
-		if (max_booster || max_either) return 1;
+		if (a->max_booster || a->max_either) return 1;
 
 		/* Otherwise not allowed */
 		return 0;
@@ -2035,7 +2609,7 @@ int card_allowed(game *g, design *d_ptr)
 	if (d_ptr->type == TYPE_SUPPORT)
 	{
 		/* Check for allowed support */
-		if (max_support || max_either) return 1;
+		if (a->max_support || a->max_either) return 1;
 
 		/* Otherwise not allowed */
 		return 0;
@@ -2058,38 +2632,91 @@ int card_allowed(game *g, design *d_ptr)
 }
 
 /*
- * Return true if the given card is eligible to be played.
+ * Return true if a given card design can be played.
  *
- * Normally this means "in the hand", but if a ship is landed, the card
- * needs to be on a landed ship.  Of course there are special power texts
- * that cause exceptions.
+ * "Category 3" special effects affect this.
+ *
+ * FREE, PAIR, and GANG icons affect this.
  */
-int card_eligible(game *g, design *d_ptr)
+int card_allowed(game *g, design *d_ptr)
+{
+	allow_info a;
+
+	/* Gather information about this turn */
+	allow_prepare(g, &a);
+
+	/* Check card */
+	return allow_check(g, &a, d_ptr);
+}
+
+/*
+ * Return the subset of the given cards (one bit per deck index of the
+ * current player) that can be played.
+ *
+ * This is the same as calling card_allowed() for each card in turn, but
+ * the parts common to every card are only worked out once.
+ */
+unsigned int allowed_cards(game *g, unsigned int mask)
 {
 	player *p;
-	card *c, *playing;
-	int ship = 0, ship_hand = 0, on_ship = 0;
+	allow_info a;
+	unsigned int allowed = 0;
 	int i;
 
+	/* Check for no cards to test */
+	if (!mask) return 0;
+
 	/* Get player pointer */
 	p = &g->p[g->turn];
 
-	/* Find card we intend to play */
-	playing = find_card(g, g->turn, d_ptr);
+	/* Gather information about this turn */
+	allow_prepare(g, &a);
 
-	/* Non-character/booster/support cards can be played if in hand */
-	if (d_ptr->type > TYPE_SUPPORT)
+	/* Loop over cards to test */
+	while (mask)
 	{
-		/* Card is eligible if in the hand */
-		return playing->where == LOC_HAND;
+		/* Get lowest index */
+		i = ffs(mask) - 1;
+
+		/* Remove card from mask */
+		mask &= mask - 1;
+
+		/* Check card */
+		if (allow_check(g, &a, p->deck[i].d_ptr)) allowed |= 1U << i;
 	}
 
+	/* Return allowed cards */
+	return allowed;
+}
+
+/*
+ * Return the current player's cards that are eligible to be played (one
+ * bit per deck index).
+ *
+ * Normally this means "in the hand", but if a ship is landed, the card
+ * needs to be on a landed ship.  Of course there are special power texts
+ * that cause exceptions.
+ */
+unsigned int eligible_cards(game *g)
+{
+	player *p;
+	card *c;
+	unsigned int hand = 0, eligible;
+	int ship = 0, ship_hand = 0;
+	int i;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
 	/* Loop over cards */
 	for (i = 1; i < DECK_SIZE; i++)
 	{
 		/* Get card pointer */
 		c = &p->deck[i];
 
+		/* Track cards in hand */
+		if (c->where == LOC_HAND) hand |= 1U << i;
+
 		/* Skip unlanded ships */
 		if (!c->landed) continue;
 
@@ -2106,26 +2733,58 @@ int card_eligible(game *g, design *d_ptr)
 				ship_hand = 1;
 			}
 		}
-
-		/* Check for card on landed ship */
-		if (playing->ship == c->d_ptr) on_ship = 1;
 	}
 
 	/* Check for no landed ships */
-	if (!ship)
-	{
-		/* Card is eligible if in the hand */
-		return playing->where == LOC_HAND;
-	}
+	if (!ship) return hand;
 
-	/* Check for on a landed ship */
-	if (on_ship) return 1;
+	/* Start with no cards */
+	eligible = 0;
 
-	/* Check for in hand, but cards from hand are eligible */
-	if (playing->where == LOC_HAND && ship_hand) return 1;
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
 
-	/* Card is not eligible */
-	return 0;
+		/* Non-character/booster/support cards only from the hand */
+		if (c->d_ptr->type > TYPE_SUPPORT)
+		{
+			/* Card is eligible if in the hand */
+			eligible |= hand & (1U << i);
+		}
+
+		/* Check for card on landed ship */
+		else if (c->ship && find_card(g, g->turn, c->ship)->landed)
+		{
+			/* Card is eligible */
+			eligible |= 1U << i;
+		}
+
+		/* Check for cards from hand being eligible */
+		else if (ship_hand)
+		{
+			/* Card is eligible if in the hand */
+			eligible |= hand & (1U << i);
+		}
+	}
+
+	/* Return eligible cards */
+	return eligible;
+}
+
+/*
+ * Return true if the given card is eligible to be played.
+ */
+int card_eligible(game *g, design *d_ptr)
+{
+	player *p;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Check card's bit */
+	return (eligible_cards(g) >> (find_card(g, g->turn, d_ptr) - p->deck)) & 1;
 }
 
 /*
@@ -2422,6 +3081,9 @@ static void discard_bluff(game *g, int who)
 	/* Clear bluff flag */
 	chosen->bluff = 0;
 
+	/* Card's reset state has changed */
+	chosen->modified = 1;
+
 	/* Move to discard */
 	move_card(g, who, chosen->d_ptr, LOC_DISCARD, faceup);
 }
@@ -2472,16 +3134,15 @@ static void discard_random(game *g, int who)
 }
 
 /*
- * Handle a discard choice.
+ * Check that a set of discards is allowed by the effect asking for them.
  */
-static int discard_callback(game *g, int who, design **list, int num,
-                            void *data)
+static int discard_legal(game *g, int who, design **list, int num,
+                         design *d_ptr)
 {
-	design *d_ptr = (design *)data;
 	player *p;
 	card *c;
 	int effect, type = 0;
-	int i, dest, count = 0;
+	int i, count = 0;
 
 	/* Get special effect */
 	effect = d_ptr->special_effect;
@@ -2602,6 +3263,26 @@ static int discard_callback(game *g, int who, design **list, int num,
 		}
 	}
 
+	/* Discards are legal */
+	return 1;
+}
+
+/*
+ * Handle a discard choice.
+ */
+static int discard_callback(game *g, int who, design **list, int num,
+                            void *data)
+{
+	design *d_ptr = (design *)data;
+	int effect;
+	int i, dest;
+
+	/* Check for illegal discards */
+	if (!discard_legal(g, who, list, num, d_ptr)) return 0;
+
+	/* Get special effect */
+	effect = d_ptr->special_effect;
+
 	/* Loop over cards */
 	for (i = 0; i < num; i++)
 	{
@@ -2919,7 +3600,7 @@ static int favor_callback(game *g, int who, design **list, int num, void *data)
 			}
 
 			/* Prompt */
-			printf(prompt, _("Choose ship to load"));
+			sprintf(prompt, _("Choose ship to load"));
 
 			/* Choose cards and load them */
 			p->control->choose(g, who, who, choices, num_choices,
@@ -2936,522 +3617,452 @@ static int favor_callback(game *g, int who, design **list, int num, void *data)
 }
 
 /*
- * Handle a "category 4" special effect.
- *
- * These involve moving cards from one pile to another.
+ * Discard cards from the opponent's hand, deck, or play area, or from
+ * our own hand.
  */
-static void handle_effect_4(game *g, card *c_ptr, int time)
+static void s4_discard(game *g, design *d_ptr, int time)
 {
 	player *p, *opp;
 	design *pick, *list[DECK_SIZE];
 	card *c;
 	int num_choices = 0, num_bluff = 0;
 	int effect, value;
-	int type = 0, ships = 0, src, dest, min, max = 0, num_char = 0;
+	int type, src, dest, min, num_char = 0;
 	char prompt[1024];
 	int i;
 
-	/* Check for correct timing */
-	if (time != c_ptr->d_ptr->special_time) return;
-
 	/* Get player and opponent pointers */
 	p = &g->p[g->turn];
 	opp = &g->p[!g->turn];
 
 	/* Get effect code and value */
-	effect = c_ptr->d_ptr->special_effect;
-	value = c_ptr->d_ptr->special_value;
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
 
-	/* Check for discard effect */
-	if (effect & S4_DISCARD)
+	/* Check for discard from hand or deck */
+	if (effect & (S4_YOUR_HAND | S4_YOUR_DECK))
 	{
-		/* Check for discard from hand or deck */
-		if (effect & (S4_YOUR_HAND | S4_YOUR_DECK))
+		/* Loop over opponent cards */
+		for (i = 1; i < DECK_SIZE; i++)
 		{
-			/* Loop over opponent cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &opp->deck[i];
-
-				/* Skip cards not in hand */
-				if (c->where != LOC_HAND) continue;
-
-				/* Skip undisclosed cards */
-				if (!c->disclosed) continue;
-
-				/* Add design to list */
-				list[num_choices++] = c->d_ptr;
-			}
-
-			/* Check for no disclosed cards or discard from deck */
-			if (!num_choices || (effect & S4_YOUR_DECK))
-			{
-				/* Assume hand */
-				src = LOC_HAND;
-
-				/* Check for discard from deck */
-				if (effect & S4_YOUR_DECK) src = LOC_DRAW;
-
-				/* Move cards */
-				for (i = 0; i < value; i++)
-				{
-					/* Pick card at random */
-					pick = random_card(g, !g->turn, src);
-
-					/* Check for none left */
-					if (!pick) break;
-
-					/* Check for leadership */
-					if (pick->type == TYPE_LEADERSHIP)
-					{
-						/* Go to leadership pile */
-						dest = LOC_LEADERSHIP;
-					}
-					else
-					{
-						/* Else goes to discard */
-						dest = LOC_DISCARD;
-					}
-
-					/* Move card to discard */
-					move_card(g, !g->turn, pick, dest, 1);
-				}
-
-				/* Done */
-				return;
-			}
-
-			/* Add undisclosed cards to list */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &opp->deck[i];
-
-				/* Skip cards not in hand */
-				if (c->where != LOC_HAND) continue;
-
-				/* Skip disclosed cards */
-				if (c->disclosed) continue;
-
-				/* Add empty card to list */
-				list[num_choices++] = NULL;
-			}
+			/* Get card pointer */
+			c = &opp->deck[i];
 
-			/* Check for too few choices */
-			if (value > num_choices) value = num_choices;
+			/* Skip cards not in hand */
+			if (c->where != LOC_HAND) continue;
 
-			/* Create prompt */
-			printf(prompt, ngettext("Choose card to discard",
-			                         "Choose cards to discard",
-			                         value));
+			/* Skip undisclosed cards */
+			if (!c->disclosed) continue;
 
-			/* Discard */
-			p->control->choose(g, g->turn, !g->turn, list,
-			                   num_choices, 0, value,
-			                   discard_callback, c_ptr->d_ptr,
-			                   prompt);
+			/* Add design to list */
+			list[num_choices++] = c->d_ptr;
 		}
 
-		/* Check for discard of active cards */
-		if (effect & (S4_YOUR_CHAR | S4_YOUR_SUPPORT | S4_YOUR_BOOSTER))
+		/* Check for no disclosed cards or discard from deck */
+		if (!num_choices || (effect & S4_YOUR_DECK))
 		{
-			/* Create type */
-			if (effect & S4_YOUR_CHAR) type |= TYPE_CHARACTER;
-			if (effect & S4_YOUR_BOOSTER) type |= TYPE_BOOSTER;
-			if (effect & S4_YOUR_SUPPORT) type |= TYPE_SUPPORT;
-
-			/* Loop over opponent cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &opp->deck[i];
+			/* Assume hand */
+			src = LOC_HAND;
 
-				/* Skip inactive cards */
-				if (!c->active) continue;
-
-				/* Skip non-characters */
-				if (c->type != TYPE_CHARACTER) continue;
-
-				/* Count characters */
-				num_char++;
-			}
-
-			/* Check for forbidden to discard last character */
-			if ((effect & S4_NOT_LAST_CHAR) && num_char == 1)
-			{
-				/* Remove character from type mask */
-				type &= ~TYPE_CHARACTER;
-			}
+			/* Check for discard from deck */
+			if (effect & S4_YOUR_DECK) src = LOC_DRAW;
 
-			/* Loop over opponent cards */
-			for (i = 1; i < DECK_SIZE; i++)
+			/* Move cards */
+			for (i = 0; i < value; i++)
 			{
-				/* Get card pointer */
-				c = &opp->deck[i];
-
-				/* Skip cards not in play */
-				if (c->where != LOC_COMBAT &&
-				    c->where != LOC_SUPPORT) continue;
-
-				/* Check for active requirement */
-				if ((effect & S4_ACTIVE) &&
-				    !c->active) continue;
-
-				/* Skip cards of wrong type */
-				if (!(c->type & type)) continue;
-
-				/* Skip active cards with PROTECTED */
-				if (c->active &&
-				    (c->icons & ICON_PROTECTED)) continue;
-
-				/* Check for "with icon" restriction */
-				if (effect & S4_WITH_ICON)
-				{
-					/* Check for no icons depicted */
-					if (!c->d_ptr->icons) continue;
-				}
+				/* Pick card at random */
+				pick = random_card(g, !g->turn, src);
 
-				/* XXX Check for opponent "you may not" */
-				if (c->d_ptr->special_cat == 3 &&
-				    (c->d_ptr->special_effect & S3_YOU_MAY_NOT))
-				{
-					/* XXX May allow different card play */
-					p->last_played = 0;
-				}
+				/* Check for none left */
+				if (!pick) break;
 
-				/* Check for bluff card */
-				if (c->bluff)
+				/* Check for leadership */
+				if (pick->type == TYPE_LEADERSHIP)
 				{
-					/* Count bluff cards to add to list */
-					num_bluff++;
+					/* Go to leadership pile */
+					dest = LOC_LEADERSHIP;
 				}
 				else
 				{
-					/* Add design to list */
-					list[num_choices++] = c->d_ptr;
+					/* Else goes to discard */
+					dest = LOC_DISCARD;
 				}
-			}
-
-			/* Add bluff cards to end of list */
-			for (i = 0; i < num_bluff; i++)
-			{
-				/* Add empty card to list */
-				list[num_choices++] = NULL;
-			}
 
-			/* Restrict maximum value to choices */
-			if (value > num_choices) value = num_choices;
-
-			/* Check for no discards allowed */
-			if (!value || !num_choices) return;
-
-			/* Assume no minimum */
-			min = 0;
-
-			/* Check for "ALL" flag (without "EITHER" flag) */
-			if (effect & S4_ALL &&
-			    !(effect & S4_EITHER))
-			{
-				/* Must discard all possible cards */
-				min = value;
-
-				/* Check for not last character */
-				if (effect & S4_NOT_LAST_CHAR) min--;
+				/* Move card to discard */
+				move_card(g, !g->turn, pick, dest, 1);
 			}
 
-			/* Disallow using "on my turn" text without choosing */
-			if (time == TIME_MYTURN) min = 1;
-
-			/* Create prompt */
-			printf(prompt, ngettext("Choose card to discard",
-			                         "Choose cards to discard",
-			                         value));
-
-			/* Discard */
-			p->control->choose(g, g->turn, !g->turn, list,
-			                   num_choices, min, value,
-			                   discard_callback, c_ptr->d_ptr,
-			                   prompt);
+			/* Done */
+			return;
 		}
 
-		/* Check for discarding from our hand */
-		if (effect & S4_MY_HAND)
+		/* Add undisclosed cards to list */
+		for (i = 1; i < DECK_SIZE; i++)
 		{
-			/* Loop over cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
+			/* Get card pointer */
+			c = &opp->deck[i];
 
-				/* Skip cards not in hand */
-				if (c->where != LOC_HAND) continue;
+			/* Skip cards not in hand */
+			if (c->where != LOC_HAND) continue;
 
-				/* Add design to list */
-				list[num_choices++] = c->d_ptr;
-			}
+			/* Skip disclosed cards */
+			if (c->disclosed) continue;
 
-			/* Check for no choices */
-			if (!num_choices) return;
+			/* Add empty card to list */
+			list[num_choices++] = NULL;
+		}
 
-			/* Create prompt */
-			printf(prompt, ngettext("Choose card to discard",
-			                         "Choose cards to discard",
-						 value));
+		/* Check for too few choices */
+		if (value > num_choices) value = num_choices;
 
-			/* Discard */
-			p->control->choose(g, g->turn, g->turn, list,
-			                   num_choices, 0, value,
-			                   discard_callback, c_ptr->d_ptr,
-			                   prompt);
-		}
+		/* Create prompt */
+		sprintf(prompt, ngettext("Choose card to discard",
+		                          "Choose cards to discard",
+		                          value));
 
-		/* Done */
-		return;
+		/* Discard */
+		p->control->choose(g, g->turn, !g->turn, list,
+		                   num_choices, 0, value,
+		                   discard_callback, d_ptr,
+		                   prompt);
 	}
 
-	/* Check for drawing cards */
-	if (effect & S4_DRAW)
+	/* Check for discard of active cards */
+	if (d_ptr->effect_types)
 	{
-		/* XXX May allow different card play */
-		p->last_played = 0;
+		/* Get compiled type mask */
+		type = d_ptr->effect_types;
 
-		/* Check for "draw to" */
-		if (effect & S4_TO)
+		/* Loop over opponent cards */
+		for (i = 1; i < DECK_SIZE; i++)
 		{
-			/* Reset value to number of cards to draw */
-			value = value - p->stack[LOC_HAND];
+			/* Get card pointer */
+			c = &opp->deck[i];
+
+			/* Skip inactive cards */
+			if (!c->active) continue;
 
-			/* Do nothing if too many cards */
-			if (value < 0) value = 0;
+			/* Skip non-characters */
+			if (c->type != TYPE_CHARACTER) continue;
+
+			/* Count characters */
+			num_char++;
 		}
 
-		/* Check for drawing from discard pile */
-		if (effect & S4_MY_DISCARD)
+		/* Check for forbidden to discard last character */
+		if ((effect & S4_NOT_LAST_CHAR) && num_char == 1)
 		{
-			/* Loop over cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
+			/* Remove character from type mask */
+			type &= ~TYPE_CHARACTER;
+		}
 
-				/* Skip cards not in discard */
-				if (c->where != LOC_DISCARD) continue;
+		/* Loop over opponent cards */
+		for (i = 1; i < DECK_SIZE; i++)
+		{
+			/* Get card pointer */
+			c = &opp->deck[i];
 
-				/* Clear location known flag */
-				if (!(effect & S4_REVEAL)) c->loc_known = 0;
-			}
-		}
+			/* Skip cards not in play */
+			if (c->where != LOC_COMBAT &&
+			    c->where != LOC_SUPPORT) continue;
 
-		/* Restrict amount to draw due to hand limit */
-		max = hand_limit(g, g->turn) - p->stack[LOC_HAND];
+			/* Check for active requirement */
+			if ((effect & S4_ACTIVE) &&
+			    !c->active) continue;
 
-		/* Check for hand limit restriction */
-		if (value > max) value = max;
+			/* Skip cards of wrong type */
+			if (!(c->type & type)) continue;
 
-		/* Draw cards */
-		for (i = 0; i < value; i++)
-		{
-			/* Check for not drawing from draw pile */
-			if (effect & S4_MY_DISCARD)
+			/* Skip active cards with PROTECTED */
+			if (c->active &&
+			    (c->icons & ICON_PROTECTED)) continue;
+
+			/* Check for "with icon" restriction */
+			if (effect & S4_WITH_ICON)
 			{
-				/* Choose card from discard pile */
-				pick = random_card(g, g->turn, LOC_DISCARD);
+				/* Check for no icons depicted */
+				if (!c->d_ptr->icons) continue;
 			}
-			else
+
+			/* XXX Check for opponent "you may not" */
+			if (c->d_ptr->special_cat == 3 &&
+			    (c->d_ptr->special_effect & S3_YOU_MAY_NOT))
 			{
-				/* Choose card from draw pile */
-				pick = random_draw(g, g->turn);
+				/* XXX May allow different card play */
+				p->last_played = 0;
 			}
 
-			/* Check for no drawing allowed */
-			if (!pick) continue;
-
-			/* Move card to hand */
-			move_card(g, g->turn, pick, LOC_HAND,
-			          effect & S4_REVEAL);
+			/* Check for bluff card */
+			if (c->bluff)
+			{
+				/* Count bluff cards to add to list */
+				num_bluff++;
+			}
+			else
+			{
+				/* Add design to list */
+				list[num_choices++] = c->d_ptr;
+			}
+		}
 
-			/* Add card to list */
-			list[num_choices++] = pick;
+		/* Add bluff cards to end of list */
+		for (i = 0; i < num_bluff; i++)
+		{
+			/* Add empty card to list */
+			list[num_choices++] = NULL;
 		}
 
-		/* Handle category 1 effects */
-		notice_effect_1(g);
+		/* Restrict maximum value to choices */
+		if (value > num_choices) value = num_choices;
 
-		/* Check for discard one of cards just drawn */
-		if (num_choices >= 1 && (effect & S4_DISCARD_ONE))
-		{
-			/* Create prompt */
-			printf(prompt, _("Choose drawn card to discard"));
+		/* Check for no discards allowed */
+		if (!value || !num_choices) return;
 
-			/* Prompt for card to discard */
-			p->control->choose(g, g->turn, g->turn, list,
-			                   num_choices, 1, 1,
-			                   discard_callback, c_ptr->d_ptr,
-			                   prompt);
-		}
+		/* Assume no minimum */
+		min = 0;
 
-		/* Check for "UNDRAW_2" */
-		if (effect & S4_UNDRAW_2)
+		/* Check for "ALL" flag (without "EITHER" flag) */
+		if (effect & S4_ALL &&
+		    !(effect & S4_EITHER))
 		{
-			/* Clear choices */
-			num_choices = 0;
+			/* Must discard all possible cards */
+			min = value;
 
-			/* Loop through cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
+			/* Check for not last character */
+			if (effect & S4_NOT_LAST_CHAR) min--;
+		}
 
-				/* Skip cards not in hand */
-				if (c->where != LOC_HAND) continue;
+		/* Disallow using "on my turn" text without choosing */
+		if (time == TIME_MYTURN) min = 1;
 
-				/* Skip cards randomly drawn */
-				if (c->random_fake) continue;
+		/* Create prompt */
+		sprintf(prompt, ngettext("Choose card to discard",
+		                          "Choose cards to discard",
+		                          value));
 
-				/* Put card design in choice list */
-				list[num_choices++] = c->d_ptr;
-			}
+		/* Discard */
+		p->control->choose(g, g->turn, !g->turn, list,
+		                   num_choices, min, value,
+		                   discard_callback, d_ptr,
+		                   prompt);
+	}
 
-			/* Try to undraw 2 cards */
-			min = 2;
+	/* Check for discarding from our hand */
+	if (effect & S4_MY_HAND)
+	{
+		/* Loop over cards */
+		for (i = 1; i < DECK_SIZE; i++)
+		{
+			/* Get card pointer */
+			c = &p->deck[i];
 
-			/* Check for not enough */
-			if (num_choices < 2) min = num_choices;
+			/* Skip cards not in hand */
+			if (c->where != LOC_HAND) continue;
 
-			/* Check for no cards to undraw */
-			if (!num_choices) return;
+			/* Add design to list */
+			list[num_choices++] = c->d_ptr;
+		}
 
-			/* Create prompt */
-			printf(prompt,
-			        _("Choose cards to return to draw deck"));
+		/* Check for no choices */
+		if (!num_choices) return;
 
-			/* Choose 2 to "undraw" */
-			p->control->choose(g, g->turn, g->turn, list,
-			                   num_choices, min, 2,
-			                   undraw_callback, c_ptr->d_ptr,
-			                   prompt);
-		}
+		/* Create prompt */
+		sprintf(prompt, ngettext("Choose card to discard",
+		                          "Choose cards to discard",
+					  value));
 
-		/* Done */
-		return;
+		/* Discard */
+		p->control->choose(g, g->turn, g->turn, list,
+		                   num_choices, 0, value,
+		                   discard_callback, d_ptr,
+		                   prompt);
 	}
+}
 
-	/* Check for loading a ship */
-	if (effect & S4_LOAD)
-	{
-		/* Check for searching draw deck */
-		if (effect & S4_SEARCH)
-		{
-			/* Loop over cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
-
-				/* Skip inactive cards */
-				if (!c->active) continue;
+/*
+ * Draw cards from our draw or discard pile.
+ */
+static void s4_draw(game *g, design *d_ptr, int time)
+{
+	player *p;
+	design *pick, *list[DECK_SIZE];
+	card *c;
+	int num_choices = 0;
+	int effect, value;
+	int min, max;
+	char prompt[1024];
+	int i;
 
-				/* Skip non-ships */
-				if (!c->d_ptr->capacity) continue;
+	/* Get player pointer */
+	p = &g->p[g->turn];
 
-				/* Skip full ships */
-				if (ship_full(g, g->turn, c->d_ptr)) continue;
+	/* Get effect code and value */
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
 
-				/* Count ships */
-				ships++;
-			}
+	/* XXX May allow different card play */
+	p->last_played = 0;
 
-			/* Loop over cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
+	/* Check for "draw to" */
+	if (effect & S4_TO)
+	{
+		/* Reset value to number of cards to draw */
+		value = value - p->stack[LOC_HAND];
 
-				/* Skip cards not in draw deck */
-				if (c->where != LOC_DRAW) continue;
+		/* Do nothing if too many cards */
+		if (value < 0) value = 0;
+	}
 
-				/* Add influence cards */
-				if (c->type == TYPE_INFLUENCE)
-				{
-					/* Add to list */
-					list[num_choices++] = c->d_ptr;
-				}
+	/* Check for drawing from discard pile */
+	if (effect & S4_MY_DISCARD)
+	{
+		/* Loop over cards */
+		for (i = 1; i < DECK_SIZE; i++)
+		{
+			/* Get card pointer */
+			c = &p->deck[i];
 
-				/* Add other cards if ships available */
-				else if (ships &&
-				         (c->type == TYPE_CHARACTER ||
-				          c->type == TYPE_BOOSTER ||
-				          c->type == TYPE_SUPPORT))
-				{
-					/* Add to list */
-					list[num_choices++] = c->d_ptr;
-				}
-			}
+			/* Skip cards not in discard */
+			if (c->where != LOC_DISCARD) continue;
 
-			/* Check for no choices */
-			if (!num_choices) return;
+			/* Clear location known flag */
+			if (!(effect & S4_REVEAL)) c->loc_known = 0;
+		}
+	}
 
-			/* Prompt */
-			printf(prompt, _("Choose card to play or load"));
+	/* Restrict amount to draw due to hand limit */
+	max = hand_limit(g, g->turn) - p->stack[LOC_HAND];
 
-			/* Choose cards and load them */
-			p->control->choose(g, g->turn, g->turn, list,
-			                   num_choices, 0, 1, favor_callback,
-					   c_ptr->d_ptr, prompt);
+	/* Check for hand limit restriction */
+	if (value > max) value = max;
 
-			/* Done */
-			return;
+	/* Draw cards */
+	for (i = 0; i < value; i++)
+	{
+		/* Check for not drawing from draw pile */
+		if (effect & S4_MY_DISCARD)
+		{
+			/* Choose card from discard pile */
+			pick = random_card(g, g->turn, LOC_DISCARD);
+		}
+		else
+		{
+			/* Choose card from draw pile */
+			pick = random_draw(g, g->turn);
 		}
 
-		/* Determine pile to choose from */
-		src = LOC_HAND;
+		/* Check for no drawing allowed */
+		if (!pick) continue;
 
-		/* Loop over cards */
+		/* Move card to hand */
+		move_card(g, g->turn, pick, LOC_HAND,
+		          effect & S4_REVEAL);
+
+		/* Add card to list */
+		list[num_choices++] = pick;
+	}
+
+	/* Handle category 1 effects */
+	notice_effect_1(g);
+
+	/* Check for discard one of cards just drawn */
+	if (num_choices >= 1 && (effect & S4_DISCARD_ONE))
+	{
+		/* Create prompt */
+		sprintf(prompt, _("Choose drawn card to discard"));
+
+		/* Prompt for card to discard */
+		p->control->choose(g, g->turn, g->turn, list,
+		                   num_choices, 1, 1,
+		                   discard_callback, d_ptr,
+		                   prompt);
+	}
+
+	/* Check for "UNDRAW_2" */
+	if (effect & S4_UNDRAW_2)
+	{
+		/* Clear choices */
+		num_choices = 0;
+
+		/* Loop through cards */
 		for (i = 1; i < DECK_SIZE; i++)
 		{
 			/* Get card pointer */
 			c = &p->deck[i];
 
-			/* Skip cards in incorrect location */
-			if (c->where != src) continue;
+			/* Skip cards not in hand */
+			if (c->where != LOC_HAND) continue;
 
-			/* Skip cards that aren't loadable */
-			if (c->type != TYPE_CHARACTER &&
-			    c->type != TYPE_BOOSTER &&
-			    c->type != TYPE_SUPPORT) continue;
+			/* Skip cards randomly drawn */
+			if (c->random_fake) continue;
 
-			/* Add card to list */
+			/* Put card design in choice list */
 			list[num_choices++] = c->d_ptr;
 		}
 
-		/* Check for no choices */
+		/* Try to undraw 2 cards */
+		min = 2;
+
+		/* Check for not enough */
+		if (num_choices < 2) min = num_choices;
+
+		/* Check for no cards to undraw */
 		if (!num_choices) return;
 
 		/* Create prompt */
-		sprintf(prompt, _("Choose cards to load onto %s"),
-		                _(c_ptr->d_ptr->name));
-
-		/* Choose cards and load them */
-		p->control->choose(g, g->turn, g->turn, list, num_choices,
-		                   0, value, load_callback,
-				   c_ptr->d_ptr, prompt);
+		sprintf(prompt,
+		         _("Choose cards to return to draw deck"));
 
-		/* Done */
-		return;
+		/* Choose 2 to "undraw" */
+		p->control->choose(g, g->turn, g->turn, list,
+		                   num_choices, min, 2,
+		                   undraw_callback, d_ptr,
+		                   prompt);
 	}
+}
 
-	/* Check for search through a stack */
+/*
+ * Load cards onto a ship.
+ */
+static void s4_load(game *g, design *d_ptr, int time)
+{
+	player *p;
+	design *list[DECK_SIZE];
+	card *c;
+	int num_choices = 0;
+	int effect, value;
+	int ships = 0, src;
+	char prompt[1024];
+	int i;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Get effect code and value */
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
+
+	/* Check for searching draw deck */
 	if (effect & S4_SEARCH)
 	{
-		/* XXX May allow different card play */
-		p->last_played = 0;
+		/* Loop over cards */
+		for (i = 1; i < DECK_SIZE; i++)
+		{
+			/* Get card pointer */
+			c = &p->deck[i];
+
+			/* Skip inactive cards */
+			if (!c->active) continue;
+
+			/* Skip non-ships */
+			if (!c->d_ptr->capacity) continue;
 
-		/* Determine pile to search */
-		src = LOC_DRAW;
+			/* Skip full ships */
+			if (ship_full(g, g->turn, c->d_ptr)) continue;
 
-		/* Check for searching discard pile */
-		if (effect & S4_MY_DISCARD) src = LOC_DISCARD;
+			/* Count ships */
+			ships++;
+		}
 
 		/* Loop over cards */
 		for (i = 1; i < DECK_SIZE; i++)
@@ -3459,173 +4070,394 @@ static void handle_effect_4(game *g, card *c_ptr, int time)
 			/* Get card pointer */
 			c = &p->deck[i];
 
-			/* Skip cards in incorrect location */
-			if (c->where != src) continue;
+			/* Skip cards not in draw deck */
+			if (c->where != LOC_DRAW) continue;
 
-			/* Add card to list */
-			list[num_choices++] = c->d_ptr;
+			/* Add influence cards */
+			if (c->type == TYPE_INFLUENCE)
+			{
+				/* Add to list */
+				list[num_choices++] = c->d_ptr;
+			}
 
-			/* Lack of reveal flag will make locations unclear */
-			if (!(effect & S4_REVEAL)) c->loc_known = 0;
+			/* Add other cards if ships available */
+			else if (ships &&
+			         (c->type == TYPE_CHARACTER ||
+			          c->type == TYPE_BOOSTER ||
+			          c->type == TYPE_SUPPORT))
+			{
+				/* Add to list */
+				list[num_choices++] = c->d_ptr;
+			}
 		}
 
 		/* Check for no choices */
 		if (!num_choices) return;
 
-		/* Restrict amount to draw due to hand limit */
-		max = hand_limit(g, g->turn) - p->stack[LOC_HAND];
-
-		/* Check for hand limit restriction */
-		if (value > max) value = max;
-
-		/* Check for no cards available */
-		if (value <= 0) return;
-		
-		/* Create prompt */
-		printf(prompt, _("Choose cards to draw"));
+		/* Prompt */
+		sprintf(prompt, _("Choose card to play or load"));
 
-		/* Choose cards and put them in hand */
-		p->control->choose(g, g->turn, g->turn, list, num_choices,
-		                   value, value, draw_callback,
-				   c_ptr->d_ptr, prompt);
+		/* Choose cards and load them */
+		p->control->choose(g, g->turn, g->turn, list,
+		                   num_choices, 0, 1, favor_callback,
+				   d_ptr, prompt);
 
 		/* Done */
 		return;
 	}
 
-	/* Check for retrieving card */
-	if (effect & S4_RETRIEVE)
+	/* Determine pile to choose from */
+	src = LOC_HAND;
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
 	{
-		/* XXX May allow different card play */
-		p->last_played = 0;
+		/* Get card pointer */
+		c = &p->deck[i];
 
-		/* Create type */
-		if (effect & S4_MY_CHAR) type |= TYPE_CHARACTER;
-		if (effect & S4_MY_BOOSTER) type |= TYPE_BOOSTER;
-		if (effect & S4_MY_SUPPORT) type |= TYPE_SUPPORT;
+		/* Skip cards in incorrect location */
+		if (c->where != src) continue;
 
-		/* Loop over our cards */
+		/* Skip cards that aren't loadable */
+		if (c->type != TYPE_CHARACTER &&
+		    c->type != TYPE_BOOSTER &&
+		    c->type != TYPE_SUPPORT) continue;
+
+		/* Add card to list */
+		list[num_choices++] = c->d_ptr;
+	}
+
+	/* Check for no choices */
+	if (!num_choices) return;
+
+	/* Create prompt */
+	sprintf(prompt, _("Choose cards to load onto %s"),
+	                _(d_ptr->name));
+
+	/* Choose cards and load them */
+	p->control->choose(g, g->turn, g->turn, list, num_choices,
+	                   0, value, load_callback,
+			   d_ptr, prompt);
+}
+
+/*
+ * Search our draw or discard pile for cards to draw.
+ */
+static void s4_search(game *g, design *d_ptr, int time)
+{
+	player *p;
+	design *list[DECK_SIZE];
+	card *c;
+	int num_choices = 0;
+	int effect, value;
+	int src, max;
+	char prompt[1024];
+	int i;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Get effect code and value */
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
+
+	/* XXX May allow different card play */
+	p->last_played = 0;
+
+	/* Determine pile to search */
+	src = LOC_DRAW;
+
+	/* Check for searching discard pile */
+	if (effect & S4_MY_DISCARD) src = LOC_DISCARD;
+
+	/* Loop over cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Skip cards in incorrect location */
+		if (c->where != src) continue;
+
+		/* Add card to list */
+		list[num_choices++] = c->d_ptr;
+
+		/* Lack of reveal flag will make locations unclear */
+		if (!(effect & S4_REVEAL)) c->loc_known = 0;
+	}
+
+	/* Check for no choices */
+	if (!num_choices) return;
+
+	/* Restrict amount to draw due to hand limit */
+	max = hand_limit(g, g->turn) - p->stack[LOC_HAND];
+
+	/* Check for hand limit restriction */
+	if (value > max) value = max;
+
+	/* Check for no cards available */
+	if (value <= 0) return;
+	
+	/* Create prompt */
+	sprintf(prompt, _("Choose cards to draw"));
+
+	/* Choose cards and put them in hand */
+	p->control->choose(g, g->turn, g->turn, list, num_choices,
+	                   value, value, draw_callback,
+			   d_ptr, prompt);
+}
+
+/*
+ * Retrieve played cards to our hand.
+ */
+static void s4_retrieve(game *g, design *d_ptr, int time)
+{
+	player *p;
+	design *list[DECK_SIZE];
+	card *c;
+	int num_choices = 0;
+	int effect, value;
+	int max;
+	char prompt[1024];
+	int i;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Get effect code and value */
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
+
+	/* XXX May allow different card play */
+	p->last_played = 0;
+
+	/* Loop over our cards */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &p->deck[i];
+
+		/* Skip cards of wrong type */
+		if (!(c->type & d_ptr->effect_types)) continue;
+
+		/* Skip cards not played */
+		if (c->where != LOC_COMBAT &&
+		    c->where != LOC_SUPPORT) continue;
+
+		/* Check for active qualification */
+		if ((effect & S4_ACTIVE) && !c->active) continue;
+
+		/* Never allow retrieving of card just played */
+		if (c->d_ptr == d_ptr) continue;
+
+		/* Add design to list */
+		list[num_choices++] = c->d_ptr;
+	}
+
+	/* Restrict amount to draw due to hand limit */
+	max = hand_limit(g, g->turn) - p->stack[LOC_HAND];
+
+	/* Check for hand limit restriction */
+	if (value > max) value = max;
+
+	/* Check for no cards available */
+	if (value <= 0 || !num_choices) return;
+	
+	/* Create prompt */
+	sprintf(prompt, ngettext("Choose card to retrieve",
+	                          "Choose cards to retrieve", value));
+
+	/* Discard */
+	p->control->choose(g, g->turn, g->turn, list, num_choices,
+	                   0, value, retrieve_callback, NULL, prompt);
+}
+
+/*
+ * Return cards from our hand or discard pile to our draw pile.
+ */
+static void s4_shuffle(game *g, design *d_ptr, int time)
+{
+	player *p;
+	design *list[DECK_SIZE];
+	card *c;
+	int num_choices = 0;
+	int effect, value;
+	char prompt[1024];
+	int i;
+
+	/* Get player pointer */
+	p = &g->p[g->turn];
+
+	/* Get effect code and value */
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
+
+	/* Check for putting cards from hand into draw pile */
+	if (effect & S4_MY_HAND)
+	{
+		/* Loop over cards */
 		for (i = 1; i < DECK_SIZE; i++)
 		{
 			/* Get card pointer */
 			c = &p->deck[i];
 
-			/* Skip cards of wrong type */
-			if (!(c->type & type)) continue;
-
-			/* Skip cards not played */
-			if (c->where != LOC_COMBAT &&
-			    c->where != LOC_SUPPORT) continue;
-
-			/* Check for active qualification */
-			if ((effect & S4_ACTIVE) && !c->active) continue;
-
-			/* Never allow retrieving of card just played */
-			if (c->d_ptr == c_ptr->d_ptr) continue;
+			/* Skip cards not in hand */
+			if (c->where != LOC_HAND) continue;
 
-			/* Add design to list */
+			/* Add card design to list */
 			list[num_choices++] = c->d_ptr;
 		}
 
-		/* Restrict amount to draw due to hand limit */
-		max = hand_limit(g, g->turn) - p->stack[LOC_HAND];
-
-		/* Check for hand limit restriction */
-		if (value > max) value = max;
+		/* Check for no choices */
+		if (!num_choices) return;
 
-		/* Check for no cards available */
-		if (value <= 0 || !num_choices) return;
-		
 		/* Create prompt */
-		printf(prompt, ngettext("Choose card to retrieve",
-		                         "Choose cards to retrieve", value));
+		sprintf(prompt,
+		         _("Choose cards to return to draw pile"));
 
-		/* Discard */
-		p->control->choose(g, g->turn, g->turn, list, num_choices,
-		                   0, value, retrieve_callback, NULL, prompt);
-
-		/* Done */
-		return;
+		/* Ask user to choose cards to place in draw pile */
+		p->control->choose(g, g->turn, g->turn, list,
+		                   num_choices, 0, value,
+		                   undraw_callback, d_ptr,
+		                   prompt);
 	}
 
-	/* Check for shuffle effect */
-	if (effect & S4_SHUFFLE)
+	/* Check for shuffling discard pile into draw pile */
+	if (effect & S4_MY_DISCARD)
 	{
-		/* Check for putting cards from hand into draw pile */
-		if (effect & S4_MY_HAND)
+		/* Loop over cards */
+		for (i = 1; i < DECK_SIZE; i++)
 		{
-			/* Loop over cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
+			/* Get card pointer */
+			c = &p->deck[i];
 
-				/* Skip cards not in hand */
-				if (c->where != LOC_HAND) continue;
+			/* Skip cards not in discard */
+			if (c->where != LOC_DISCARD) continue;
 
-				/* Add card design to list */
-				list[num_choices++] = c->d_ptr;
-			}
+			/* Reduce discard stack size */
+			p->stack[LOC_DISCARD]--;
 
-			/* Check for no choices */
-			if (!num_choices) return;
+			/* Put card in draw pile */
+			c->where = LOC_DRAW;
 
-			/* Create prompt */
-			printf(prompt,
-			        _("Choose cards to return to draw pile"));
+			/* Increase draw stack size */
+			p->stack[LOC_DRAW]++;
 
-			/* Ask user to choose cards to place in draw pile */
-			p->control->choose(g, g->turn, g->turn, list,
-			                   num_choices, 0, value,
-			                   undraw_callback, c_ptr->d_ptr,
-			                   prompt);
+			/* Clear "location known" flag */
+			c->loc_known = 0;
 		}
 
-		/* Check for shuffling discard pile into draw pile */
-		if (effect & S4_MY_DISCARD)
-		{
-			/* Loop over cards */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &p->deck[i];
+		/* Clear last discard pointer */
+		p->last_discard = NULL;
+	}
+
+	/* Handle category 1 effects */
+	notice_effect_1(g);
+}
+
+/*
+ * Let our cards attack again.
+ */
+static void s4_attack_again(game *g, design *d_ptr, int time)
+{
+	player *p;
 
-				/* Skip cards not in discard */
-				if (c->where != LOC_DISCARD) continue;
+	/* Get player pointer */
+	p = &g->p[g->turn];
 
-				/* Reduce discard stack size */
-				p->stack[LOC_DISCARD]--;
+	/* No need to do anything but mark character as played */
+	p->char_played = 1;
+}
 
-				/* Put card in draw pile */
-				c->where = LOC_DRAW;
+/*
+ * Compile a design's category 4 effect into a handler and the parameters
+ * it needs.
+ */
+static void compile_effect_4(design *d_ptr)
+{
+	int effect, types = 0;
 
-				/* Increase draw stack size */
-				p->stack[LOC_DRAW]++;
+	/* Get effect code */
+	effect = d_ptr->special_effect;
 
-				/* Clear "location known" flag */
-				c->loc_known = 0;
-			}
+	/* Check for discard effect */
+	if (effect & S4_DISCARD)
+	{
+		/* Get types of opponent cards discarded from play */
+		if (effect & S4_YOUR_CHAR) types |= TYPE_CHARACTER;
+		if (effect & S4_YOUR_BOOSTER) types |= TYPE_BOOSTER;
+		if (effect & S4_YOUR_SUPPORT) types |= TYPE_SUPPORT;
 
-			/* Clear last discard pointer */
-			p->last_discard = NULL;
-		}
+		/* Set handler */
+		d_ptr->effect_4 = s4_discard;
+	}
 
-		/* Handle category 1 effects */
-		notice_effect_1(g);
+	/* Check for drawing cards */
+	else if (effect & S4_DRAW)
+	{
+		/* Set handler */
+		d_ptr->effect_4 = s4_draw;
+	}
 
-		/* Done */
-		return;
+	/* Check for loading a ship */
+	else if (effect & S4_LOAD)
+	{
+		/* Set handler */
+		d_ptr->effect_4 = s4_load;
 	}
 
-	/* Check for "my cards attack again" */
-	if (effect & S4_ATTACK_AGAIN)
+	/* Check for search through a stack */
+	else if (effect & S4_SEARCH)
 	{
-		/* No need to do anything but mark character as played */
-		p->char_played = 1;
+		/* Set handler */
+		d_ptr->effect_4 = s4_search;
+	}
 
-		/* Done */
-		return;
+	/* Check for retrieving card */
+	else if (effect & S4_RETRIEVE)
+	{
+		/* Get types of our cards retrieved */
+		if (effect & S4_MY_CHAR) types |= TYPE_CHARACTER;
+		if (effect & S4_MY_BOOSTER) types |= TYPE_BOOSTER;
+		if (effect & S4_MY_SUPPORT) types |= TYPE_SUPPORT;
+
+		/* Set handler */
+		d_ptr->effect_4 = s4_retrieve;
+	}
+
+	/* Check for shuffle effect */
+	else if (effect & S4_SHUFFLE)
+	{
+		/* Set handler */
+		d_ptr->effect_4 = s4_shuffle;
+	}
+
+	/* Check for "my cards attack again" */
+	else if (effect & S4_ATTACK_AGAIN)
+	{
+		/* Set handler */
+		d_ptr->effect_4 = s4_attack_again;
 	}
+
+	/* Store card types affected */
+	d_ptr->effect_types = types;
+}
+
+/*
+ * Handle a "category 4" special effect.
+ *
+ * These involve moving cards from one pile to another.
+ */
+static void handle_effect_4(game *g, card *c_ptr, int time)
+{
+	/* Check for correct timing */
+	if (time != c_ptr->d_ptr->special_time) return;
+
+	/* Check for no effect */
+	if (!c_ptr->d_ptr->effect_4) return;
+
+	/* Apply effect */
+	c_ptr->d_ptr->effect_4(g, c_ptr->d_ptr, time);
 }
 
 /*
@@ -3635,15 +4467,10 @@ static int sacrifice_callback(game *g, int who, design **list, int num,
                               void *data)
 {
 	design *d_ptr = (design *)data;
-	player *p;
 	card *c;
 	int i;
 	int effect, value;
 	int amt = 0;
-	char msg[1024];
-
-	/* Get player pointer */
-	p = &g->p[who];
 
 	/* Get special effect code and value */
 	effect = d_ptr->special_effect;
@@ -3711,16 +4538,8 @@ static int sacrifice_callback(game *g, int who, design **list, int num,
 		move_card(g, who, list[i], LOC_DISCARD, 1);
 	}
 
-	/* Check for simulation */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s attracts dragon using %s.\n"),
-		             _(p->p_ptr->name), _(d_ptr->name));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_DRAGON_USING, who, d_ptr, NULL, 0, 0);
 
 	/* Attract a dragon */
 	attract_dragon(g, who);
@@ -3793,8 +4612,8 @@ static void handle_effect_6(game *g, design *d_ptr)
 		if (!num_choices) return;
 
 		/* Create prompt */
-		printf(prompt,
-		        _("Choose cards to sacrifice to attract dragon"));
+		sprintf(prompt,
+		         _("Choose cards to sacrifice to attract dragon"));
 
 		/* Discard */
 		p->control->choose(g, g->turn, g->turn, list, num_choices,
@@ -3803,113 +4622,99 @@ static void handle_effect_6(game *g, design *d_ptr)
 }
 
 /*
- * Handle a "category 8" effect.
+ * Force the opponent to discard cards from their hand.
  */
-static void handle_effect_8(game *g, card *c_ptr, int time)
+static void s8_discard(game *g, design *d_ptr, int time)
 {
-	player *p, *opp;
-	design *list[DECK_SIZE], *d_ptr;
+	player *opp;
+	design *list[DECK_SIZE], *pick;
 	card *c;
 	char prompt[1024];
 	int i, min, num_choices = 0;
 	int effect, value;
 
-	/* Check for correct timing */
-	if (time != c_ptr->d_ptr->special_time) return;
-
-	/* Get player pointer */
-	p = &g->p[g->turn];
-
 	/* Get opponent pointer */
 	opp = &g->p[!g->turn];
 
 	/* Get special effect code and value */
-	effect = c_ptr->d_ptr->special_effect;
-	value = c_ptr->d_ptr->special_value;
+	effect = d_ptr->special_effect;
+	value = d_ptr->special_value;
 
-	/* Check for forced discard */
-	if (effect & S8_YOU_DISCARD)
+	/* Loop over deck */
+	for (i = 1; i < DECK_SIZE; i++)
 	{
-		/* Loop over deck */
-		for (i = 1; i < DECK_SIZE; i++)
-		{
-			/* Get card pointer */
-			c = &opp->deck[i];
+		/* Get card pointer */
+		c = &opp->deck[i];
 
-			/* Skip cards not in hand */
-			if (c->where != LOC_HAND) continue;
+		/* Skip cards not in hand */
+		if (c->where != LOC_HAND) continue;
 
-			/* Put card in list */
-			list[num_choices++] = c->d_ptr;
-		}
+		/* Put card in list */
+		list[num_choices++] = c->d_ptr;
+	}
 
-		/* Check for "discard to" flag */
-		if (effect & S8_TO)
-		{
-			/* Cards to discard */
-			min = num_choices - value;
-		}
-		else
-		{
-			/* Cards to discard */
-			min = value;
-		}
+	/* Check for "discard to" flag */
+	if (effect & S8_TO)
+	{
+		/* Cards to discard */
+		min = num_choices - value;
+	}
+	else
+	{
+		/* Cards to discard */
+		min = value;
+	}
 
-		/* Check for too few */
-		if (min > num_choices) min = num_choices;
+	/* Check for too few */
+	if (min > num_choices) min = num_choices;
 
-		/* Check for no choices */
-		if (min <= 0) return;
+	/* Check for no choices */
+	if (min <= 0) return;
 
-		/* Discard random cards in simulated games */
-		if (g->simulation)
+	/* Discard random cards in simulated games */
+	if (g->simulation)
+	{
+		/* Loop over number to discard */
+		for (i = 0; i < min; i++)
 		{
-			/* Loop over number to discard */
-			for (i = 0; i < min; i++)
-			{
-				/* Pick a random card from hand */
-				d_ptr = random_card(g, !g->turn, LOC_HAND);
-
-				/* Discard it */
-				move_card(g, !g->turn, d_ptr, LOC_DISCARD, 0);
-			}
+			/* Pick a random card from hand */
+			pick = random_card(g, !g->turn, LOC_HAND);
 
-			/* Done */
-			return;
+			/* Discard it */
+			move_card(g, !g->turn, pick, LOC_DISCARD, 0);
 		}
 
-		/* Create prompt */
-		printf(prompt, _("Choose cards to discard"));
-
-		/* Force opponent to discard */
-		opp->control->choose(g, !g->turn, !g->turn, list, num_choices,
-		                     min, min, discard_callback, c_ptr->d_ptr,
-		                     prompt);
+		/* Done */
+		return;
 	}
 
-	/* Check for disclose */
-	if (effect & S8_YOU_DISCLOSE)
-	{
-		/* Handle simulated game differently */
-		if (g->simulation)
-		{
-			/* Loop over deck */
-			for (i = 1; i < DECK_SIZE; i++)
-			{
-				/* Get card pointer */
-				c = &opp->deck[i];
+	/* Create prompt */
+	sprintf(prompt, _("Choose cards to discard"));
+
+	/* Force opponent to discard */
+	opp->control->choose(g, !g->turn, !g->turn, list, num_choices,
+	                     min, min, discard_callback, d_ptr,
+	                     prompt);
+}
 
-				/* Skip cards not in hand */
-				if (c->where != LOC_HAND) continue;
+/*
+ * Force the opponent to disclose their hand.
+ */
+static void s8_disclose(game *g, design *d_ptr, int time)
+{
+	player *p, *opp;
+	card *c;
+	int i;
 
-				/* Disclose card */
-				c->disclosed = 1;
-			}
+	/* Get player pointer */
+	p = &g->p[g->turn];
 
-			/* Done */
-			return;
-		}
+	/* Get opponent pointer */
+	opp = &g->p[!g->turn];
 
+	/* Handle simulated game differently */
+	if (g->simulation)
+	{
 		/* Loop over deck */
 		for (i = 1; i < DECK_SIZE; i++)
 		{
@@ -3921,17 +4726,71 @@ static void handle_effect_8(game *g, card *c_ptr, int time)
 
 			/* Disclose card */
 			c->disclosed = 1;
-
-			/* Location is known */
-			c->loc_known = 1;
 		}
 
-		/* Have AI reevaluate options */
-		g->random_event = 1;
+		/* Done */
+		return;
+	}
+
+	/* Loop over deck */
+	for (i = 1; i < DECK_SIZE; i++)
+	{
+		/* Get card pointer */
+		c = &opp->deck[i];
+
+		/* Skip cards not in hand */
+		if (c->where != LOC_HAND) continue;
+
+		/* Disclose card */
+		c->disclosed = 1;
 
-		/* Recheck all plays */
-		p->last_played = 0;
+		/* Location is known */
+		c->loc_known = 1;
 	}
+
+	/* Update beliefs */
+	update_belief(g, !g->turn);
+
+	/* Have AI reevaluate options */
+	g->random_event = 1;
+
+	/* Recheck all plays */
+	p->last_played = 0;
+}
+
+/*
+ * Compile a design's category 8 effect into a handler.
+ */
+static void compile_effect_8(design *d_ptr)
+{
+	/* Check for forced discard */
+	if (d_ptr->special_effect & S8_YOU_DISCARD)
+	{
+		/* Set handler */
+		d_ptr->effect_8 = s8_discard;
+	}
+
+	/* Check for disclose */
+	else if (d_ptr->special_effect & S8_YOU_DISCLOSE)
+	{
+		/* Set handler */
+		d_ptr->effect_8 = s8_disclose;
+	}
+}
+
+/*
+ * Handle a "category 8" effect.
+ */
+static void handle_effect_8(game *g, card *c_ptr, int time)
+{
+	/* Check for correct timing */
+	if (time != c_ptr->d_ptr->special_time) return;
+
+	/* Check for no effect */
+	if (!c_ptr->d_ptr->effect_8) return;
+
+	/* Apply effect */
+	c_ptr->d_ptr->effect_8(g, c_ptr->d_ptr, time);
 }
 
 /*
@@ -3987,22 +4846,12 @@ static int check_support_limit(game *g, design *d_ptr)
  */
 void play_card(game *g, design *d_ptr, int no_effect, int check)
 {
-	char msg[1024];
 	player *p, *opp;
 	card *c, *old;
 	int i, gang_good, from_ship = 0;
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, no_effect ? _("%s plays %s with no effect.\n") :
-		                         _("%s plays %s.\n"),
-		             _(g->p[g->turn].p_ptr->name), _(d_ptr->name));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_PLAY, g->turn, d_ptr, NULL, no_effect, 0);
 
 	/* Get player pointer */
 	p = &g->p[g->turn];
@@ -4058,6 +4907,9 @@ void play_card(game *g, design *d_ptr, int no_effect, int check)
 		break;
 	}
 
+	/* Update beliefs */
+	update_belief(g, g->turn);
+
 	/* Check for first to run out of cards */
 	if (p->stack[LOC_HAND] + p->stack[LOC_DRAW] == 0)
 	{
@@ -4066,7 +4918,7 @@ void play_card(game *g, design *d_ptr, int no_effect, int check)
 	}
 
 	/* Played cards are active */
-	c->active = 1;
+	activate_card(g, g->turn, c);
 
 	/* Card was recently played */
 	c->recent = 1;
@@ -4122,7 +4974,7 @@ void play_card(game *g, design *d_ptr, int no_effect, int check)
 			if (gang_good) continue;
 
 			/* Deactivate card */
-			deactivate_card(old);
+			deactivate_card(g, g->turn, old);
 		}
 
 		/* Player has played needed character for this turn */
@@ -4395,10 +5247,9 @@ int bluff_legal(game *g, int who)
  */
 void play_bluff(game *g, design *d_ptr)
 {
-	char msg[1024];
 	player *p, *opp;
-	card *c;
-	int i;
+	card *c, *b;
+	int i, known;
 
 	/* Get player pointer */
 	p = &g->p[g->turn];
@@ -4406,30 +5257,32 @@ void play_bluff(game *g, design *d_ptr)
 	/* Get opponent pointer */
 	opp = &g->p[!g->turn];
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s plays bluff card.\n"), p->p_ptr->name);
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_PLAY_BLUFF, g->turn, NULL, NULL, 0, 0);
 
 	/* Find card to be played */
 	c = find_card(g, g->turn, d_ptr);
 
+	/* Remember bluff card */
+	b = c;
+
+	/* Check for opponent knowing card was in hand */
+	known = c->loc_known && c->where == LOC_HAND;
+
 	/* Move card to support area */
 	move_card(g, g->turn, d_ptr, LOC_SUPPORT, 0);
 
 	/* Set bluff flag */
 	c->bluff = 1;
 
+	/* Card's reset state has changed */
+	c->modified = 1;
+
 	/* Override type to support */
 	c->type = TYPE_SUPPORT;
 
 	/* Card is active */
-	c->active = 1;
+	activate_card(g, g->turn, c);
 
 	/* Card is recently played */
 	c->recent = 1;
@@ -4463,6 +5316,19 @@ void play_bluff(game *g, design *d_ptr)
 			/* Clear location known flag */
 			c->loc_known = 0;
 		}
+
+		/* Check for bluff card seen in hand before */
+		if (known)
+		{
+			/* Card was in hand */
+			b->hand_prob = 1;
+
+			/* Any unknown card in hand could have been played */
+			belief_leave(g, g->turn);
+		}
+
+		/* Update beliefs */
+		update_belief(g, g->turn);
 	}
 
 	/* Check for "forced play" effects from opponent */
@@ -4492,24 +5358,11 @@ void play_bluff(game *g, design *d_ptr)
  */
 int reveal_bluff(game *g, int who, design *d_ptr)
 {
-	player *p;
 	card *c;
-	char msg[1024];
 	int good = 0;
 
-	/* Get player pointer */
-	p = &g->p[who];
-
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s reveals bluff card %s.\n"), p->p_ptr->name,
-		                                               d_ptr->name);
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_REVEAL_BLUFF, who, d_ptr, NULL, 0, 0);
 
 	/* Get card */
 	c = find_card(g, who, d_ptr);
@@ -4521,6 +5374,9 @@ int reveal_bluff(game *g, int who, design *d_ptr)
 	/* Card is no longer a bluff */
 	c->bluff = 0;
 
+	/* Card's reset state has changed */
+	c->modified = 1;
+
 	/* Reset card type */
 	c->type = c->d_ptr->type;
 
@@ -4539,26 +5395,15 @@ int reveal_bluff(game *g, int who, design *d_ptr)
  */
 void bluff_called(game *g)
 {
-	player *p, *opp;
+	player *p;
 	card *c;
-	char msg[1024];
 	int i, good = 1;
 
 	/* Get player pointer */
 	p = &g->p[g->turn];
 
-	/* Get opponent pointer */
-	opp = &g->p[!g->turn];
-
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s calls bluff.\n"), opp->p_ptr->name);
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_CALL_BLUFF, !g->turn, NULL, NULL, 0, 0);
 
 	/* Loop over cards */
 	for (i = 1; i < DECK_SIZE; i++)
@@ -4576,34 +5421,16 @@ void bluff_called(game *g)
 	/* Bluff was good */
 	if (good)
 	{
-		/* Message */
-		if (!g->simulation)
-		{
-			/* Format message */
-			sprintf(msg,
-			       _("%s attracts dragon with successful bluff.\n"),
-			       p->p_ptr->name);
-
-			/* Send message */
-			message_add(msg);
-		}
+		/* Record event */
+		add_event(g, EV_BLUFF_DRAGON, g->turn, NULL, NULL, 0, 0);
 
 		/* Attract a dragon */
 		attract_dragon(g, g->turn);
 	}
 	else
 	{
-		/* Message */
-		if (!g->simulation)
-		{
-			/* Format message */
-			sprintf(msg,
-			       _("%s attracts dragon for calling bluff.\n"),
-			       opp->p_ptr->name);
-
-			/* Send message */
-			message_add(msg);
-		}
+		/* Record event */
+		add_event(g, EV_CALLED_DRAGON, !g->turn, NULL, NULL, 0, 0);
 
 		/* Opponent attracts dragon */
 		attract_dragon(g, !g->turn);
@@ -4620,21 +5447,12 @@ void load_card(game *g, design *d_ptr, design *ship_dptr)
 {
 	player *p;
 	card *c;
-	char msg[1024];
 
 	/* Get player pointer */
 	p = &g->p[g->turn];
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s loads %s onto %s.\n"), p->p_ptr->name,
-		        _(d_ptr->name), _(ship_dptr->name));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_LOAD, g->turn, d_ptr, ship_dptr, 0, 0);
 
 	/* Find card to be loaded */
 	c = find_card(g, g->turn, d_ptr);
@@ -4657,6 +5475,9 @@ void load_card(game *g, design *d_ptr, design *ship_dptr)
 	/* Card's location is known */
 	c->loc_known = 1;
 
+	/* Update beliefs */
+	update_belief(g, g->turn);
+
 	/* Card was recently played */
 	c->recent = 1;
 
@@ -4676,23 +5497,10 @@ void load_card(game *g, design *d_ptr, design *ship_dptr)
  */
 void land_ship(game *g, design *d_ptr)
 {
-	player *p;
 	card *c;
-	char msg[1024];
-
-	/* Get player pointer */
-	p = &g->p[g->turn];
-
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s lands %s.\n"), p->p_ptr->name,
-		        _(d_ptr->name));
 
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_LAND, g->turn, d_ptr, NULL, 0, 0);
 
 	/* Find card */
 	c = find_card(g, g->turn, d_ptr);
@@ -4710,7 +5518,7 @@ int special_possible(game *g, design *d_ptr)
 {
 	player *opp;
 	card *c;
-	int effect, type = 0;
+	int effect, type;
 	int num_choices = 0, num_char = 0;
 	int i;
 
@@ -4727,12 +5535,10 @@ int special_possible(game *g, design *d_ptr)
 	if (d_ptr->special_cat != 4) return 0;
 
 	/* Check for discard of active cards */
-	if (effect & (S4_YOUR_CHAR | S4_YOUR_SUPPORT | S4_YOUR_BOOSTER))
+	if (d_ptr->effect_4 == s4_discard && d_ptr->effect_types)
 	{
-		/* Create type */
-		if (effect & S4_YOUR_CHAR) type |= TYPE_CHARACTER;
-		if (effect & S4_YOUR_BOOSTER) type |= TYPE_BOOSTER;
-		if (effect & S4_YOUR_SUPPORT) type |= TYPE_SUPPORT;
+		/* Get compiled type mask */
+		type = d_ptr->effect_types;
 
 		/* Loop over opponent cards */
 		for (i = 1; i < DECK_SIZE; i++)
@@ -4802,18 +5608,9 @@ int special_possible(game *g, design *d_ptr)
 void use_special(game *g, design *d_ptr)
 {
 	card *c;
-	char msg[1024];
-
-	/* Check for simulation */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s uses %s special text.\n"),
-		             _(g->p[g->turn].p_ptr->name), _(d_ptr->name));
 
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_USE, g->turn, d_ptr, NULL, 0, 0);
 
 	/* Find card used */
 	c = find_card(g, g->turn, d_ptr);
@@ -4943,21 +5740,14 @@ static int satisfy_legal(game *g, int who, design **list, int num, int which,
 }
 
 /*
- * Handle a satisfy choice.
+ * Check that a set of discards satisfies an opponent's category 7 card.
  */
-static int satisfy_callback(game *g, int who, design **list, int num,
-                            void *data)
+static int satisfy_check(game *g, int who, design **list, int num,
+                         design *d_ptr)
 {
-	design *d_ptr = (design *)data;
-	player *p;
 	card *c;
-	char msg[1024];
-	int i;
 	int effect, value;
 
-	/* Get player pointer */
-	p = &g->p[who];
-
 	/* Find opponent's card */
 	c = find_card(g, !who, d_ptr);
 
@@ -4968,19 +5758,28 @@ static int satisfy_callback(game *g, int who, design **list, int num,
 	/* Check for boosted effect */
 	if (c->text_boosted) value *= 2;
 
+	/* Check discards */
+	return satisfy_legal(g, who, list, num, ~0, effect, value, 1);
+}
+
+/*
+ * Handle a satisfy choice.
+ */
+static int satisfy_callback(game *g, int who, design **list, int num,
+                            void *data)
+{
+	design *d_ptr = (design *)data;
+	card *c;
+	int i;
+
 	/* Check for illegal discards */
-	if (!satisfy_legal(g, who, list, num, ~0, effect, value, 1)) return 0;
+	if (!satisfy_check(g, who, list, num, d_ptr)) return 0;
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s satisfies %s.\n"), _(p->p_ptr->name),
-		                                      _(d_ptr->name));
+	/* Find opponent's card */
+	c = find_card(g, !who, d_ptr);
 
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_SATISFY, who, d_ptr, NULL, 0, 0);
 
 	/* Discard each chosen card */
 	for (i = 0; i < num; i++)
@@ -4996,6 +5795,34 @@ static int satisfy_callback(game *g, int who, design **list, int num,
 	return 2;
 }
 
+/*
+ * Check whether a choice callback would accept a set of cards, without
+ * changing the game.
+ *
+ * Only callbacks whose rules can be checked before they change anything
+ * are looked at; other choices are assumed to be legal.
+ */
+int choice_legal(game *g, int who, design **list, int num,
+                 choose_result callback, void *data)
+{
+	/* Check for discard choice */
+	if (callback == discard_callback)
+	{
+		/* Check discards */
+		return discard_legal(g, who, list, num, (design *)data);
+	}
+
+	/* Check for satisfy choice */
+	if (callback == satisfy_callback)
+	{
+		/* Check discards */
+		return satisfy_check(g, who, list, num, (design *)data);
+	}
+
+	/* Assume legal */
+	return 1;
+}
+
 /*
  * Check whether a player has cards needed to satisfy a "discard or..."
  * effect.
@@ -5131,7 +5958,6 @@ static void check_unsatisfied_attract(game *g, int who)
 {
 	player *opp;
 	card *c;
-	char msg[1024];
 	int i;
 
 	/* Get opponent pointer */
@@ -5158,18 +5984,8 @@ static void check_unsatisfied_attract(game *g, int who)
 		/* Check for "or dragon" */
 		if (c->d_ptr->special_effect & S7_OR_DRAGON)
 		{
-			/* Check for simulation */
-			if (!g->simulation)
-			{
-				/* Format message */
-				sprintf(msg,
-				        _("%s attracts dragon due to %s.\n"),
-				        _(g->p[!who].p_ptr->name),
-				        _(c->d_ptr->name));
-
-				/* Send message */
-				message_add(msg);
-			}
+			/* Record event */
+			add_event(g, EV_DRAGON_DUE, !who, c->d_ptr, NULL, 0, 0);
 
 			/* Award dragon to opponent */
 			attract_dragon(g, !who);
@@ -5224,7 +6040,7 @@ void clear_cards(game *g)
 			}
 
 			/* Deactivate card */
-			deactivate_card(c);
+			deactivate_card(g, i, c);
 
 			/* Check for card to be removed */
 			if (c->where == LOC_COMBAT ||
@@ -5257,7 +6073,6 @@ void start_turn(game *g)
 	player *p;
 	card *c;
 	int i, storm = 0;
-	char msg[1024];
 
 	/* Get current player pointer */
 	p = &g->p[g->turn];
@@ -5282,20 +6097,11 @@ void start_turn(game *g)
 	}
 
 	/* Look for active storm cards */
-	for (i = 1; i < DECK_SIZE; i++)
+	for (i = next_special(p, 6, 0); i; i = next_special(p, 6, i))
 	{
 		/* Get card pointer */
 		c = &p->deck[i];
 
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Skip non-category 6 cards */
-		if (c->d_ptr->special_cat != 6) continue;
-
-		/* Skip cards with text ignored */
-		if (c->text_ignored) continue;
-
 		/* Skip cards without STORM flag */
 		if (!(c->d_ptr->special_effect & S6_STORM)) continue;
 
@@ -5306,16 +6112,8 @@ void start_turn(game *g)
 	/* Check for multiple storms */
 	if (storm > 1)
 	{
-		/* Check for simulation */
-		if (!g->simulation)
-		{
-			/* Format message */
-			sprintf(msg, _("%s attracts dragon using Storms.\n"),
-			             _(g->p[g->turn].p_ptr->name));
-
-			/* Send message */
-			message_add(msg);
-		}
+		/* Record event */
+		add_event(g, EV_STORMS, g->turn, NULL, NULL, 0, 0);
 
 		/* Attract a dragon */
 		attract_dragon(g, g->turn);
@@ -5328,7 +6126,6 @@ void start_turn(game *g)
 void game_over(game *g)
 {
 	int winner;
-	char buf[1024];
 
 	/* Do nothing if already handled */
 	if (g->game_over) return;
@@ -5355,21 +6152,9 @@ void game_over(game *g)
 	/* Crystals can't go over 5 */
 	if (g->p[winner].crystals > 5) g->p[winner].crystals = 5;
 
-	/* Check for simulation */
-	if (!g->simulation)
-	{
-		/* Send message */
-		message_add(_("Game over\n"));
-
-		/* Create message about crystals won */
-		sprintf(buf, ngettext("%s wins %d crystal.\n",
-		                      "%s wins %d crystals.\n",
-				      g->p[winner].dragons + 1),
-		        _(g->p[winner].p_ptr->name), g->p[winner].dragons + 1);
-
-		/* Send message */
-		message_add(buf);
-	}
+	/* Record event */
+	add_event(g, EV_GAME_OVER, winner, NULL, NULL,
+	          g->p[winner].dragons + 1, 0);
 }
 
 /*
@@ -5617,7 +6402,6 @@ static int decline_callback(game *g, int who, design **list, int num,
  */
 void retreat(game *g)
 {
-	char msg[1024];
 	player *p;
 	design *d_ptr, *list[DECK_SIZE];
 	card *c;
@@ -5656,25 +6440,9 @@ void retreat(game *g)
 		/* Get number of dragons attracted */
 		dragons = dragon_amount(g);
 
-		/* Message */
-		if (!g->simulation)
-		{
-			/* Format message */
-			sprintf(msg, _("%s retreats.\n"),
-			        _(g->p[g->turn].p_ptr->name));
-
-			/* Send message */
-			message_add(msg);
-
-			/* Format message */
-			sprintf(msg, ngettext("%s attracts %d dragon.\n",
-			                      "%s attracts %d dragons.\n",
-			                      dragons),
-			        _(g->p[!g->turn].p_ptr->name), dragons);
-
-			/* Send message */
-			message_add(msg);
-		}
+		/* Record events */
+		add_event(g, EV_RETREAT, g->turn, NULL, NULL, 0, 0);
+		add_event(g, EV_DRAGONS, !g->turn, NULL, NULL, dragons, 0);
 
 		/* Attract dragons */
 		for (i = 0; i < dragons; i++)
@@ -5740,16 +6508,8 @@ void retreat(game *g)
 		return;
 	}
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, _("%s declines to start fight.\n"),
-		        _(g->p[g->turn].p_ptr->name));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_DECLINE, g->turn, NULL, NULL, 0, 0);
 
 	/* Clear played leadership cards */
 	clear_cards(g);
@@ -5788,14 +6548,15 @@ void retreat(game *g)
 	notice_effect_1(g);
 }
 
+#ifdef DEBUG
 /*
- * Compute the power a player has in the current fight element.
+ * Check that a player's power totals match their cards.
  */
-int compute_power(game *g, int who)
+static void check_power(game *g, int who)
 {
 	player *p;
 	card *c;
-	int power = 0;
+	int power[2] = { 0, 0 };
 	int i;
 
 	/* Get player pointer */
@@ -5817,8 +6578,39 @@ int compute_power(game *g, int who)
 		if (c->value_ignored) continue;
 
 		/* Add power */
-		power += c->value[g->fight_element];
+		power[0] += c->value[0];
+		power[1] += c->value[1];
+	}
+
+	/* Check totals */
+	if (power[0] != p->power[0] || power[1] != p->power[1])
+	{
+		/* Error */
+		fprintf(stderr, "Power mismatch: %d/%d counted %d/%d\n",
+		        power[0], power[1], p->power[0], p->power[1]);
+		exit(1);
 	}
+}
+#endif
+
+/*
+ * Compute the power a player has in the current fight element.
+ */
+int compute_power(game *g, int who)
+{
+	player *p;
+	int power;
+
+	/* Get player pointer */
+	p = &g->p[who];
+
+#ifdef DEBUG
+	/* Check running totals */
+	check_power(g, who);
+#endif
+
+	/* Get total power in fight element */
+	power = p->power[g->fight_element];
 
 	/* Check for minimum power */
 	if (power < p->min_power) power = p->min_power;
@@ -6002,7 +6794,6 @@ void announce_power(game *g, int element)
 {
 	player *p, *opp;
 	card *c;
-	char msg[1024];
 	int i, effect, bluff = 0;
 
 	/* Get player pointer */
@@ -6024,18 +6815,9 @@ void announce_power(game *g, int element)
 		notice_effect_1(g);
 	}
 
-	/* Message */
-	if (!g->simulation)
-	{
-		/* Format message */
-		sprintf(msg, g->fight_element ?
-		              _("%s announces %d earth.\n") :
-		              _("%s announces %d fire.\n"),
-		        _(p->p_ptr->name), compute_power(g, g->turn));
-
-		/* Send message */
-		message_add(msg);
-	}
+	/* Record event */
+	add_event(g, EV_ANNOUNCE, g->turn, NULL, NULL,
+	          compute_power(g, g->turn), g->fight_element);
 
 	/* Don't bother with calling bluffs in simulated games */
 	if (g->simulation) return;
@@ -6060,20 +6842,11 @@ void announce_power(game *g, int element)
 	if (!bluff) return;
 
 	/* Look for "you may not call bluff" effect */
-	for (i = 1; i < DECK_SIZE; i++)
+	for (i = next_special(p, 3, 0); i; i = next_special(p, 3, i))
 	{
 		/* Get card pointer */
 		c = &p->deck[i];
 
-		/* Skip inactive cards */
-		if (!c->active) continue;
-
-		/* Skip cards with text ignored */
-		if (c->text_ignored) continue;
-
-		/* Skip cards without category 3 effects */
-		if (c->d_ptr->special_cat != 3) continue;
-
 		/* Get effect code */
 		effect = c->d_ptr->special_effect;
 
@@ -6096,7 +6869,6 @@ void end_turn(game *g)
 	player *p;
 	card *c;
 	int i, flood = 0;
-	char msg[1024];
 
 	/* Get player pointer */
 	p = &g->p[g->turn];
@@ -6117,7 +6889,7 @@ void end_turn(game *g)
 		if (c->where == LOC_LEADERSHIP)
 		{
 			/* Deactivate card */
-			deactivate_card(c);
+			deactivate_card(g, g->turn, c);
 
 			/* Handle category 1 effects */
 			notice_effect_1(g);
@@ -6156,19 +6928,270 @@ void end_turn(game *g)
 		/* Switch turn */
 		g->turn = !g->turn;
 
-		/* Check for simulation */
-		if (!g->simulation)
-		{
-			/* Format message */
-			sprintf(msg,
-			        _("Forcing %s to retreat due to Floods.\n"),
-			        _(g->p[g->turn].p_ptr->name));
-
-			/* Send message */
-			message_add(msg);
-		}
+		/* Record event */
+		add_event(g, EV_FLOODS, g->turn, NULL, NULL, 0, 0);
 
 		/* Force retreat */
 		retreat(g);
 	}
 }
+
+/*
+ * Format an event as a (translated) message.
+ *
+ * Events with nothing to say produce an empty string.
+ */
+void event_message(event *e, char *buf)
+{
+	char *name, *card = NULL, *other = NULL;
+
+	/* Get player name */
+	name = _(e->p_ptr->name);
+
+	/* Get names of cards involved */
+	if (e->d_ptr) card = _(e->d_ptr->name);
+	if (e->other) other = _(e->other->name);
+
+	/* Assume no message */
+	buf[0] = '\0';
+
+	/* Switch on event type */
+	switch (e->type)
+	{
+		/* Card moved face-up */
+		case EV_MOVE:
+
+			/* Switch on destination */
+			switch (e->value[0])
+			{
+				/* Hand */
+				case LOC_HAND:
+
+					/* Format message */
+					sprintf(buf,
+					        _("%s takes %s into hand.\n"),
+					        name, card);
+					break;
+
+				/* Draw pile */
+				case LOC_DRAW:
+
+					/* Format message */
+					sprintf(buf,
+					        _("Moving %s to draw pile.\n"),
+					        card);
+					break;
+
+				/* Combat area */
+				case LOC_COMBAT:
+
+					/* Format message */
+					sprintf(buf,
+					        _("Moving %s to combat area.\n"),
+					        card);
+					break;
+
+				/* Support area */
+				case LOC_SUPPORT:
+
+					/* Format message */
+					sprintf(buf,
+					        _("Moving %s to support area.\n"),
+					        card);
+					break;
+
+				/* Leadership */
+				case LOC_LEADERSHIP:
+
+					/* Format message */
+					sprintf(buf,
+					        _("%s moves %s to leadership area.\n"),
+					        name, card);
+					break;
+
+				/* Discard */
+				case LOC_DISCARD:
+
+					/* Format message */
+					sprintf(buf,
+					        _("%s moves %s to discard pile.\n"),
+					        name, card);
+					break;
+			}
+			break;
+
+		/* Card boosted */
+		case EV_BOOST:
+
+			/* Format message */
+			sprintf(buf, _("Boosting %s with %s.\n"), card, other);
+			break;
+
+		/* Card retrieved */
+		case EV_RETRIEVE:
+
+			/* Format message */
+			sprintf(buf, _("%s retrieves %s.\n"), name, card);
+			break;
+
+		/* Dragon attracted by card */
+		case EV_DRAGON_USING:
+
+			/* Format message */
+			sprintf(buf, _("%s attracts dragon using %s.\n"),
+			        name, card);
+			break;
+
+		/* Card played */
+		case EV_PLAY:
+
+			/* Format message */
+			sprintf(buf, e->value[0] ?
+			             _("%s plays %s with no effect.\n") :
+			             _("%s plays %s.\n"), name, card);
+			break;
+
+		/* Bluff card played */
+		case EV_PLAY_BLUFF:
+
+			/* Format message */
+			sprintf(buf, _("%s plays bluff card.\n"), name);
+			break;
+
+		/* Bluff card revealed */
+		case EV_REVEAL_BLUFF:
+
+			/* Format message */
+			sprintf(buf, _("%s reveals bluff card %s.\n"), name,
+			        card);
+			break;
+
+		/* Bluff called */
+		case EV_CALL_BLUFF:
+
+			/* Format message */
+			sprintf(buf, _("%s calls bluff.\n"), name);
+			break;
+
+		/* Dragon attracted by successful bluff */
+		case EV_BLUFF_DRAGON:
+
+			/* Format message */
+			sprintf(buf,
+			        _("%s attracts dragon with successful bluff.\n"),
+			        name);
+			break;
+
+		/* Dragon attracted by calling bluff */
+		case EV_CALLED_DRAGON:
+
+			/* Format message */
+			sprintf(buf,
+			        _("%s attracts dragon for calling bluff.\n"),
+			        name);
+			break;
+
+		/* Card loaded onto ship */
+		case EV_LOAD:
+
+			/* Format message */
+			sprintf(buf, _("%s loads %s onto %s.\n"), name, card,
+			        other);
+			break;
+
+		/* Ship landed */
+		case EV_LAND:
+
+			/* Format message */
+			sprintf(buf, _("%s lands %s.\n"), name, card);
+			break;
+
+		/* Special text used */
+		case EV_USE:
+
+			/* Format message */
+			sprintf(buf, _("%s uses %s special text.\n"),
+			        name, card);
+			break;
+
+		/* Card satisfied */
+		case EV_SATISFY:
+
+			/* Format message */
+			sprintf(buf, _("%s satisfies %s.\n"), name, card);
+			break;
+
+		/* Dragon attracted due to opponent's card */
+		case EV_DRAGON_DUE:
+
+			/* Format message */
+			sprintf(buf, _("%s attracts dragon due to %s.\n"),
+			        name, card);
+			break;
+
+		/* Dragon attracted using Storms */
+		case EV_STORMS:
+
+			/* Format message */
+			sprintf(buf, _("%s attracts dragon using Storms.\n"),
+			        name);
+			break;
+
+		/* Player retreats */
+		case EV_RETREAT:
+
+			/* Format message */
+			sprintf(buf, _("%s retreats.\n"), name);
+			break;
+
+		/* Dragons attracted at end of fight */
+		case EV_DRAGONS:
+
+			/* Format message */
+			sprintf(buf, ngettext("%s attracts %d dragon.\n",
+			                      "%s attracts %d dragons.\n",
+			                      e->value[0]),
+			        name, e->value[0]);
+			break;
+
+		/* Fight declined */
+		case EV_DECLINE:
+
+			/* Format message */
+			sprintf(buf, _("%s declines to start fight.\n"), name);
+			break;
+
+		/* Power announced */
+		case EV_ANNOUNCE:
+
+			/* Format message */
+			sprintf(buf, e->value[1] ?
+			             _("%s announces %d earth.\n") :
+			             _("%s announces %d fire.\n"),
+			        name, e->value[0]);
+			break;
+
+		/* Retreat forced by Floods */
+		case EV_FLOODS:
+
+			/* Format message */
+			sprintf(buf,
+			        _("Forcing %s to retreat due to Floods.\n"),
+			        name);
+			break;
+
+		/* Game over */
+		case EV_GAME_OVER:
+
+			/* Start with game over */
+			strcpy(buf, _("Game over\n"));
+
+			/* Add crystals won */
+			sprintf(buf + strlen(buf),
+			        ngettext("%s wins %d crystal.\n",
+			                 "%s wins %d crystals.\n",
+			                 e->value[0]),
+			        name, e->value[0]);
+			break;
+	}
+}
@@ -20,6 +20,8 @@
 
 #include "bluemoon.h"
 
+#include <sys/stat.h>
+
 /*
  * Set of peoples.
  */
@@ -241,26 +243,66 @@ static int lookup_effect(char *ptr, int cat)
 }
 
 /*
- * Read card designs from a text file.
+ * Open a data file, looking in the data directory first.
  */
-void read_cards(void)
+static FILE *open_data(char *name, char *mode)
 {
+	char fname[1024];
 	FILE *fff;
-	char buf[1024], *ptr;
-	int num_people = 0, num_design = 0;
-	design *deck = NULL, *d_ptr = NULL;
-	int i, effect, cat;
 
-	/* Open card design file */
-	fff = fopen(DATADIR "/cards.txt", "r");
+	/* Create filename in data directory */
+	sprintf(fname, DATADIR "/%s", name);
+
+	/* Open file */
+	fff = fopen(fname, mode);
 
 	/* Check for error */
 	if (!fff)
 	{
 		/* Try reading from current directory instead */
-		fff = fopen("cards.txt", "r");
+		fff = fopen(name, mode);
 	}
 
+	/* Return file pointer */
+	return fff;
+}
+
+/*
+ * Get the status of a data file, looked for as open_data() would.
+ *
+ * Return -1 if the file isn't found.
+ */
+static int stat_data(char *name, struct stat *st)
+{
+	char fname[1024];
+
+	/* Create filename in data directory */
+	sprintf(fname, DATADIR "/%s", name);
+
+	/* Check data directory, then current directory */
+	if (!stat(fname, st) || !stat(name, st)) return 0;
+
+	/* Not found */
+	return -1;
+}
+
+/*
+ * Read card designs from the text file.
+ *
+ * Unknown icons or effects and too many peoples or designs are fatal
+ * errors.
+ */
+void parse_cards(void)
+{
+	FILE *fff;
+	char buf[1024], *ptr;
+	int num_people = 0, num_design = 0;
+	design *deck = NULL, *d_ptr = NULL;
+	int i, effect, cat;
+
+	/* Open card design file */
+	fff = open_data("cards.txt", "r");
+
 	/* Check for error */
 	if (!fff)
 	{
@@ -290,6 +332,16 @@ void read_cards(void)
 			/* New people */
 			case 'P':
 
+				/* Check for too many peoples */
+				if (num_people == MAX_PEOPLE)
+				{
+					/* Error */
+					printf(_("Too many peoples!\n"));
+
+					/* Exit */
+					exit(1);
+				}
+
 				/* Read name */
 				peoples[num_people].name = strdup(buf + 2);
 
@@ -307,6 +359,17 @@ void read_cards(void)
 			/* New card */
 			case 'N':
 
+				/* Check for no people or too many designs */
+				if (!deck || num_design == DECK_SIZE)
+				{
+					/* Error */
+					printf(_("Too many cards for %s!\n"),
+					       buf + 2);
+
+					/* Exit */
+					exit(1);
+				}
+
 				/* Current design pointer */
 				d_ptr = &deck[num_design];
 
@@ -473,6 +536,372 @@ void read_cards(void)
 	fclose(fff);
 }
 
+/*
+ * Compiled card database.
+ *
+ * The database holds the designs parsed from cards.txt, with every name
+ * and text in one string pool, so that it can be loaded with a single
+ * read.  It is written by the "mkcards" tool, which the build runs again
+ * whenever cards.txt changes.  The size and modification time of the
+ * cards.txt it was compiled from are kept, so that a database left stale
+ * by other builds is noticed and the text file parsed instead.
+ *
+ * All values are stored in host byte order.
+ */
+#define CARD_DB_MAGIC 0x42444d42
+#define CARD_DB_VERSION 3
+
+/*
+ * Card database header.
+ */
+typedef struct card_db_header
+{
+	/* Magic number ("BMDB") */
+	uint32_t magic;
+
+	/* Format version */
+	uint32_t version;
+
+	/* Number of peoples and designs per people */
+	uint32_t num_people;
+	uint32_t num_design;
+
+	/* Size of each design record in bytes */
+	uint32_t record_size;
+
+	/* Size of string pool in bytes */
+	uint32_t pool_size;
+
+	/* Size and modification time of cards.txt compiled from */
+	int64_t source_size;
+	int64_t source_mtime;
+
+} card_db_header;
+
+/*
+ * One design in the card database.
+ *
+ * Strings are offsets into the string pool (-1 for none).
+ */
+typedef struct card_db_design
+{
+	int32_t value[2];
+	int32_t type;
+	int32_t icons;
+	int32_t name;
+	int32_t text;
+	int32_t special_prio;
+	int32_t special_cat;
+	int32_t special_time;
+	int32_t special_effect;
+	int32_t special_value;
+	int32_t people;
+	int32_t index;
+	int32_t moons;
+	int32_t capacity;
+
+} card_db_design;
+
+/*
+ * Add a string to a growing string pool.
+ *
+ * Return the string's offset, or -1 for no string.
+ */
+static int32_t pool_add(char **pool, uint32_t *size, char *str)
+{
+	int32_t offset;
+
+	/* Check for no string */
+	if (!str) return -1;
+
+	/* Remember offset */
+	offset = *size;
+
+	/* Grow pool */
+	*size += strlen(str) + 1;
+	*pool = (char *)realloc(*pool, *size);
+
+	/* Copy string */
+	strcpy(*pool + offset, str);
+
+	/* Return offset */
+	return offset;
+}
+
+/*
+ * Write the current card designs to a compiled card database.
+ *
+ * Return -1 on error.
+ */
+int write_card_db(char *fname)
+{
+	FILE *fff;
+	card_db_header header;
+	card_db_design rec[MAX_PEOPLE][DECK_SIZE];
+	int32_t people_name[MAX_PEOPLE];
+	struct stat st;
+	design *d_ptr;
+	char *pool = NULL;
+	uint32_t size = 0;
+	int i, j, error;
+
+	/* Clear records */
+	memset(rec, 0, sizeof(rec));
+
+	/* Loop over peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Add people name */
+		people_name[i] = pool_add(&pool, &size, peoples[i].name);
+
+		/* Loop over designs */
+		for (j = 0; j < DECK_SIZE; j++)
+		{
+			/* Get design pointer */
+			d_ptr = &peoples[i].deck[j];
+
+			/* Copy design */
+			rec[i][j].value[0] = d_ptr->value[0];
+			rec[i][j].value[1] = d_ptr->value[1];
+			rec[i][j].type = d_ptr->type;
+			rec[i][j].icons = d_ptr->icons;
+			rec[i][j].name = pool_add(&pool, &size, d_ptr->name);
+			rec[i][j].text = pool_add(&pool, &size, d_ptr->text);
+			rec[i][j].special_prio = d_ptr->special_prio;
+			rec[i][j].special_cat = d_ptr->special_cat;
+			rec[i][j].special_time = d_ptr->special_time;
+			rec[i][j].special_effect = d_ptr->special_effect;
+			rec[i][j].special_value = d_ptr->special_value;
+			rec[i][j].people = d_ptr->people;
+			rec[i][j].index = d_ptr->index;
+			rec[i][j].moons = d_ptr->moons;
+			rec[i][j].capacity = d_ptr->capacity;
+		}
+	}
+
+	/* Create header */
+	header.magic = CARD_DB_MAGIC;
+	header.version = CARD_DB_VERSION;
+	header.num_people = MAX_PEOPLE;
+	header.num_design = DECK_SIZE;
+	header.record_size = sizeof(card_db_design);
+	header.pool_size = size;
+
+	/* Check for text file compiled from */
+	if (!stat_data("cards.txt", &st))
+	{
+		/* Remember its size and modification time */
+		header.source_size = st.st_size;
+		header.source_mtime = st.st_mtime;
+	}
+	else
+	{
+		/* Database can't be checked for staleness */
+		header.source_size = header.source_mtime = -1;
+	}
+
+	/* Open database file */
+	fff = fopen(fname, "wb");
+
+	/* Check for error */
+	if (!fff)
+	{
+		/* Free pool */
+		free(pool);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Write header, people names, designs and string pool */
+	error = fwrite(&header, sizeof(header), 1, fff) != 1 ||
+	        fwrite(people_name, sizeof(people_name), 1, fff) != 1 ||
+	        fwrite(rec, sizeof(rec), 1, fff) != 1 ||
+	        fwrite(pool, size, 1, fff) != 1;
+
+	/* Close file */
+	if (fclose(fff)) error = 1;
+
+	/* Free pool */
+	free(pool);
+
+	/* Return error status */
+	return error ? -1 : 0;
+}
+
+/*
+ * Return a string from the card database pool.
+ */
+static char *pool_string(char *pool, uint32_t size, int32_t offset)
+{
+	/* Check for no string or bad offset */
+	if (offset < 0 || (uint32_t)offset >= size) return NULL;
+
+	/* Return string */
+	return pool + offset;
+}
+
+/*
+ * Read card designs from the compiled card database.
+ *
+ * The database is read into one block that is kept for good, since the
+ * design names and texts point into it.
+ *
+ * Return -1 if there is no usable database, or it was compiled from a
+ * different cards.txt.
+ */
+static int read_card_db(void)
+{
+	FILE *fff;
+	card_db_header *header;
+	card_db_design *rec;
+	int32_t *people_name;
+	struct stat st;
+	design *d_ptr;
+	char *block, *pool;
+	long size;
+	int i, j;
+
+	/* Open database file */
+	fff = open_data("cards.db", "rb");
+
+	/* Check for no database */
+	if (!fff) return -1;
+
+	/* Get file size */
+	fseek(fff, 0, SEEK_END);
+	size = ftell(fff);
+	rewind(fff);
+
+	/* Check for too small */
+	if (size < (long)sizeof(card_db_header))
+	{
+		/* Close file */
+		fclose(fff);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Create block */
+	block = (char *)malloc(size);
+
+	/* Read entire file */
+	if (fread(block, size, 1, fff) != 1)
+	{
+		/* Close file and free block */
+		fclose(fff);
+		free(block);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Close file */
+	fclose(fff);
+
+	/* Get header */
+	header = (card_db_header *)block;
+
+	/* Check header */
+	if (header->magic != CARD_DB_MAGIC ||
+	    header->version != CARD_DB_VERSION ||
+	    header->num_people != MAX_PEOPLE ||
+	    header->num_design != DECK_SIZE ||
+	    header->record_size != sizeof(card_db_design) ||
+	    (unsigned long)size != sizeof(card_db_header) + sizeof(int32_t) * MAX_PEOPLE +
+	            sizeof(card_db_design) * MAX_PEOPLE * DECK_SIZE +
+	            header->pool_size)
+	{
+		/* Free block */
+		free(block);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Find people names, designs and string pool */
+	people_name = (int32_t *)(header + 1);
+	rec = (card_db_design *)(people_name + MAX_PEOPLE);
+	pool = (char *)(rec + MAX_PEOPLE * DECK_SIZE);
+
+	/* Check for strings running past the end of the pool */
+	if (!header->pool_size || pool[header->pool_size - 1] != '\0')
+	{
+		/* Free block */
+		free(block);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Check for text file changed since database was compiled */
+	if (!stat_data("cards.txt", &st) &&
+	    (header->source_size != st.st_size ||
+	     header->source_mtime != st.st_mtime))
+	{
+		/* Free block */
+		free(block);
+
+		/* Database is stale */
+		return -1;
+	}
+
+	/* Loop over peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Set people name */
+		peoples[i].name = pool_string(pool, header->pool_size,
+		                              people_name[i]);
+
+		/* Loop over designs */
+		for (j = 0; j < DECK_SIZE; j++, rec++)
+		{
+			/* Get design pointer */
+			d_ptr = &peoples[i].deck[j];
+
+			/* Copy design */
+			d_ptr->value[0] = rec->value[0];
+			d_ptr->value[1] = rec->value[1];
+			d_ptr->type = rec->type;
+			d_ptr->icons = rec->icons;
+			d_ptr->name = pool_string(pool, header->pool_size,
+			                          rec->name);
+			d_ptr->text = pool_string(pool, header->pool_size,
+			                          rec->text);
+			d_ptr->special_prio = rec->special_prio;
+			d_ptr->special_cat = rec->special_cat;
+			d_ptr->special_time = rec->special_time;
+			d_ptr->special_effect = rec->special_effect;
+			d_ptr->special_value = rec->special_value;
+			d_ptr->people = rec->people;
+			d_ptr->index = rec->index;
+			d_ptr->moons = rec->moons;
+			d_ptr->capacity = rec->capacity;
+		}
+	}
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Read card designs, from the compiled database if there is a usable
+ * one and from the text file otherwise.
+ */
+void read_cards(void)
+{
+	/* Try compiled database first */
+	if (read_card_db() < 0)
+	{
+		/* Parse text file */
+		parse_cards();
+	}
+
+	/* Compile special effects */
+	compile_effects();
+}
+
 /*
  * Initialize a game.
  */
@@ -521,12 +950,21 @@ void init_game(game *g, int first)
 		/* Clear minimum power */
 		p->min_power = 0;
 
+		/* No power in play */
+		p->power[0] = p->power[1] = 0;
+
+		/* No active special powers */
+		memset(p->active_special, 0, sizeof(p->active_special));
+
 		/* Get leader card */
 		c = &p->deck[0];
 
 		/* Set card design */
 		c->d_ptr = &p->p_ptr->deck[0];
 
+		/* Card not counted in power totals */
+		c->counted[0] = c->counted[1] = 0;
+
 		/* Put in leadership pile */
 		c->where = LOC_LEADERSHIP;
 
@@ -575,6 +1013,9 @@ void init_game(game *g, int first)
 			/* Cards begin inactive */
 			c->active = 0;
 
+			/* Card not counted in power totals */
+			c->counted[0] = c->counted[1] = 0;
+
 			/* Card is not played as free */
 			c->was_played_free = 0;
 			c->playing_free = 0;
@@ -591,6 +1032,9 @@ void init_game(game *g, int first)
 			/* Card locations are unknown */
 			c->loc_known = 0;
 			c->disclosed = 0;
+
+			/* Card is not in hand */
+			c->hand_prob = 0;
 		}
 
 		/* Draw six cards */
@@ -0,0 +1,930 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bluemoon.h"
+#include "journal.h"
+
+/*
+ * Journal that decisions in real games are recorded to (if any).
+ */
+journal *record_journal;
+
+/*
+ * Open a journal file for writing.
+ *
+ * Return -1 on error.
+ */
+int journal_create(journal *j, char *fname)
+{
+	journal_header header;
+
+	/* Clear journal */
+	memset(j, 0, sizeof(journal));
+
+	/* Open file */
+	j->fp = fopen(fname, "wb");
+
+	/* Check for failure */
+	if (!j->fp) return -1;
+
+	/* Create header */
+	header.magic = JOURNAL_MAGIC;
+	header.version = JOURNAL_VERSION;
+	header.entry_size = sizeof(journal_entry);
+
+	/* Write header */
+	fwrite(&header, sizeof(journal_header), 1, j->fp);
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Start recording a new game.
+ */
+void journal_start(journal *j, game *g)
+{
+	/* Remember starting seed */
+	j->game.start_seed = g->start_seed;
+
+	/* Remember peoples */
+	j->game.people[0] = g->p[0].p_ptr - peoples;
+	j->game.people[1] = g->p[1].p_ptr - peoples;
+
+	/* No results yet */
+	j->game.crystals[0] = j->game.crystals[1] = 0;
+
+	/* No entries yet */
+	j->game.num_entries = 0;
+}
+
+/*
+ * Return the code used to store a card design.
+ */
+static int design_code(design *d_ptr)
+{
+	int i;
+
+	/* Check for no card */
+	if (!d_ptr) return JOURNAL_NO_CARD;
+
+	/* Loop over peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Check for design in this people's deck */
+		if (d_ptr >= peoples[i].deck &&
+		    d_ptr < peoples[i].deck + DECK_SIZE)
+		{
+			/* Return people and index */
+			return i * DECK_SIZE + (d_ptr - peoples[i].deck);
+		}
+	}
+
+	/* Unknown design */
+	return JOURNAL_NO_CARD;
+}
+
+/*
+ * Return the card design with the given code.
+ */
+design *journal_design(int code)
+{
+	/* Check for no card */
+	if (code == JOURNAL_NO_CARD) return NULL;
+
+	/* Return design */
+	return &peoples[code / DECK_SIZE].deck[code % DECK_SIZE];
+}
+
+/*
+ * Add a decision to the current game.
+ */
+void journal_add(journal *j, int type, int act, int index,
+                 design *arg, design *target, unsigned int value)
+{
+	journal_entry *e;
+
+	/* Check for full entry array */
+	if (j->game.num_entries == j->max_entries)
+	{
+		/* Grow array */
+		j->max_entries = j->max_entries * 2 + 256;
+
+		/* Reallocate array */
+		j->entry = (journal_entry *)realloc(j->entry,
+		                     sizeof(journal_entry) * j->max_entries);
+	}
+
+	/* Get next entry */
+	e = &j->entry[j->game.num_entries++];
+
+	/* Store decision */
+	e->type = type;
+	e->act = act;
+	e->index = index;
+	e->pad = 0;
+	e->arg = design_code(arg);
+	e->target = design_code(target);
+	e->value = value;
+}
+
+/*
+ * Write out the current game with its final result.
+ */
+void journal_finish(journal *j, game *g)
+{
+	/* Store crystals won */
+	j->game.crystals[0] = g->p[0].crystals;
+	j->game.crystals[1] = g->p[1].crystals;
+
+	/* Write game header */
+	fwrite(&j->game, sizeof(journal_game), 1, j->fp);
+
+	/* Write entries */
+	fwrite(j->entry, sizeof(journal_entry), j->game.num_entries, j->fp);
+
+	/* Count games */
+	j->num_games++;
+}
+
+/*
+ * Open a journal file for reading.
+ *
+ * Return -1 on error.
+ */
+int journal_open(journal *j, char *fname)
+{
+	journal_header header;
+
+	/* Clear journal */
+	memset(j, 0, sizeof(journal));
+
+	/* Open file */
+	j->fp = fopen(fname, "rb");
+
+	/* Check for failure */
+	if (!j->fp) return -1;
+
+	/* Read header */
+	if (fread(&header, sizeof(journal_header), 1, j->fp) != 1 ||
+	    header.magic != JOURNAL_MAGIC ||
+	    header.version != JOURNAL_VERSION ||
+	    header.entry_size != sizeof(journal_entry))
+	{
+		/* Close file */
+		fclose(j->fp);
+		j->fp = NULL;
+
+		/* Error */
+		return -1;
+	}
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Check that a stored design code is "no card" or a real design.
+ */
+static int valid_design(int code)
+{
+	/* Check code */
+	return code == JOURNAL_NO_CARD || code < MAX_PEOPLE * DECK_SIZE;
+}
+
+/*
+ * Check that a journal entry could have been recorded by a game.
+ */
+static int valid_entry(journal_entry *e)
+{
+	/* Check for unknown entry type */
+	if (e->type > JOURNAL_BLUFF) return 0;
+
+	/* Only actions use the other fields */
+	if (e->type != JOURNAL_ACT) return 1;
+
+	/* Check designs */
+	if (!valid_design(e->arg) || !valid_design(e->target)) return 0;
+
+	/* Switch on action */
+	switch (e->act)
+	{
+		/* Actions without a card */
+		case ACT_NONE:
+		case ACT_RETREAT:
+		case ACT_ANN_FIRE:
+		case ACT_ANN_EARTH:
+		case ACT_CHOOSE:
+			return 1;
+
+		/* Actions using a card without moving past it */
+		case ACT_USE:
+		case ACT_SATISFY:
+			return e->arg != JOURNAL_NO_CARD;
+
+		/* Loading needs a ship */
+		case ACT_LOAD:
+			if (e->target == JOURNAL_NO_CARD) return 0;
+
+			/* Fall through */
+
+		/* Actions playing a card from the deck */
+		case ACT_RETRIEVE:
+		case ACT_PLAY:
+		case ACT_PLAY_NO:
+		case ACT_LAND:
+		case ACT_BLUFF:
+		case ACT_REVEAL:
+			return e->arg != JOURNAL_NO_CARD && e->index < DECK_SIZE;
+	}
+
+	/* Unknown action */
+	return 0;
+}
+
+/*
+ * Read the next game from a journal, ready to be replayed.
+ *
+ * Return 0 at the end of the file (or on a damaged game).
+ */
+int journal_read(journal *j)
+{
+	int i, n;
+
+	/* Read game header */
+	if (fread(&j->game, sizeof(journal_game), 1, j->fp) != 1) return 0;
+
+	/* Get number of entries */
+	n = j->game.num_entries;
+
+	/* Check for damaged header */
+	if (j->game.people[0] >= MAX_PEOPLE ||
+	    j->game.people[1] >= MAX_PEOPLE) return 0;
+
+	/* Check for too small entry array */
+	if (n > j->max_entries)
+	{
+		/* Grow array */
+		j->max_entries = n;
+
+		/* Reallocate array */
+		j->entry = (journal_entry *)realloc(j->entry,
+		                     sizeof(journal_entry) * j->max_entries);
+	}
+
+	/* Read entries */
+	if (fread(j->entry, sizeof(journal_entry), n, j->fp) != (size_t)n)
+	{
+		/* Damaged game */
+		return 0;
+	}
+
+	/* Loop over entries */
+	for (i = 0; i < n; i++)
+	{
+		/* Check for entry no game could have recorded */
+		if (!valid_entry(&j->entry[i])) return 0;
+	}
+
+	/* Start replay at first entry */
+	j->pos = 0;
+
+	/* Count games */
+	j->num_games++;
+
+	/* Success */
+	return 1;
+}
+
+/*
+ * Close a journal.
+ */
+void journal_close(journal *j)
+{
+	/* Close file */
+	if (j->fp) fclose(j->fp);
+
+	/* Free entries */
+	free(j->entry);
+
+	/* Clear journal */
+	memset(j, 0, sizeof(journal));
+}
+
+/*
+ * Number of words in the game structure.
+ */
+#define NUM_WORDS (sizeof(game) / sizeof(uintptr_t))
+
+/*
+ * Kinds of game words.
+ */
+#define WORD_PLAIN   0
+#define WORD_PEOPLE  1
+#define WORD_DESIGN  2
+#define WORD_CONTROL 3
+
+/*
+ * Kind of each word in the game structure.
+ */
+static unsigned char word_kind[NUM_WORDS];
+
+/*
+ * Word kinds have been found.
+ */
+static int word_kind_set;
+
+/*
+ * Mark the kind of the word holding a pointer field.
+ */
+static void mark_word(game *g, void *field, int kind)
+{
+	/* Set kind */
+	word_kind[((char *)field - (char *)g) / sizeof(uintptr_t)] = kind;
+}
+
+/*
+ * Find which words of the game structure hold pointers.
+ */
+static void find_word_kinds(game *g)
+{
+	player *p;
+	card *c;
+	int i, j;
+
+	/* Check for already done */
+	if (word_kind_set) return;
+
+	/* Loop over players */
+	for (i = 0; i < 2; i++)
+	{
+		/* Get player pointer */
+		p = &g->p[i];
+
+		/* Mark player pointers */
+		mark_word(g, &p->p_ptr, WORD_PEOPLE);
+		mark_word(g, &p->control, WORD_CONTROL);
+		mark_word(g, &p->last_leader, WORD_DESIGN);
+		mark_word(g, &p->last_discard, WORD_DESIGN);
+
+		/* Loop over cards */
+		for (j = 0; j < DECK_SIZE; j++)
+		{
+			/* Get card pointer */
+			c = &p->deck[j];
+
+			/* Mark card pointers */
+			mark_word(g, &c->d_ptr, WORD_DESIGN);
+			mark_word(g, &c->target, WORD_DESIGN);
+			mark_word(g, &c->ship, WORD_DESIGN);
+		}
+	}
+
+	/* Mark event log and AI state pointers */
+	mark_word(g, &g->events, WORD_CONTROL);
+	mark_word(g, &g->ai, WORD_CONTROL);
+	mark_word(g, &g->search, WORD_CONTROL);
+
+	/* Done */
+	word_kind_set = 1;
+}
+
+/*
+ * Start a new history at the given game state.
+ *
+ * The history must be zeroed or have been used before.
+ */
+void history_start(history *h, game *g)
+{
+	/* Find pointer words */
+	find_word_kinds(g);
+
+	/* Remember state */
+	h->last = *g;
+
+	/* No steps */
+	h->num_changes = h->num_steps = h->pos = 0;
+}
+
+/*
+ * Record the changes made to the game since the current step as a new
+ * step, discarding any steps that were undone.
+ *
+ * Control pointers are never recorded.
+ *
+ * Return the number of changed words (no step is added if there are none).
+ */
+int history_record(history *h, game *g)
+{
+	uintptr_t *last = (uintptr_t *)&h->last, *cur = (uintptr_t *)g;
+	history_change *c;
+	history_step *s;
+	int i, first, old_num = h->num_changes;
+
+	/* New changes replace those of any undone steps */
+	first = h->pos < h->num_steps ? h->step[h->pos].first : h->num_changes;
+
+	/* Start adding changes */
+	h->num_changes = first;
+
+	/* Loop over words */
+	for (i = 0; i < NUM_WORDS; i++)
+	{
+		/* Skip unchanged words */
+		if (last[i] == cur[i]) continue;
+
+		/* Skip control pointers */
+		if (word_kind[i] == WORD_CONTROL) continue;
+
+		/* Check for full change array */
+		if (h->num_changes == h->max_changes)
+		{
+			/* Grow array */
+			h->max_changes = h->max_changes * 2 + 256;
+
+			/* Reallocate array */
+			h->change = (history_change *)realloc(h->change,
+			                  sizeof(history_change) * h->max_changes);
+		}
+
+		/* Get next change */
+		c = &h->change[h->num_changes++];
+
+		/* Store change */
+		c->word = i;
+		c->before = last[i];
+		c->after = cur[i];
+
+		/* Update state */
+		last[i] = cur[i];
+	}
+
+	/* Check for no changes */
+	if (h->num_changes == first)
+	{
+		/* Keep undone steps */
+		h->num_changes = old_num;
+
+		/* Nothing recorded */
+		return 0;
+	}
+
+	/* Discard undone steps */
+	h->num_steps = h->pos;
+
+	/* Check for full step array */
+	if (h->num_steps == h->max_steps)
+	{
+		/* Grow array */
+		h->max_steps = h->max_steps * 2 + 64;
+
+		/* Reallocate array */
+		h->step = (history_step *)realloc(h->step,
+		                      sizeof(history_step) * h->max_steps);
+	}
+
+	/* Add step */
+	s = &h->step[h->num_steps++];
+	s->first = first;
+	s->num = h->num_changes - first;
+
+	/* Advance to new step */
+	h->pos++;
+
+	/* Return number of changes */
+	return s->num;
+}
+
+/*
+ * Move the game back one step.
+ *
+ * Changes not yet recorded with history_record() are not undone.
+ *
+ * Return 0 if there is nothing to undo.
+ */
+int history_undo(history *h, game *g)
+{
+	uintptr_t *last = (uintptr_t *)&h->last, *cur = (uintptr_t *)g;
+	history_change *c;
+	history_step *s;
+	int i;
+
+	/* Check for first step */
+	if (!h->pos) return 0;
+
+	/* Get step to undo */
+	s = &h->step[--h->pos];
+
+	/* Loop over changes */
+	for (i = 0; i < s->num; i++)
+	{
+		/* Get change */
+		c = &h->change[s->first + i];
+
+		/* Restore old value */
+		last[c->word] = cur[c->word] = c->before;
+	}
+
+	/* Success */
+	return 1;
+}
+
+/*
+ * Move the game forward one undone step.
+ *
+ * Return 0 if there is nothing to redo.
+ */
+int history_redo(history *h, game *g)
+{
+	uintptr_t *last = (uintptr_t *)&h->last, *cur = (uintptr_t *)g;
+	history_change *c;
+	history_step *s;
+	int i;
+
+	/* Check for last step */
+	if (h->pos == h->num_steps) return 0;
+
+	/* Get step to redo */
+	s = &h->step[h->pos++];
+
+	/* Loop over changes */
+	for (i = 0; i < s->num; i++)
+	{
+		/* Get change */
+		c = &h->change[s->first + i];
+
+		/* Restore new value */
+		last[c->word] = cur[c->word] = c->after;
+	}
+
+	/* Success */
+	return 1;
+}
+
+/*
+ * Return the stored form of a game word.
+ */
+static uintptr_t save_word(int kind, uintptr_t value)
+{
+	/* Check kind */
+	switch (kind)
+	{
+		/* People pointer */
+		case WORD_PEOPLE:
+
+			/* Store index plus one (zero for none) */
+			if (!value) return 0;
+			return (people *)value - peoples + 1;
+
+		/* Design pointer */
+		case WORD_DESIGN:
+
+			/* Store design code */
+			return design_code((design *)value);
+
+		/* Control pointer */
+		case WORD_CONTROL:
+
+			/* Not stored */
+			return 0;
+	}
+
+	/* Store plain value */
+	return value;
+}
+
+/*
+ * Turn the stored form of a game word back into its value.
+ *
+ * Return -1 if the stored form is invalid.
+ */
+static int load_word(int kind, uintptr_t stored, uintptr_t *value)
+{
+	/* Check kind */
+	switch (kind)
+	{
+		/* People pointer */
+		case WORD_PEOPLE:
+
+			/* Check for bad index */
+			if (stored > MAX_PEOPLE) return -1;
+
+			/* Get people */
+			*value = stored ? (uintptr_t)&peoples[stored - 1] : 0;
+			return 0;
+
+		/* Design pointer */
+		case WORD_DESIGN:
+
+			/* Check for bad code */
+			if (stored != JOURNAL_NO_CARD &&
+			    stored >= MAX_PEOPLE * DECK_SIZE) return -1;
+
+			/* Get design */
+			*value = (uintptr_t)journal_design(stored);
+			return 0;
+	}
+
+	/* Plain value */
+	*value = stored;
+	return 0;
+}
+
+/*
+ * Write a history (and the game at its current step) to a file.
+ *
+ * Any unrecorded changes to the game are recorded first.
+ *
+ * Return -1 on error.
+ */
+int history_save(history *h, game *g, char *fname)
+{
+	FILE *fp;
+	history_header header;
+	history_change *c;
+	history_step *s;
+	uintptr_t *last = (uintptr_t *)&h->last, v;
+	uint32_t n;
+	int i, j;
+
+	/* Record pending changes */
+	history_record(h, g);
+
+	/* Open file */
+	fp = fopen(fname, "wb");
+
+	/* Check for failure */
+	if (!fp) return -1;
+
+	/* Create header */
+	header.magic = HISTORY_MAGIC;
+	header.version = HISTORY_VERSION;
+	header.word_size = sizeof(uintptr_t);
+	header.game_size = sizeof(game);
+	header.num_steps = h->num_steps;
+	header.pos = h->pos;
+
+	/* Write header */
+	fwrite(&header, sizeof(history_header), 1, fp);
+
+	/* Loop over game words */
+	for (i = 0; i < NUM_WORDS; i++)
+	{
+		/* Write stored form */
+		v = save_word(word_kind[i], last[i]);
+		fwrite(&v, sizeof(uintptr_t), 1, fp);
+	}
+
+	/* Loop over steps */
+	for (i = 0; i < h->num_steps; i++)
+	{
+		/* Get step */
+		s = &h->step[i];
+
+		/* Write number of changes */
+		n = s->num;
+		fwrite(&n, sizeof(uint32_t), 1, fp);
+
+		/* Loop over changes */
+		for (j = 0; j < s->num; j++)
+		{
+			/* Get change */
+			c = &h->change[s->first + j];
+
+			/* Write changed word */
+			fwrite(&c->word, sizeof(uint32_t), 1, fp);
+
+			/* Write old value */
+			v = save_word(word_kind[c->word], c->before);
+			fwrite(&v, sizeof(uintptr_t), 1, fp);
+
+			/* Write new value */
+			v = save_word(word_kind[c->word], c->after);
+			fwrite(&v, sizeof(uintptr_t), 1, fp);
+		}
+	}
+
+	/* Check for write errors */
+	if (ferror(fp))
+	{
+		/* Close file */
+		fclose(fp);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Close file */
+	if (fclose(fp)) return -1;
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Read one stored game word.
+ *
+ * Return -1 on error.
+ */
+static int read_word(FILE *fp, int kind, uintptr_t *value)
+{
+	uintptr_t stored;
+
+	/* Read stored form */
+	if (fread(&stored, sizeof(uintptr_t), 1, fp) != 1) return -1;
+
+	/* Convert */
+	return load_word(kind, stored, value);
+}
+
+/*
+ * Read the steps of a saved history.
+ *
+ * Return -1 on error.
+ */
+static int read_steps(history *h, FILE *fp, int num_steps)
+{
+	history_change *c;
+	history_step *s;
+	uint32_t n, word;
+	int i, j;
+
+	/* Loop over steps */
+	for (i = 0; i < num_steps; i++)
+	{
+		/* Read number of changes */
+		if (fread(&n, sizeof(uint32_t), 1, fp) != 1) return -1;
+
+		/* Check for full step array */
+		if (h->num_steps == h->max_steps)
+		{
+			/* Grow array */
+			h->max_steps = h->max_steps * 2 + 64;
+
+			/* Reallocate array */
+			h->step = (history_step *)realloc(h->step,
+			                      sizeof(history_step) * h->max_steps);
+		}
+
+		/* Add step */
+		s = &h->step[h->num_steps++];
+		s->first = h->num_changes;
+		s->num = 0;
+
+		/* Loop over changes */
+		for (j = 0; j < n; j++)
+		{
+			/* Read changed word */
+			if (fread(&word, sizeof(uint32_t), 1, fp) != 1) return -1;
+
+			/* Check for bad word */
+			if (word >= NUM_WORDS) return -1;
+
+			/* Check for full change array */
+			if (h->num_changes == h->max_changes)
+			{
+				/* Grow array */
+				h->max_changes = h->max_changes * 2 + 256;
+
+				/* Reallocate array */
+				h->change = (history_change *)realloc(h->change,
+				                  sizeof(history_change) *
+				                  h->max_changes);
+			}
+
+			/* Get next change */
+			c = &h->change[h->num_changes++];
+			c->word = word;
+			s->num++;
+
+			/* Read old and new values */
+			if (read_word(fp, word_kind[word], &c->before) < 0 ||
+			    read_word(fp, word_kind[word], &c->after) < 0)
+			{
+				/* Error */
+				return -1;
+			}
+		}
+	}
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Read a history from a file, and set the game to its current step.
+ *
+ * The game's control pointers are kept.  On error the game is unchanged
+ * and the history starts over at it.
+ *
+ * Return -1 on error.
+ */
+int history_load(history *h, game *g, char *fname)
+{
+	FILE *fp;
+	history_header header;
+	uintptr_t *last = (uintptr_t *)&h->last, *cur = (uintptr_t *)g;
+	int i, bad = 0;
+
+	/* Find pointer words */
+	find_word_kinds(g);
+
+	/* Open file */
+	fp = fopen(fname, "rb");
+
+	/* Check for failure */
+	if (!fp) return -1;
+
+	/* Read header */
+	if (fread(&header, sizeof(history_header), 1, fp) != 1 ||
+	    header.magic != HISTORY_MAGIC ||
+	    header.version != HISTORY_VERSION ||
+	    header.word_size != sizeof(uintptr_t) ||
+	    header.game_size != sizeof(game) ||
+	    header.pos > header.num_steps)
+	{
+		/* Close file */
+		fclose(fp);
+
+		/* Error */
+		return -1;
+	}
+
+	/* No steps yet */
+	h->num_changes = h->num_steps = h->pos = 0;
+
+	/* Loop over game words */
+	for (i = 0; i < NUM_WORDS && !bad; i++)
+	{
+		/* Keep control pointers */
+		if (word_kind[i] == WORD_CONTROL)
+		{
+			/* Skip stored word */
+			if (read_word(fp, WORD_PLAIN, &last[i]) < 0) bad = 1;
+
+			/* Use game's pointer */
+			last[i] = cur[i];
+			continue;
+		}
+
+		/* Read word */
+		if (read_word(fp, word_kind[i], &last[i]) < 0) bad = 1;
+	}
+
+	/* Read steps */
+	if (!bad && read_steps(h, fp, header.num_steps) < 0) bad = 1;
+
+	/* Close file */
+	fclose(fp);
+
+	/* Check for damaged file */
+	if (bad)
+	{
+		/* Start over at unchanged game */
+		history_start(h, g);
+
+		/* Error */
+		return -1;
+	}
+
+	/* Set current step */
+	h->pos = header.pos;
+
+	/* Set game */
+	*g = h->last;
+
+	/* Success */
+	return 0;
+}
+
+/*
+ * Free a history.
+ */
+void history_free(history *h)
+{
+	/* Free changes */
+	free(h->change);
+
+	/* Free steps */
+	free(h->step);
+
+	/* Clear history */
+	memset(h, 0, sizeof(history));
+}
@@ -0,0 +1,284 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* bluemoon.h must be included first */
+
+/*
+ * Action journals.
+ *
+ * A journal records every decision taken in a game: the actions
+ * performed, the cards chosen and whether bluffs were called.  Since
+ * everything else the engine does follows from the starting random seed,
+ * a game can be reconstructed by replaying its journal without asking
+ * the AI for anything.
+ *
+ * A journal file is a small header followed by one record per game, each
+ * a game header followed by its entries.  All values are stored in host
+ * byte order.
+ */
+
+/*
+ * Magic number at the start of every journal file ("BMJL").
+ */
+#define JOURNAL_MAGIC 0x4c4a4d42
+
+/*
+ * Current journal format version.
+ */
+#define JOURNAL_VERSION 1
+
+/*
+ * Journal entry types.
+ */
+#define JOURNAL_ACT     0
+#define JOURNAL_CHOOSE  1
+#define JOURNAL_BLUFF   2
+
+/*
+ * Action types (taken by the AI and stored in action entries).
+ */
+#define ACT_NONE        0
+#define ACT_RETREAT     1
+#define ACT_RETRIEVE    2
+#define ACT_PLAY        3
+#define ACT_PLAY_NO     4
+#define ACT_ANN_FIRE    5
+#define ACT_ANN_EARTH   6
+#define ACT_USE         7
+#define ACT_SATISFY     8
+#define ACT_CHOOSE      9
+#define ACT_LAND        10
+#define ACT_LOAD        11
+#define ACT_BLUFF       12
+#define ACT_REVEAL      13
+
+/*
+ * Design code meaning "no card".
+ */
+#define JOURNAL_NO_CARD 0xffff
+
+/*
+ * Journal file header.
+ */
+typedef struct journal_header
+{
+	/* Magic number */
+	uint32_t magic;
+
+	/* Format version */
+	uint32_t version;
+
+	/* Size of each entry in bytes */
+	uint32_t entry_size;
+
+} journal_header;
+
+/*
+ * Header of one recorded game.
+ */
+typedef struct journal_game
+{
+	/* Starting random seed */
+	uint32_t start_seed;
+
+	/* People of each player (index into peoples[]) */
+	uint8_t people[2];
+
+	/* Crystals won by each player */
+	uint8_t crystals[2];
+
+	/* Number of entries that follow */
+	uint32_t num_entries;
+
+} journal_game;
+
+/*
+ * One decision.
+ */
+typedef struct journal_entry
+{
+	/* Entry type */
+	uint8_t type;
+
+	/* Action code (for actions) */
+	uint8_t act;
+
+	/* Deck index of card used (for actions) */
+	uint8_t index;
+
+	/* Unused */
+	uint8_t pad;
+
+	/* Card and target designs (for actions) */
+	uint16_t arg, target;
+
+	/* Cards chosen (one bit per choice) or bluff called */
+	uint32_t value;
+
+} journal_entry;
+
+/*
+ * A journal being recorded or replayed.
+ */
+typedef struct journal
+{
+	/* File pointer */
+	FILE *fp;
+
+	/* Current game */
+	journal_game game;
+
+	/* Entries of current game */
+	journal_entry *entry;
+
+	/* Size of entry array */
+	int max_entries;
+
+	/* Next entry to replay */
+	int pos;
+
+	/* Number of games written or read */
+	long num_games;
+
+} journal;
+
+/*
+ * Game histories.
+ *
+ * A history remembers every position a game has passed through as a chain
+ * of deltas: for each step, the words of the game structure that changed
+ * along with their old and new values.  Moving backward or forward one
+ * step only touches the words that step changed.
+ *
+ * Saved histories store the current position followed by every step, with
+ * people and card pointers turned into indices.  They can only be loaded
+ * by a build with the same game structure layout.
+ */
+
+/*
+ * Magic number at the start of every saved history ("BMHS").
+ */
+#define HISTORY_MAGIC 0x53484d42
+
+/*
+ * Current saved history format version.
+ */
+#define HISTORY_VERSION 1
+
+/*
+ * Saved history file header.
+ */
+typedef struct history_header
+{
+	/* Magic number */
+	uint32_t magic;
+
+	/* Format version */
+	uint32_t version;
+
+	/* Size of each game word in bytes */
+	uint32_t word_size;
+
+	/* Size of game structure in bytes */
+	uint32_t game_size;
+
+	/* Number of steps */
+	uint32_t num_steps;
+
+	/* Current step */
+	uint32_t pos;
+
+} history_header;
+
+/*
+ * One changed word of the game structure.
+ */
+typedef struct history_change
+{
+	/* Index of word in game structure */
+	uint32_t word;
+
+	/* Values before and after the step */
+	uintptr_t before, after;
+
+} history_change;
+
+/*
+ * One step of a history.
+ */
+typedef struct history_step
+{
+	/* Index of first change */
+	int first;
+
+	/* Number of changes */
+	int num;
+
+} history_step;
+
+/*
+ * History of one game.
+ */
+typedef struct history
+{
+	/* Game state at the current step */
+	game last;
+
+	/* Changes of every step */
+	history_change *change;
+
+	/* Number of changes used and allocated */
+	int num_changes, max_changes;
+
+	/* Steps */
+	history_step *step;
+
+	/* Number of steps used and allocated */
+	int num_steps, max_steps;
+
+	/* Current step (number of steps not undone) */
+	int pos;
+
+} history;
+
+/* External variables */
+extern journal *record_journal;
+
+/* External functions */
+extern int journal_create(journal *j, char *fname);
+extern void journal_start(journal *j, game *g);
+extern void journal_add(journal *j, int type, int act, int index,
+                        design *arg, design *target, unsigned int value);
+extern void journal_finish(journal *j, game *g);
+extern int journal_open(journal *j, char *fname);
+extern int journal_read(journal *j);
+extern design *journal_design(int code);
+extern void journal_close(journal *j);
+extern void history_start(history *h, game *g);
+extern int history_record(history *h, game *g);
+extern int history_undo(history *h, game *g);
+extern int history_redo(history *h, game *g);
+extern int history_save(history *h, game *g, char *fname);
+extern int history_load(history *h, game *g, char *fname);
+extern void history_free(history *h);
+
+/* Replaying (in ai.c) */
+extern interface replay_func;
+extern int replay_game(game *g, journal *j, int num);
@@ -0,0 +1,936 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bluemoon.h"
+#include "net.h"
+#include "dataset.h"
+#include "journal.h"
+#include "async.h"
+
+#include <sys/wait.h>
+#include <sys/time.h>
+
+/*
+ * Headless self-play driver.
+ *
+ * Plays AI against AI with no user interface, training the networks as
+ * it goes and optionally exporting every training position to a dataset.
+ *
+ * Runs are reproducible: game seeds and starting weights are derived
+ * from the base seed and the matchup alone.  Matchups may be spread over
+ * several worker processes, and each matchup trains only its own pair of
+ * networks, so the trained networks and the exported dataset are
+ * identical for any number of workers.
+ */
+
+/*
+ * Verbosity level.
+ */
+int verbose;
+
+/*
+ * Games to play per matchup.
+ */
+static int num_games = 100;
+
+/*
+ * Base random seed.
+ */
+static unsigned int base_seed;
+
+/*
+ * Save trained networks.
+ */
+static int save_nets;
+
+/*
+ * Dataset to export positions to (if any).
+ */
+static char *ds_name;
+
+/*
+ * Let the player not on turn ponder during the other's turn.
+ */
+static int pondering;
+
+/*
+ * Play each turn on a worker thread (and ponder on another meanwhile).
+ */
+static int use_async;
+
+/*
+ * Journal to record decisions to (if any).
+ */
+static char *journal_name;
+
+/*
+ * Journal to replay instead of playing (if any).
+ */
+static char *replay_name;
+
+/*
+ * Number of worker processes.
+ */
+static int num_jobs = 1;
+
+/*
+ * Matchups to play.
+ */
+static int match_a[MAX_PEOPLE * MAX_PEOPLE];
+static int match_b[MAX_PEOPLE * MAX_PEOPLE];
+
+/*
+ * Number of matchups to play.
+ */
+static int num_match;
+
+/*
+ * Events of the game being played.
+ */
+static event_log game_events;
+
+/*
+ * Print a message from the game engine.
+ */
+void message_add(char *msg)
+{
+	/* Print message if verbose */
+	if (verbose >= 2) printf("%s", msg);
+}
+
+/*
+ * Print a game event.
+ */
+static void show_event(game *g, event *e)
+{
+	char msg[1024];
+
+	/* Format message */
+	event_message(e, msg);
+
+	/* Print message */
+	printf("%s", msg);
+}
+
+/*
+ * Look up a people by name.
+ *
+ * Return -1 if not found.
+ */
+static int lookup_people(char *name)
+{
+	int i;
+
+	/* Loop over peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Check for match */
+		if (!strcasecmp(peoples[i].name, name)) return i;
+	}
+
+	/* No match */
+	return -1;
+}
+
+/*
+ * Play a number of games between two peoples.
+ */
+static void play_matchup(int a, int b)
+{
+	game my_game;
+	async_turn play, think;
+	struct timeval start, stop;
+	double elapsed = 0.0, ponder_time;
+	unsigned int seed;
+	int i, j, wins[2] = {0, 0}, actions = 0, turns = 0, last_turn;
+	long searched, pondered, tries, hits;
+
+	/* Compute first game seed for this matchup */
+	seed = base_seed + (a * MAX_PEOPLE + b) * num_games;
+
+	/* Seed weights of any networks created for this matchup */
+	seed_weights(base_seed + a * MAX_PEOPLE + b);
+
+	/* Clear game */
+	memset(&my_game, 0, sizeof(game));
+
+	/* Prepare for playing turns (and pondering) on worker threads */
+	async_init(&play);
+	async_init(&think);
+
+	/* Log events */
+	my_game.events = &game_events;
+
+	/* Set peoples */
+	my_game.p[0].p_ptr = &peoples[a];
+	my_game.p[1].p_ptr = &peoples[b];
+
+	/* Loop over games */
+	for (i = 0; i < num_games; i++)
+	{
+		/* Set random seed for this game */
+		my_game.random_seed = seed + i;
+
+		/* Start new game */
+		init_game(&my_game, 1);
+
+		/* Loop over players */
+		for (j = 0; j < 2; j++)
+		{
+			/* Set control to AI */
+			my_game.p[j].control = &ai_func;
+
+			/* Initialize AI (and load networks) on first game */
+			if (!i) my_game.p[j].control->init(&my_game, j);
+		}
+
+		/* Start recording game */
+		if (record_journal) journal_start(record_journal, &my_game);
+
+		/* No turn seen yet */
+		last_turn = -1;
+
+		/* Play until game is over */
+		while (!my_game.game_over)
+		{
+			/* Check for pondering at start of turn */
+			if (pondering && my_game.turn != last_turn)
+			{
+				/* Check for pondering on a worker thread */
+				if (use_async)
+				{
+					/* Finish pondering of last turn */
+					async_wait(&think);
+
+					/* Let other player think ahead */
+					if (async_ponder(&think, &my_game,
+					                 !my_game.turn, NULL,
+					                 NULL) < 0)
+					{
+						/* Can't continue */
+						exit(1);
+					}
+				}
+				else
+				{
+					/* Let other player think ahead */
+					ai_ponder_prepare(&my_game,
+					                  !my_game.turn);
+					ai_ponder(&my_game);
+				}
+
+				/* Count turns */
+				turns++;
+			}
+
+			/* Remember turn */
+			last_turn = my_game.turn;
+
+			/* Get start time */
+			gettimeofday(&start, NULL);
+
+			/* Check for playing turn on a worker thread */
+			if (use_async)
+			{
+				/* Start rest of turn */
+				if (async_start(&play, &my_game, ai_time_limit,
+				                NULL, NULL) < 0)
+				{
+					/* Can't continue */
+					exit(1);
+				}
+
+				/* Wait for it to finish */
+				async_wait(&play);
+
+				/* Count actions taken */
+				actions += play.actions;
+			}
+			else
+			{
+				/* Have current player take an action */
+				my_game.p[my_game.turn].control->take_action(&my_game);
+
+				/* Count actions */
+				actions++;
+			}
+
+			/* Get end time */
+			gettimeofday(&stop, NULL);
+
+			/* Add time taken */
+			elapsed += (stop.tv_sec - start.tv_sec) * 1000.0 +
+			           (stop.tv_usec - start.tv_usec) / 1000.0;
+		}
+
+		/* Finish pondering (before the networks are trained) */
+		async_wait(&think);
+
+		/* Write recorded game */
+		if (record_journal) journal_finish(record_journal, &my_game);
+
+		/* Loop over players */
+		for (j = 0; j < 2; j++)
+		{
+			/* Perform final training */
+			my_game.p[j].control->game_over(&my_game, j);
+
+			/* Count wins */
+			if (my_game.p[j].crystals) wins[j]++;
+		}
+
+		/* Message */
+		if (verbose)
+		{
+			/* Print game result */
+			printf("%u: %s %d, %s %d\n", my_game.start_seed,
+			       peoples[a].name, my_game.p[0].crystals,
+			       peoples[b].name, my_game.p[1].crystals);
+		}
+	}
+
+	/* Print matchup summary */
+	printf("%s vs %s: %d-%d\n", peoples[a].name, peoples[b].name,
+	       wins[0], wins[1]);
+
+	/* Message */
+	if (verbose && actions)
+	{
+		/* Print average decision time */
+		printf("%d actions, %.3f ms per action\n", actions,
+		       elapsed / actions);
+
+		/* Get positions searched and pondered decisions */
+		ai_stats(&my_game, &searched, &pondered, &ponder_time, &tries,
+		         &hits);
+
+		/* Print search speed (of decisions only) */
+		printf("%ld positions, %.0f per action, %.0f per second\n",
+		       searched, (double)searched / actions,
+		       elapsed > 0 ? searched / (elapsed / 1000.0) : 0.0);
+
+		/* Check for pondering */
+		if (turns)
+		{
+			/* Print pondering results */
+			printf("%ld of %ld pondered decisions hit, "
+			       "%.3f ms pondering per turn\n", hits, tries,
+			       ponder_time / turns);
+
+			/* Print pondering speed */
+			printf("%ld positions pondered, %.0f per second\n",
+			       pondered, ponder_time > 0 ?
+			       pondered / (ponder_time / 1000.0) : 0.0);
+		}
+	}
+
+	/* Check for saving networks */
+	if (save_nets)
+	{
+		/* Save both networks */
+		my_game.p[0].control->shutdown(&my_game, 0);
+		my_game.p[1].control->shutdown(&my_game, 1);
+	}
+
+	/* Destroy AI state */
+	ai_free(&my_game);
+
+	/* Done with worker handles */
+	async_destroy(&play);
+	async_destroy(&think);
+}
+
+/*
+ * Play every matchup assigned to one worker.
+ *
+ * Matchups are dealt out round-robin.  When several workers run, each
+ * matchup exports its positions to a separate part file, which are
+ * joined in matchup order once all workers are done.
+ */
+static void run_worker(int w)
+{
+	dataset ds;
+	char fname[1024];
+	int k;
+
+	/* Loop over this worker's matchups */
+	for (k = w; k < num_match; k += num_jobs)
+	{
+		/* Check for exporting to part file */
+		if (ds_name && num_jobs > 1)
+		{
+			/* Create part filename */
+			sprintf(fname, "%s.%d", ds_name, k);
+
+			/* Remove any stale part */
+			unlink(fname);
+
+			/* Open part */
+			if (dataset_create(&ds, fname, NET_INPUT) < 0)
+			{
+				/* Error */
+				fprintf(stderr, "Couldn't open dataset %s\n",
+				        fname);
+				exit(1);
+			}
+
+			/* Export positions to part */
+			export_data = &ds;
+		}
+
+		/* Play matchup */
+		play_matchup(match_a[k], match_b[k]);
+
+		/* Check for part file */
+		if (ds_name && num_jobs > 1)
+		{
+			/* Close part */
+			dataset_close(&ds);
+
+			/* Stop exporting */
+			export_data = NULL;
+		}
+
+		/* Keep output in order */
+		fflush(stdout);
+	}
+}
+
+/*
+ * Append the part files written by the workers to the dataset.
+ */
+static void join_parts(dataset *ds)
+{
+	dataset part;
+	position pos;
+	char fname[1024];
+	int k;
+
+	/* Loop over matchups */
+	for (k = 0; k < num_match; k++)
+	{
+		/* Create part filename */
+		sprintf(fname, "%s.%d", ds_name, k);
+
+		/* Open part */
+		if (dataset_open(&part, fname) < 0)
+		{
+			/* Error */
+			fprintf(stderr, "Couldn't read dataset %s\n", fname);
+			exit(1);
+		}
+
+		/* Copy positions */
+		while (dataset_read(&part, &pos)) dataset_write(ds, &pos);
+
+		/* Close part */
+		dataset_close(&part);
+
+		/* Remove part */
+		unlink(fname);
+	}
+}
+
+/*
+ * Replay every game in a journal, checking that each reaches its
+ * recorded result.
+ */
+static void run_replay(void)
+{
+	journal j;
+	game g;
+	struct timeval start, stop;
+	double elapsed;
+	int bad = 0;
+
+	/* Open journal */
+	if (journal_open(&j, replay_name) < 0)
+	{
+		/* Error */
+		fprintf(stderr, "Couldn't read journal %s\n", replay_name);
+		exit(1);
+	}
+
+	/* Get start time */
+	gettimeofday(&start, NULL);
+
+	/* Log events */
+	g.events = &game_events;
+
+	/* Loop over games */
+	while (journal_read(&j))
+	{
+		/* Replay game and check result */
+		if (replay_game(&g, &j, -1) < 0 || !g.game_over ||
+		    g.p[0].crystals != j.game.crystals[0] ||
+		    g.p[1].crystals != j.game.crystals[1])
+		{
+			/* Count mismatch */
+			bad++;
+
+			/* Message */
+			printf("%u: replay does not match journal\n",
+			       j.game.start_seed);
+		}
+
+		/* Check for verbose output */
+		else if (verbose)
+		{
+			/* Print game result */
+			printf("%u: %s %d, %s %d\n", g.start_seed,
+			       g.p[0].p_ptr->name, g.p[0].crystals,
+			       g.p[1].p_ptr->name, g.p[1].crystals);
+		}
+	}
+
+	/* Get end time */
+	gettimeofday(&stop, NULL);
+
+	/* Compute time taken */
+	elapsed = (stop.tv_sec - start.tv_sec) +
+	          (stop.tv_usec - start.tv_usec) / 1000000.0;
+
+	/* Print summary */
+	printf("Replayed %ld games (%d mismatched)", j.num_games, bad);
+
+	/* Print speed */
+	if (elapsed > 0)
+	{
+		/* Print games per second */
+		printf(", %.0f games per second", j.num_games / elapsed);
+	}
+
+	/* End line */
+	printf("\n");
+
+	/* Close journal */
+	journal_close(&j);
+
+	/* Check for mismatches */
+	if (bad) exit(1);
+}
+
+/*
+ * Print usage information.
+ */
+static void usage(char *name)
+{
+	printf("Usage: %s [-v] [-n games] [-s seed] [-j jobs] "
+	       "[-p people people] [-d dataset]\n"
+	       "       [-H n[:m]] [-a function] [-T] [-f] [-c k[:budget]] "
+	       "[-e positions]\n"
+	       "       [-l n[:m]] [-P] [-t ms] [-A] [-w] [-J journal] "
+	       "[-R journal]\n", name);
+	printf("  -v            more verbose output\n");
+	printf("  -n games      games to play per matchup (default 100)\n");
+	printf("  -s seed       base random seed (default: time)\n");
+	printf("  -j jobs       number of worker processes (default 1)\n");
+	printf("  -p a b        play only the given matchup\n");
+	printf("  -d dataset    append training positions to dataset\n");
+	printf("  -H n[:m]      hidden layer sizes of new networks\n");
+	printf("  -a function   activation of new networks (sigmoid, tanh, "
+	       "relu)\n");
+	printf("  -T            use a shared trunk with per-matchup heads\n");
+	printf("  -f            play with frozen networks (no training)\n");
+	printf("  -c k[:budget] average k outcomes of each random event "
+	       "while searching,\n"
+	       "                until budget positions are searched "
+	       "(default 5000)\n");
+	printf("  -e positions  solve fully known endgames exactly, giving up "
+	       "after\n"
+	       "                positions searched (default 200000, 0 "
+	       "disables)\n");
+	printf("  -l n[:m]      look n (first player) and m (second player) "
+	       "turns past the\n"
+	       "                current one, within the -c budget "
+	       "(default 0)\n");
+	printf("  -P            ponder during the other player's turn\n");
+	printf("  -t ms         search each decision for at most ms "
+	       "milliseconds\n");
+	printf("  -A            play each turn (and ponder) on a worker "
+	       "thread\n");
+	printf("  -w            save trained networks\n");
+	printf("  -J journal    record every decision to journal\n");
+	printf("  -R journal    replay the games in journal and exit\n");
+	exit(1);
+}
+
+/*
+ * Play games between AI players.
+ */
+int main(int argc, char *argv[])
+{
+	dataset ds;
+	journal jl;
+	pid_t pid;
+	int a = -1, b = -1;
+	int i, j, status, failed = 0;
+
+	/* Default to time-based seed */
+	base_seed = time(NULL);
+
+	/* Parse arguments */
+	for (i = 1; i < argc; i++)
+	{
+		/* Check for verbosity */
+		if (!strcmp(argv[i], "-v"))
+		{
+			/* Increase verbosity */
+			verbose++;
+		}
+
+		/* Check for number of games */
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+		{
+			/* Set number of games */
+			num_games = atoi(argv[++i]);
+		}
+
+		/* Check for random seed */
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+		{
+			/* Set seed */
+			base_seed = strtoul(argv[++i], NULL, 0);
+		}
+
+		/* Check for number of workers */
+		else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+		{
+			/* Set number of workers */
+			num_jobs = atoi(argv[++i]);
+		}
+
+		/* Check for matchup */
+		else if (!strcmp(argv[i], "-p") && i + 2 < argc)
+		{
+			/* Remember people names */
+			a = i + 1;
+			b = i + 2;
+			i += 2;
+		}
+
+		/* Check for dataset */
+		else if (!strcmp(argv[i], "-d") && i + 1 < argc)
+		{
+			/* Remember dataset name */
+			ds_name = argv[++i];
+		}
+
+		/* Check for hidden layer sizes */
+		else if (!strcmp(argv[i], "-H") && i + 1 < argc)
+		{
+			/* Set sizes of new networks */
+			if (sscanf(argv[++i], "%d:%d", &ai_hidden,
+			           &ai_hidden2) < 1) usage(argv[0]);
+		}
+
+		/* Check for activation function */
+		else if (!strcmp(argv[i], "-a") && i + 1 < argc)
+		{
+			/* Set activation of new networks */
+			ai_activation = lookup_activation(argv[++i]);
+
+			/* Check for unknown function */
+			if (ai_activation < 0) usage(argv[0]);
+		}
+
+		/* Check for shared trunk */
+		else if (!strcmp(argv[i], "-T"))
+		{
+			/* Use shared trunk with per-matchup heads */
+			ai_shared_trunk = 1;
+		}
+
+		/* Check for frozen networks */
+		else if (!strcmp(argv[i], "-f"))
+		{
+			/* Play without training */
+			ai_frozen = 1;
+		}
+
+		/* Check for random event sampling */
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+		{
+			/* Set outcomes to sample and search budget */
+			if (sscanf(argv[++i], "%d:%d", &ai_chance_samples,
+			           &ai_search_budget) < 1 ||
+			    ai_chance_samples < 1) usage(argv[0]);
+		}
+
+		/* Check for endgame solver budget */
+		else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+		{
+			/* Set positions to search (zero disables) */
+			ai_endgame_budget = atoi(argv[++i]);
+		}
+
+		/* Check for lookahead */
+		else if (!strcmp(argv[i], "-l") && i + 1 < argc)
+		{
+			/* Set turns for each player (second defaults to first) */
+			j = sscanf(argv[++i], "%d:%d", &ai_lookahead[0],
+			           &ai_lookahead[1]);
+
+			/* Check for error */
+			if (j < 1 || ai_lookahead[0] < 0 ||
+			    ai_lookahead[1] < 0) usage(argv[0]);
+
+			/* Use same depth for both players if only one given */
+			if (j == 1) ai_lookahead[1] = ai_lookahead[0];
+		}
+
+		/* Check for pondering */
+		else if (!strcmp(argv[i], "-P"))
+		{
+			/* Ponder during other player's turn */
+			pondering = 1;
+		}
+
+		/* Check for time limit */
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc)
+		{
+			/* Set milliseconds per decision (zero for no limit) */
+			ai_time_limit = atoi(argv[++i]);
+		}
+
+		/* Check for playing turns asynchronously */
+		else if (!strcmp(argv[i], "-A"))
+		{
+			/* Use worker thread */
+			use_async = 1;
+		}
+
+		/* Check for saving networks */
+		else if (!strcmp(argv[i], "-w"))
+		{
+			/* Save networks when done */
+			save_nets = 1;
+		}
+
+		/* Check for journal to record */
+		else if (!strcmp(argv[i], "-J") && i + 1 < argc)
+		{
+			/* Remember journal name */
+			journal_name = argv[++i];
+		}
+
+		/* Check for journal to replay */
+		else if (!strcmp(argv[i], "-R") && i + 1 < argc)
+		{
+			/* Remember journal name */
+			replay_name = argv[++i];
+		}
+
+		/* Unknown argument */
+		else
+		{
+			/* Print usage and exit */
+			usage(argv[0]);
+		}
+	}
+
+	/* Check for bad network shape */
+	if (ai_hidden < 1 || ai_hidden > NET_MAX_HIDDEN ||
+	    ai_hidden2 < 0 || ai_hidden2 > NET_MAX_HIDDEN) usage(argv[0]);
+
+	/* Need at least one worker */
+	if (num_jobs < 1) num_jobs = 1;
+
+	/* A shared trunk is trained by every matchup in turn */
+	if (ai_shared_trunk && num_jobs > 1)
+	{
+		/* Error */
+		fprintf(stderr, "A shared trunk needs a single worker\n");
+		exit(1);
+	}
+
+	/* A journal is written by one process */
+	if (journal_name && num_jobs > 1)
+	{
+		/* Error */
+		fprintf(stderr, "A journal needs a single worker\n");
+		exit(1);
+	}
+
+	/* Print game events only when very verbose */
+	if (verbose >= 2) game_events.hook = show_event;
+
+	/* Read card database */
+	read_cards();
+
+	/* Check for replaying a journal */
+	if (replay_name)
+	{
+		/* Replay games */
+		run_replay();
+
+		/* Done */
+		return 0;
+	}
+
+	/* Check for single matchup */
+	if (a >= 0)
+	{
+		/* Look up peoples */
+		i = lookup_people(argv[a]);
+		j = lookup_people(argv[b]);
+
+		/* Check for unknown people */
+		if (i < 0 || j < 0 || i == j) usage(argv[0]);
+
+		/* Add matchup */
+		match_a[num_match] = i;
+		match_b[num_match++] = j;
+	}
+	else
+	{
+		/* Loop over all pairs of peoples */
+		for (i = 0; i < MAX_PEOPLE; i++)
+		{
+			for (j = i + 1; j < MAX_PEOPLE; j++)
+			{
+				/* Add matchup */
+				match_a[num_match] = i;
+				match_b[num_match++] = j;
+			}
+		}
+	}
+
+	/* Do not use more workers than matchups */
+	if (num_jobs > num_match) num_jobs = num_match;
+
+	/* Print seed so that the run can be repeated */
+	printf("Seed %u\n", base_seed);
+
+	/* Check for dataset */
+	if (ds_name)
+	{
+		/* Open dataset */
+		if (dataset_create(&ds, ds_name, NET_INPUT) < 0)
+		{
+			/* Error */
+			fprintf(stderr, "Couldn't open dataset %s\n", ds_name);
+			exit(1);
+		}
+
+		/* Export training positions (single worker) */
+		if (num_jobs == 1) export_data = &ds;
+	}
+
+	/* Check for journal */
+	if (journal_name)
+	{
+		/* Open journal */
+		if (journal_create(&jl, journal_name) < 0)
+		{
+			/* Error */
+			fprintf(stderr, "Couldn't open journal %s\n",
+			        journal_name);
+			exit(1);
+		}
+
+		/* Record decisions */
+		record_journal = &jl;
+	}
+
+	/* Check for single worker */
+	if (num_jobs == 1)
+	{
+		/* Play all matchups ourself */
+		run_worker(0);
+	}
+	else
+	{
+		/* Flush output (and dataset header) before forking */
+		fflush(NULL);
+
+		/* Loop over workers */
+		for (i = 0; i < num_jobs; i++)
+		{
+			/* Start worker */
+			pid = fork();
+
+			/* Check for failure */
+			if (pid < 0)
+			{
+				/* Error */
+				perror("fork");
+				exit(1);
+			}
+
+			/* Check for child */
+			if (!pid)
+			{
+				/* Play this worker's matchups */
+				run_worker(i);
+
+				/* Done */
+				exit(0);
+			}
+		}
+
+		/* Wait for all workers */
+		while (wait(&status) > 0)
+		{
+			/* Check for failed worker */
+			if (!WIFEXITED(status) || WEXITSTATUS(status))
+			{
+				/* Remember failure */
+				failed = 1;
+			}
+		}
+
+		/* Check for failure */
+		if (failed)
+		{
+			/* Error */
+			fprintf(stderr, "Worker failed\n");
+			exit(1);
+		}
+
+		/* Join dataset parts in matchup order */
+		if (ds_name) join_parts(&ds);
+	}
+
+	/* Check for dataset */
+	if (ds_name)
+	{
+		/* Message */
+		printf("Exported %ld positions to %s\n",
+		       ds.num_records, ds_name);
+
+		/* Close dataset */
+		dataset_close(&ds);
+	}
+
+	/* Check for journal */
+	if (journal_name)
+	{
+		/* Message */
+		printf("Recorded %ld games to %s\n", jl.num_games,
+		       journal_name);
+
+		/* Close journal */
+		journal_close(&jl);
+	}
+
+	/* Done */
+	return 0;
+}
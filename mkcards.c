@@ -0,0 +1,127 @@
+/*
+ * Bluemoon AI
+ *
+ * Copyright (C) 2007-2008 Keldon Jones
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "bluemoon.h"
+
+/*
+ * Card database compiler.
+ *
+ * Parses cards.txt (failing on any unknown icon or effect name) and
+ * writes the compiled card database that read_cards() loads at startup
+ * instead of parsing the text.  The application build runs it whenever
+ * cards.txt changes and copies the result into the application's
+ * resources.
+ */
+
+/*
+ * Verbosity level.
+ */
+int verbose;
+
+/*
+ * Print a message from the game engine.
+ */
+void message_add(char *msg)
+{
+	/* Print message */
+	printf("%s", msg);
+}
+
+/*
+ * Print usage information.
+ */
+static void usage(char *name)
+{
+	printf("Usage: %s [-o database]\n", name);
+	printf("  -o database   file to write (default cards.db)\n");
+	exit(1);
+}
+
+/*
+ * Compile the card designs.
+ */
+int main(int argc, char *argv[])
+{
+	char *fname = "cards.db";
+	int i, j, num = 0;
+
+	/* Parse arguments */
+	for (i = 1; i < argc; i++)
+	{
+		/* Check for output file */
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+		{
+			/* Set output file */
+			fname = argv[++i];
+		}
+
+		/* Unknown argument */
+		else
+		{
+			/* Print usage and exit */
+			usage(argv[0]);
+		}
+	}
+
+	/* Parse card designs (exits on error) */
+	parse_cards();
+
+	/* Loop over peoples */
+	for (i = 0; i < MAX_PEOPLE; i++)
+	{
+		/* Check for missing people */
+		if (!peoples[i].name)
+		{
+			/* Error */
+			fprintf(stderr, "Only %d peoples in cards.txt\n", i);
+			exit(1);
+		}
+
+		/* Count designs */
+		for (j = 0; j < DECK_SIZE; j++)
+		{
+			/* Check for missing design */
+			if (!peoples[i].deck[j].name)
+			{
+				/* Error */
+				fprintf(stderr, "%s has only %d cards\n",
+				        peoples[i].name, j);
+				exit(1);
+			}
+
+			/* Count design */
+			num++;
+		}
+	}
+
+	/* Write database */
+	if (write_card_db(fname) < 0)
+	{
+		/* Error */
+		fprintf(stderr, "Couldn't write %s\n", fname);
+		exit(1);
+	}
+
+	/* Message */
+	printf("Wrote %d designs to %s\n", num, fname);
+
+	/* Done */
+	return 0;
+}
@@ -27,30 +27,185 @@
  */
 #define PAST_MAX 50
 
+/*
+ * Seed used to create random weights.
+ *
+ * We use our own generator instead of rand() so that new networks are
+ * the same on every platform and are not disturbed by other users of
+ * rand().
+ */
+static unsigned int weight_seed = 1;
+
+/*
+ * Set the seed used to create random weights for new networks.
+ */
+void seed_weights(unsigned int seed)
+{
+	/* Set seed */
+	weight_seed = seed;
+}
+
 /*
  * Create a random weight value.
  */
 static double random_weight(void)
 {
+	/* Advance seed (algorithm from rand() manpage) */
+	weight_seed = weight_seed * 1103515245 + 12345;
+
 	/* Return a random value */
-	return 0.2 * rand() / RAND_MAX - 0.1;
+	return 0.2 * ((weight_seed / 65536) % 32768) / 32767 - 0.1;
 }
 
 /*
- * Create a network of the given size.
+ * Adjust hidden sums by a multiple of one row of weights.
+ *
+ * This is the inner loop of network evaluation, and (adding the hidden
+ * corrections to each row of first layer weights) of training.
+ * Specialized versions with the layer width fixed at compile time are
+ * created for common widths, so that the compiler can fully unroll and
+ * vectorize them.
  */
-void make_learner(net *learn, int input, int hidden, int output)
+static void adjust_any(double *sum, double *weight, double delta, int n)
 {
+	int j;
+
+	/* Loop over hidden nodes */
+	for (j = 0; j < n; j++)
+	{
+		/* Adjust sum */
+		sum[j] += weight[j] * delta;
+	}
+}
+
+/*
+ * Create a sum adjustment kernel for a fixed width.
+ */
+#define NET_KERNEL(width) \
+static void adjust_##width(double *sum, double *weight, double delta, \
+                           int n) \
+{ \
+	int j; \
+\
+	/* Loop over hidden nodes */ \
+	for (j = 0; j < width; j++) \
+	{ \
+		/* Adjust sum */ \
+		sum[j] += weight[j] * delta; \
+	} \
+}
+
+NET_KERNEL(16)
+NET_KERNEL(32)
+NET_KERNEL(50)
+NET_KERNEL(64)
+NET_KERNEL(100)
+NET_KERNEL(128)
+
+/*
+ * Choose the sum adjustment kernel for a hidden layer width.
+ */
+static net_kernel choose_kernel(int width)
+{
+	/* Check for specialized widths */
+	switch (width)
+	{
+		case 16: return adjust_16;
+		case 32: return adjust_32;
+		case 50: return adjust_50;
+		case 64: return adjust_64;
+		case 100: return adjust_100;
+		case 128: return adjust_128;
+	}
+
+	/* Use general kernel */
+	return adjust_any;
+}
+
+/*
+ * Create a matrix of random weights.
+ */
+static double **make_weights(int rows, int cols)
+{
+	double **weight;
 	int i, j;
 
-	/* Set number of outputs */
-	learn->num_output = output;
+	/* Create rows */
+	weight = (double **)malloc(sizeof(double *) * rows);
 
-	/* Set number of inputs */
-	learn->num_inputs = input;
+	/* Loop over rows */
+	for (i = 0; i < rows; i++)
+	{
+		/* Create weight row */
+		weight[i] = (double *)malloc(sizeof(double) * cols);
 
-	/* Number of hidden nodes */
-	learn->num_hidden = hidden;
+		/* Randomize weights */
+		for (j = 0; j < cols; j++)
+		{
+			/* Randomize this weight */
+			weight[i][j] = random_weight();
+		}
+	}
+
+	/* Return weights */
+	return weight;
+}
+
+/*
+ * Create a copy of a matrix of weights.
+ */
+static double **copy_weights(double **src, int rows, int cols)
+{
+	double **weight;
+	int i;
+
+	/* Create rows */
+	weight = (double **)malloc(sizeof(double *) * rows);
+
+	/* Loop over rows */
+	for (i = 0; i < rows; i++)
+	{
+		/* Create weight row */
+		weight[i] = (double *)malloc(sizeof(double) * cols);
+
+		/* Copy weights */
+		memcpy(weight[i], src[i], sizeof(double) * cols);
+	}
+
+	/* Return weights */
+	return weight;
+}
+
+/*
+ * Destroy a matrix of weights.
+ */
+static void free_weights(double **weight, int rows)
+{
+	int i;
+
+	/* Loop over rows */
+	for (i = 0; i < rows; i++)
+	{
+		/* Free row */
+		free(weight[i]);
+	}
+
+	/* Free row pointers */
+	free(weight);
+}
+
+/*
+ * Create the arrays a network uses while being evaluated and trained.
+ */
+static void make_state(net *learn)
+{
+	int input, hidden, hidden2, output;
+
+	/* Get network shape */
+	input = learn->num_inputs;
+	hidden = learn->num_hidden;
+	hidden2 = learn->num_hidden2;
+	output = learn->num_output;
 
 	/* Create input array */
 	learn->input_value = (int *)malloc(sizeof(int) * (input + 1));
@@ -67,59 +222,29 @@ void make_learner(net *learn, int input, int hidden, int output)
 	/* Create hidden error array */
 	learn->hidden_error = (double *)malloc(sizeof(double) * hidden);
 
+	/* Create second layer arrays */
+	learn->hidden2_result = (double *)malloc(sizeof(double) *
+	                                         (hidden2 + 1));
+	learn->hidden2_error = (double *)malloc(sizeof(double) *
+	                                        (hidden2 + 1));
+
 	/* Create output result array */
 	learn->net_result = (double *)malloc(sizeof(double) * output);
 
 	/* Create output probability array */
 	learn->win_prob = (double *)malloc(sizeof(double) * output);
 
-	/* Last input and hidden result are always 1 (for bias) */
+	/* Last input and hidden results are always 1 (for bias) */
 	learn->input_value[input] = 1;
 	learn->hidden_result[hidden] = 1.0;
-
-	/* Create rows of hidden weights */
-	learn->hidden_weight = (double **)malloc(sizeof(double *) *
-	                                         (input + 1));
-
-	/* Loop over hidden weight rows */
-	for (i = 0; i < input + 1; i++)
-	{
-		/* Create weight row */
-		learn->hidden_weight[i] = (double *)malloc(sizeof(double) *
-		                                           hidden);
-
-		/* Randomize weights */
-		for (j = 0; j < hidden; j++)
-		{
-			/* Randomize this weight */
-			learn->hidden_weight[i][j] = random_weight();
-		}
-	}
-
-	/* Create rows of output weights */
-	learn->output_weight = (double **)malloc(sizeof(double *) *
-	                                         (hidden + 1));
-
-	/* Loop over output weight rows */
-	for (i = 0; i < hidden + 1; i++)
-	{
-		/* Create weight row */
-		learn->output_weight[i] = (double *)malloc(sizeof(double) *
-		                                           output);
-
-		/* Randomize weights */
-		for (j = 0; j < output; j++)
-		{
-			/* Randomize this weight */
-			learn->output_weight[i][j] = random_weight();
-		}
-	}
+	learn->hidden2_result[hidden2] = 1.0;
 
 	/* Clear hidden sums */
 	memset(learn->hidden_sum, 0, sizeof(double) * hidden);
 
 	/* Clear hidden errors */
 	memset(learn->hidden_error, 0, sizeof(double) * hidden);
+	memset(learn->hidden2_error, 0, sizeof(double) * (hidden2 + 1));
 
 	/* Clear previous inputs */
 	memset(learn->prev_input, 0, sizeof(int) * (input + 1));
@@ -129,9 +254,210 @@ void make_learner(net *learn, int input, int hidden, int output)
 
 	/* No past inputs available */
 	learn->num_past = 0;
+}
+
+/*
+ * Create a network of the given shape.
+ *
+ * If "hidden2" is non-zero, a second hidden layer of that size is placed
+ * between the first and the outputs.
+ */
+void make_net(net *learn, int input, int hidden, int hidden2, int output,
+              int activation)
+{
+	int last;
+
+	/* Set number of outputs */
+	learn->num_output = output;
+
+	/* Set number of inputs */
+	learn->num_inputs = input;
+
+	/* Number of hidden nodes */
+	learn->num_hidden = hidden;
+
+	/* Number of second layer hidden nodes */
+	learn->num_hidden2 = hidden2;
+
+	/* Activation function */
+	learn->activation = activation;
+
+	/* Choose kernel for first hidden layer */
+	learn->adjust = choose_kernel(hidden);
+
+	/* Get size of layer feeding outputs */
+	last = hidden2 ? hidden2 : hidden;
+
+	/* Create evaluation state */
+	make_state(learn);
+
+	/* Create hidden weights */
+	learn->hidden_weight = make_weights(input + 1, hidden);
+
+	/* Create second layer weights */
+	learn->hidden2_weight = hidden2 ? make_weights(hidden + 1, hidden2) :
+	                                  NULL;
+
+	/* Create output weights */
+	learn->output_weight = make_weights(last + 1, output);
 
 	/* No training done */
 	learn->num_training = 0;
+
+	/* Weights are our own */
+	learn->borrowed = 0;
+
+	/* First layer is our own */
+	learn->trunk = NULL;
+	learn->trunk_changes = learn->trunk_seen = 0;
+}
+
+/*
+ * Create a network that evaluates with another network's weights.
+ *
+ * The weights are not copied, so any number of such networks may share
+ * one set of weights.  They must not be trained.
+ */
+void borrow_net(net *learn, net *src)
+{
+	/* Copy shape and weights */
+	*learn = *src;
+
+	/* Create our own evaluation state */
+	make_state(learn);
+
+	/* Weights belong to source network */
+	learn->borrowed = 1;
+}
+
+/*
+ * Create a network with its own copy of another network's weights
+ * (including a shared first layer).
+ *
+ * The copy may be evaluated while the source is trained.
+ */
+void copy_net(net *learn, net *src)
+{
+	int last;
+
+	/* Copy shape */
+	*learn = *src;
+
+	/* Get size of layer feeding outputs */
+	last = src->num_hidden2 ? src->num_hidden2 : src->num_hidden;
+
+	/* Create our own evaluation state */
+	make_state(learn);
+
+	/* Copy weights */
+	learn->hidden_weight = copy_weights(src->hidden_weight,
+	                                    src->num_inputs + 1,
+	                                    src->num_hidden);
+	learn->hidden2_weight = src->num_hidden2 ?
+	                        copy_weights(src->hidden2_weight,
+	                                     src->num_hidden + 1,
+	                                     src->num_hidden2) : NULL;
+	learn->output_weight = copy_weights(src->output_weight, last + 1,
+	                                    src->num_output);
+
+	/* Weights are our own */
+	learn->borrowed = 0;
+
+	/* First layer is our own */
+	learn->trunk = NULL;
+	learn->trunk_changes = learn->trunk_seen = 0;
+}
+
+/*
+ * Create a network of the given size with one sigmoid hidden layer.
+ */
+void make_learner(net *learn, int input, int hidden, int output)
+{
+	/* Create standard network */
+	make_net(learn, input, hidden, 0, output, NET_SIGMOID);
+}
+
+/*
+ * Destroy a network's storage.
+ */
+void free_learner(net *learn)
+{
+	/* Free past inputs */
+	clear_store(learn);
+	free(learn->past_input);
+
+	/* Free first layer weights (unless shared) */
+	if (!learn->trunk && !learn->borrowed)
+	{
+		free_weights(learn->hidden_weight, learn->num_inputs + 1);
+	}
+
+	/* Free other weights (unless borrowed) */
+	if (learn->num_hidden2 && !learn->borrowed)
+	{
+		free_weights(learn->hidden2_weight, learn->num_hidden + 1);
+	}
+	if (!learn->borrowed)
+	{
+		free_weights(learn->output_weight, (learn->num_hidden2 ?
+		                                    learn->num_hidden2 :
+		                                    learn->num_hidden) + 1);
+	}
+
+	/* Free arrays */
+	free(learn->input_value);
+	free(learn->prev_input);
+	free(learn->hidden_sum);
+	free(learn->hidden_result);
+	free(learn->hidden_error);
+	free(learn->hidden2_result);
+	free(learn->hidden2_error);
+	free(learn->net_result);
+	free(learn->win_prob);
+
+	/* Network has no inputs */
+	learn->num_inputs = 0;
+	learn->trunk = NULL;
+}
+
+/*
+ * Make a network use another network's first layer weights.
+ *
+ * Both networks must have the same inputs, first hidden layer size and
+ * activation.  Training either network trains the shared layer.
+ */
+void share_trunk(net *learn, net *trunk)
+{
+	/* Free our own first layer (unless already shared) */
+	if (!learn->trunk)
+	{
+		free_weights(learn->hidden_weight, learn->num_inputs + 1);
+	}
+
+	/* Use trunk's weights */
+	learn->hidden_weight = trunk->hidden_weight;
+
+	/* Remember trunk */
+	learn->trunk = trunk;
+
+	/* Hidden sums must be recomputed */
+	learn->trunk_seen = trunk->trunk_changes - 1;
+}
+
+/*
+ * Look up an activation function by name.
+ *
+ * Return -1 if not found.
+ */
+int lookup_activation(char *name)
+{
+	/* Check names */
+	if (!strcmp(name, "sigmoid")) return NET_SIGMOID;
+	if (!strcmp(name, "tanh")) return NET_TANH;
+	if (!strcmp(name, "relu")) return NET_RELU;
+
+	/* No match */
+	return -1;
 }
 
 /*
@@ -144,28 +470,104 @@ static double sigmoid(double x)
 }
 
 /*
- * Compute a neural net's result.
+ * Apply a hidden node activation function.
  */
-void compute_net(net *learn)
+static double activate(int activation, double x)
+{
+	/* Check activation */
+	switch (activation)
+	{
+		case NET_TANH: return tanh(x);
+		case NET_RELU: return x > 0.0 ? x : 0.0;
+	}
+
+	/* Default to sigmoid */
+	return sigmoid(x);
+}
+
+/*
+ * Return an activation function's derivative, given its result.
+ */
+static double activate_deriv(int activation, double y)
+{
+	/* Check activation */
+	switch (activation)
+	{
+		case NET_TANH: return 1.0 - y * y;
+		case NET_RELU: return y > 0.0 ? 1.0 : 0.0;
+	}
+
+	/* Default to sigmoid */
+	return y * (1.0 - y);
+}
+
+/*
+ * Compute the second hidden layer from the first.
+ */
+static void compute_hidden2(net *learn, double *hidden, double *hidden2)
 {
 	int i, j;
 	double sum;
 
+	/* Loop over second layer nodes */
+	for (i = 0; i < learn->num_hidden2; i++)
+	{
+		/* Start sum at zero */
+		sum = 0.0;
+
+		/* Loop over first layer results (and bias) */
+		for (j = 0; j < learn->num_hidden + 1; j++)
+		{
+			/* Add weighted result to sum */
+			sum += hidden[j] * learn->hidden2_weight[j][i];
+		}
+
+		/* Set normalized result */
+		hidden2[i] = activate(learn->activation, sum);
+	}
+
+	/* Last result is bias */
+	hidden2[learn->num_hidden2] = 1.0;
+}
+
+/*
+ * Compute a neural net's result.
+ */
+void compute_net(net *learn)
+{
+	net *owner;
+	int i, j, num_last;
+	double sum, *last;
+
+	/* Get network owning first layer weights */
+	owner = learn->trunk ? learn->trunk : learn;
+
+	/* Check for first layer changed by another network */
+	if (learn->trunk_seen != owner->trunk_changes)
+	{
+		/* Clear hidden sums */
+		memset(learn->hidden_sum, 0, sizeof(double) * learn->num_hidden);
+
+		/* Clear previous inputs */
+		memset(learn->prev_input, 0,
+		       sizeof(int) * (learn->num_inputs + 1));
+
+		/* Sums are now up to date */
+		learn->trunk_seen = owner->trunk_changes;
+	}
+
 	/* Loop over inputs */
 	for (i = 0; i < learn->num_inputs + 1; i++)
 	{
 		/* Check for difference from previous input */
 		if (learn->input_value[i] != learn->prev_input[i])
 		{
-			/* Loop over hidden weights */
-			for (j = 0; j < learn->num_hidden; j++)
-			{
-				/* Adjust sum */
-				learn->hidden_sum[j] +=
-				                learn->hidden_weight[i][j] *
-				                       (learn->input_value[i] -
-				                        learn->prev_input[i]);
-			}
+			/* Adjust hidden sums */
+			learn->adjust(learn->hidden_sum,
+			              learn->hidden_weight[i],
+			              learn->input_value[i] -
+			              learn->prev_input[i],
+			              learn->num_hidden);
 
 			/* Store input */
 			learn->prev_input[i] = learn->input_value[i];
@@ -176,7 +578,26 @@ void compute_net(net *learn)
 	for (i = 0; i < learn->num_hidden; i++)
 	{
 		/* Set normalized result */
-		learn->hidden_result[i] = sigmoid(learn->hidden_sum[i]);
+		learn->hidden_result[i] = activate(learn->activation,
+		                                   learn->hidden_sum[i]);
+	}
+
+	/* Check for second hidden layer */
+	if (learn->num_hidden2)
+	{
+		/* Compute second layer */
+		compute_hidden2(learn, learn->hidden_result,
+		                learn->hidden2_result);
+
+		/* Outputs are fed by second layer */
+		last = learn->hidden2_result;
+		num_last = learn->num_hidden2;
+	}
+	else
+	{
+		/* Outputs are fed by first layer */
+		last = learn->hidden_result;
+		num_last = learn->num_hidden;
 	}
 
 	/* Clear probability sum */
@@ -189,11 +610,10 @@ void compute_net(net *learn)
 		sum = 0.0;
 
 		/* Loop over hidden results */
-		for (j = 0; j < learn->num_hidden + 1; j++)
+		for (j = 0; j < num_last + 1; j++)
 		{
 			/* Add weighted result to sum */
-			sum += learn->hidden_result[j] *
-			       learn->output_weight[j][i];
+			sum += last[j] * learn->output_weight[j][i];
 		}
 
 		/* Save sum */
@@ -212,6 +632,93 @@ void compute_net(net *learn)
 	}
 }
 
+/*
+ * Compute a neural net's result for the given inputs without touching
+ * the network's own state.
+ *
+ * Only the weights are read, so several threads may evaluate the same
+ * network at once.  The caller supplies room for the hidden results
+ * (the sizes of both hidden layers plus two) and the output
+ * probabilities.
+ */
+void eval_net(net *learn, int *input, double *hidden, double *prob)
+{
+	int i, j, num_last;
+	double sum, prob_sum = 0.0, *last;
+
+	/* Start hidden sums with bias weights */
+	for (j = 0; j < learn->num_hidden; j++)
+	{
+		/* Copy bias weight */
+		hidden[j] = learn->hidden_weight[learn->num_inputs][j];
+	}
+
+	/* Loop over inputs */
+	for (i = 0; i < learn->num_inputs; i++)
+	{
+		/* Skip zero inputs */
+		if (!input[i]) continue;
+
+		/* Adjust hidden sums */
+		learn->adjust(hidden, learn->hidden_weight[i], input[i],
+		              learn->num_hidden);
+	}
+
+	/* Normalize hidden node results */
+	for (i = 0; i < learn->num_hidden; i++)
+	{
+		/* Set normalized result */
+		hidden[i] = activate(learn->activation, hidden[i]);
+	}
+
+	/* Last hidden result is bias */
+	hidden[learn->num_hidden] = 1.0;
+
+	/* Check for second hidden layer */
+	if (learn->num_hidden2)
+	{
+		/* Second layer results follow the first */
+		last = hidden + learn->num_hidden + 1;
+		num_last = learn->num_hidden2;
+
+		/* Compute second layer */
+		compute_hidden2(learn, hidden, last);
+	}
+	else
+	{
+		/* Outputs are fed by first layer */
+		last = hidden;
+		num_last = learn->num_hidden;
+	}
+
+	/* Compute output nodes */
+	for (i = 0; i < learn->num_output; i++)
+	{
+		/* Start sum at zero */
+		sum = 0.0;
+
+		/* Loop over hidden results */
+		for (j = 0; j < num_last + 1; j++)
+		{
+			/* Add weighted result to sum */
+			sum += last[j] * learn->output_weight[j][i];
+		}
+
+		/* Save exponent of sum */
+		prob[i] = exp(sum);
+
+		/* Track total output */
+		prob_sum += prob[i];
+	}
+
+	/* Then compute output probabilities */
+	for (i = 0; i < learn->num_output; i++)
+	{
+		/* Compute probability */
+		prob[i] /= prob_sum;
+	}
+}
+
 /*
  * Store the current inputs into the past set array.
  */
@@ -271,13 +778,17 @@ void clear_store(net *learn)
  */
 void train_net(net *learn, double lambda, double *desired)
 {
-	int i, j, k;
+	net *owner;
+	int i, j, k, num_last;
 	double error, corr, deriv, hderiv;
-	double *hidden_corr;
+	double *hidden_corr, *last, *last_error;
 #ifdef NOISY
 	double orig[5];
 #endif
 
+	/* Borrowed weights may not be changed */
+	if (learn->borrowed) return;
+
 #ifdef NOISY
 	for (i = 0; i < learn->num_output; i++)
 	{
@@ -285,6 +796,22 @@ void train_net(net *learn, double lambda, double *desired)
 	}
 #endif
 
+	/* Check for second hidden layer */
+	if (learn->num_hidden2)
+	{
+		/* Outputs are fed by second layer */
+		last = learn->hidden2_result;
+		last_error = learn->hidden2_error;
+		num_last = learn->num_hidden2;
+	}
+	else
+	{
+		/* Outputs are fed by first layer */
+		last = learn->hidden_result;
+		last_error = learn->hidden_error;
+		num_last = learn->num_hidden;
+	}
+
 	/* Loop over output nodes */
 	for (i = 0; i < learn->num_output; i++)
 	{
@@ -295,10 +822,10 @@ void train_net(net *learn, double lambda, double *desired)
 		deriv = learn->win_prob[i] * (1.0 - learn->win_prob[i]);
 
 		/* Loop over node's weights */
-		for (j = 0; j < learn->num_hidden; j++)
+		for (j = 0; j < num_last; j++)
 		{
 			/* Compute correction */
-			corr = -error * learn->hidden_result[j] * deriv;
+			corr = -error * last[j] * deriv;
 
 			/* Compute hidden node's effect on output */
 			hderiv = deriv * learn->output_weight[j][i];
@@ -317,7 +844,7 @@ void train_net(net *learn, double lambda, double *desired)
 			}
 
 			/* Compute hidden node's error */
-			learn->hidden_error[j] += error * hderiv;
+			last_error[j] += error * hderiv;
 
 			/* Apply correction */
 			learn->output_weight[j][i] += learn->alpha * corr;
@@ -327,6 +854,35 @@ void train_net(net *learn, double lambda, double *desired)
 		learn->output_weight[j][i] += learn->alpha * -error * deriv;
 	}
 
+	/* Check for second hidden layer */
+	if (learn->num_hidden2)
+	{
+		/* Loop over second layer nodes */
+		for (i = 0; i < learn->num_hidden2; i++)
+		{
+			/* Compute node's error before activation */
+			deriv = activate_deriv(learn->activation,
+			                       learn->hidden2_result[i]) *
+			        learn->hidden2_error[i];
+
+			/* Loop over first layer nodes (and bias) */
+			for (j = 0; j < learn->num_hidden + 1; j++)
+			{
+				/* Pass error back to first layer node */
+				if (j < learn->num_hidden)
+				{
+					/* Add weighted error */
+					learn->hidden_error[j] += deriv *
+					       learn->hidden2_weight[j][i];
+				}
+
+				/* Apply correction */
+				learn->hidden2_weight[j][i] -= learn->alpha *
+				       deriv * learn->hidden_result[j];
+			}
+		}
+	}
+
 	/* Create array of hidden weight correction factors */
 	hidden_corr = (double *)malloc(sizeof(double) * learn->num_hidden);
 
@@ -334,8 +890,8 @@ void train_net(net *learn, double lambda, double *desired)
 	for (i = 0; i < learn->num_hidden; i++)
 	{
 		/* Output portion of partial derivatives */
-		deriv = learn->hidden_result[i] *
-			(1.0 - learn->hidden_result[i]);
+		deriv = activate_deriv(learn->activation,
+		                       learn->hidden_result[i]);
 
 		/* Calculate correction factor */
 		hidden_corr[i] = deriv * -learn->hidden_error[i] * learn->alpha;
@@ -347,17 +903,20 @@ void train_net(net *learn, double lambda, double *desired)
 		/* Skip zero inputs */
 		if (!learn->input_value[i]) continue;
 
-		/* Loop over hidden nodes */
-		for (j = 0; j < learn->num_hidden; j++)
-		{
-			/* Adjust weight */
-			learn->hidden_weight[i][j] += hidden_corr[j];
-		}
+		/* Adjust weights of input to every hidden node */
+		learn->adjust(learn->hidden_weight[i], hidden_corr, 1.0,
+		              learn->num_hidden);
 	}
 
 	/* Destroy hidden correction factor array */
 	free(hidden_corr);
 
+	/* Get network owning first layer weights */
+	owner = learn->trunk ? learn->trunk : learn;
+
+	/* Note change to first layer (our own sums are cleared below) */
+	learn->trunk_seen = ++owner->trunk_changes;
+
 	/* Loop over hidden nodes */
 	for (i = 0; i < learn->num_hidden; i++)
 	{
@@ -368,6 +927,10 @@ void train_net(net *learn, double lambda, double *desired)
 		learn->hidden_sum[i] = 0;
 	}
 
+	/* Clear second layer errors */
+	memset(learn->hidden2_error, 0,
+	       sizeof(double) * (learn->num_hidden2 + 1));
+
 	/* Clear previous inputs */
 	memset(learn->prev_input, 0, sizeof(int) * (learn->num_inputs + 1));
 
@@ -380,14 +943,41 @@ void train_net(net *learn, double lambda, double *desired)
 #endif
 }
 
+/*
+ * Read one weight from a network file.
+ *
+ * Return -1 on failure.
+ */
+static int read_weight(FILE *fff, double *weight)
+{
+	/* Load a weight */
+	return fscanf(fff, "%lf\n", weight) == 1 ? 0 : -1;
+}
+
 /*
  * Load network weights from disk.
+ *
+ * The first line of the file gives the network's shape: the number of
+ * inputs, hidden nodes and outputs, optionally followed by the size of a
+ * second hidden layer, the activation function and a flag marking a
+ * head whose first layer comes from a shared trunk (and so is not in
+ * the file).  Files with only the first three numbers describe one
+ * sigmoid hidden layer.
+ *
+ * The number of inputs and outputs must match the given network.  If the
+ * hidden layers differ, the network is recreated to match the file.  A
+ * head can only be loaded into a network that already shares a trunk
+ * of the right shape.
  */
 int load_net(net *learn, char *fname)
 {
 	FILE *fff;
-	int i, j;
-	int input, hidden, output;
+	net *trunk;
+	char line[1024];
+	double alpha;
+	int i, j, num_last;
+	int input, hidden, hidden2 = 0, output, activation = NET_SIGMOID;
+	int head = 0;
 
 	/* Open weights file */
 	fff = fopen(fname, "r");
@@ -395,44 +985,105 @@ int load_net(net *learn, char *fname)
 	/* Check for failure */
 	if (!fff) return -1;
 
-	/* Read network size from file */
-	fscanf(fff, "%d %d %d\n", &input, &hidden, &output);
+	/* Read network shape from file */
+	if (!fgets(line, 1024, fff) ||
+	    sscanf(line, "%d %d %d %d %d %d", &input, &hidden, &output,
+	           &hidden2, &activation, &head) < 3)
+	{
+		/* Failure */
+		fclose(fff);
+		return -1;
+	}
 
-	/* Check for mismatch */
+	/* Check for mismatch or nonsense */
 	if (input != learn->num_inputs ||
-	    hidden != learn->num_hidden ||
-	    output != learn->num_output) return -1;
+	    output != learn->num_output ||
+	    hidden < 1 || hidden > NET_MAX_HIDDEN ||
+	    hidden2 < 0 || hidden2 > NET_MAX_HIDDEN ||
+	    activation < NET_SIGMOID || activation > NET_RELU)
+	{
+		/* Failure */
+		fclose(fff);
+		return -1;
+	}
+
+	/* Check for head without matching trunk */
+	if (head && (!learn->trunk || hidden != learn->trunk->num_hidden ||
+	             activation != learn->trunk->activation))
+	{
+		/* Failure */
+		fclose(fff);
+		return -1;
+	}
+
+	/* Check for different hidden layers or sharing */
+	if (hidden != learn->num_hidden || hidden2 != learn->num_hidden2 ||
+	    activation != learn->activation || (!head && learn->trunk))
+	{
+		/* Keep learning rate and trunk */
+		alpha = learn->alpha;
+		trunk = learn->trunk;
+
+		/* Recreate network with file's shape */
+		free_learner(learn);
+		make_net(learn, input, hidden, hidden2, output, activation);
+
+		/* Restore learning rate */
+		learn->alpha = alpha;
+
+		/* Share trunk again */
+		if (head) share_trunk(learn, trunk);
+	}
 
 	/* Read number of training iterations */
 	fscanf(fff, "%d\n", &learn->num_training);
 
-	/* Loop over hidden nodes */
-	for (i = 0; i < learn->num_hidden; i++)
+	/* Loop over hidden nodes (unless shared) */
+	for (i = 0; i < learn->num_hidden && !head; i++)
 	{
 		/* Loop over weights */
 		for (j = 0; j < learn->num_inputs + 1; j++)
 		{
 			/* Load a weight */
-			if (fscanf(fff, "%lf\n",
-			           &learn->hidden_weight[j][i]) != 1)
+			if (read_weight(fff, &learn->hidden_weight[j][i]))
+			{
+				/* Failure */
+				fclose(fff);
+				return -1;
+			}
+		}
+	}
+
+	/* Loop over second layer hidden nodes */
+	for (i = 0; i < learn->num_hidden2; i++)
+	{
+		/* Loop over weights */
+		for (j = 0; j < learn->num_hidden + 1; j++)
+		{
+			/* Load a weight */
+			if (read_weight(fff, &learn->hidden2_weight[j][i]))
 			{
 				/* Failure */
+				fclose(fff);
 				return -1;
 			}
 		}
 	}
 
+	/* Get size of layer feeding outputs */
+	num_last = learn->num_hidden2 ? learn->num_hidden2 : learn->num_hidden;
+
 	/* Loop over output nodes */
 	for (i = 0; i < learn->num_output; i++)
 	{
 		/* Loop over weights */
-		for (j = 0; j < learn->num_hidden + 1; j++)
+		for (j = 0; j < num_last + 1; j++)
 		{
 			/* Load a weight */
-			if (fscanf(fff, "%lf\n",
-			           &learn->output_weight[j][i]) != 1)
+			if (read_weight(fff, &learn->output_weight[j][i]))
 			{
 				/* Failure */
+				fclose(fff);
 				return -1;
 			}
 		}
@@ -451,20 +1102,40 @@ int load_net(net *learn, char *fname)
 void save_net(net *learn, char *fname)
 {
 	FILE *fff;
-	int i, j;
+	int i, j, num_last;
 
 	/* Open output file */
 	fff = fopen(fname, "w");
 
-	/* Save network size */
-	fprintf(fff, "%d %d %d\n", learn->num_inputs, learn->num_hidden,
-	                           learn->num_output);
+	/* Check for head */
+	if (learn->trunk)
+	{
+		/* Save network size and head flag */
+		fprintf(fff, "%d %d %d %d %d 1\n", learn->num_inputs,
+		        learn->num_hidden, learn->num_output,
+		        learn->num_hidden2, learn->activation);
+	}
+
+	/* Check for standard shape */
+	else if (!learn->num_hidden2 && learn->activation == NET_SIGMOID)
+	{
+		/* Save network size */
+		fprintf(fff, "%d %d %d\n", learn->num_inputs,
+		        learn->num_hidden, learn->num_output);
+	}
+	else
+	{
+		/* Save network size, second layer and activation */
+		fprintf(fff, "%d %d %d %d %d\n", learn->num_inputs,
+		        learn->num_hidden, learn->num_output,
+		        learn->num_hidden2, learn->activation);
+	}
 
 	/* Save training iterations */
 	fprintf(fff, "%d\n", learn->num_training);
 
-	/* Loop over hidden nodes */
-	for (i = 0; i < learn->num_hidden; i++)
+	/* Loop over hidden nodes (unless shared) */
+	for (i = 0; i < learn->num_hidden && !learn->trunk; i++)
 	{
 		/* Loop over weights */
 		for (j = 0; j < learn->num_inputs + 1; j++)
@@ -474,11 +1145,25 @@ void save_net(net *learn, char *fname)
 		}
 	}
 
+	/* Loop over second layer hidden nodes */
+	for (i = 0; i < learn->num_hidden2; i++)
+	{
+		/* Loop over weights */
+		for (j = 0; j < learn->num_hidden + 1; j++)
+		{
+			/* Save a weight */
+			fprintf(fff, "%.12le\n", learn->hidden2_weight[j][i]);
+		}
+	}
+
+	/* Get size of layer feeding outputs */
+	num_last = learn->num_hidden2 ? learn->num_hidden2 : learn->num_hidden;
+
 	/* Loop over output nodes */
 	for (i = 0; i < learn->num_output; i++)
 	{
 		/* Loop over weights */
-		for (j = 0; j < learn->num_hidden + 1; j++)
+		for (j = 0; j < num_last + 1; j++)
 		{
 			/* Save a weight */
 			fprintf(fff, "%.12le\n", learn->output_weight[j][i]);
@@ -24,7 +24,33 @@
 #include <math.h>
 
 /*
- * A two-layer neural net.
+ * Hidden node activation functions.
+ */
+#define NET_SIGMOID     0
+#define NET_TANH        1
+#define NET_RELU        2
+
+/*
+ * Largest number of nodes in a hidden layer.
+ */
+#define NET_MAX_HIDDEN  1024
+
+/*
+ * Kernel adding a multiple of one row to another, for rows as wide as the
+ * first hidden layer.
+ */
+typedef void (*net_kernel)(double *sum, double *weight, double delta, int n);
+
+/*
+ * A neural net with one or two hidden layers.
+ *
+ * The first hidden layer's sums are maintained incrementally as inputs
+ * change, so it is best made wide.  The optional second hidden layer is
+ * recomputed in full each time.
+ *
+ * A network may share its first layer (the "trunk") with other networks,
+ * so that one trunk trained on every matchup feeds small per-matchup
+ * heads.
  */
 typedef struct net
 {
@@ -37,12 +63,24 @@ typedef struct net
 	/* Number of hidden nodes */
 	int num_hidden;
 
+	/* Number of second layer hidden nodes (zero for none) */
+	int num_hidden2;
+
 	/* Number of output nodes */
 	int num_output;
 
+	/* Hidden node activation function */
+	int activation;
+
+	/* Kernel used to adjust first layer hidden sums and weights */
+	net_kernel adjust;
+
 	/* Hidden layer weights */
 	double **hidden_weight;
 
+	/* Second hidden layer weights */
+	double **hidden2_weight;
+
 	/* Output layer weights */
 	double **output_weight;
 
@@ -52,6 +90,9 @@ typedef struct net
 	/* Cumulative hidden nod error */
 	double *hidden_error;
 
+	/* Cumulative second layer hidden node error */
+	double *hidden2_error;
+
 	/* Set of input values */
 	int *input_value;
 
@@ -61,6 +102,9 @@ typedef struct net
 	/* Set of hidden results */
 	double *hidden_result;
 
+	/* Set of second layer hidden results */
+	double *hidden2_result;
+
 	/* Set of network results */
 	double *net_result;
 
@@ -79,11 +123,32 @@ typedef struct net
 	/* Training iterations this network has gone through */
 	int num_training;
 
+	/* Weights belong to another network */
+	int borrowed;
+
+	/* Network whose first layer weights we share (if any) */
+	struct net *trunk;
+
+	/* Changes made to this network's first layer weights */
+	int trunk_changes;
+
+	/* Trunk changes seen when our hidden sums were computed */
+	int trunk_seen;
+
 } net;
 
 /* External functions */
+extern void seed_weights(unsigned int seed);
 extern void make_learner(net *learn, int inputs, int hidden, int output);
+extern void make_net(net *learn, int inputs, int hidden, int hidden2,
+                     int output, int activation);
+extern void free_learner(net *learn);
+extern void share_trunk(net *learn, net *trunk);
+extern void borrow_net(net *learn, net *src);
+extern void copy_net(net *learn, net *src);
+extern int lookup_activation(char *name);
 extern void compute_net(net *learn);
+extern void eval_net(net *learn, int *input, double *hidden, double *prob);
 extern void store_net(net *learn);
 extern void clear_store(net *learn);
 extern void train_net(net *learn, double lambda, double *desired);